@@ -0,0 +1,254 @@
+// Command-line parentage sampler, for running sample_parentage_and_error_rates
+// on cluster nodes without an R installation. Build against Armadillo with, e.g.
+//
+//   g++ -O2 -std=c++11 -I../include sydney_paternity.cpp -o sydney_paternity -larmadillo
+//
+// adding -fopenmp for --threads.
+//
+// Usage:
+//
+//   sydney_paternity genotypes.txt output_prefix [options]
+//
+// where genotypes.txt is in the format read by genotype_array_from_txt (a header
+// of locus names, then one row per sample of "allele/allele" calls; 0 or NA is
+// missing). Writes output_prefix.paternity.txt, output_prefix.maternity.txt,
+// output_prefix.error_rates.txt and output_prefix.imputed_genotypes.txt.
+// With --checkpoint, the chain is saved periodically to output_prefix.checkpoint;
+// rerunning with --resume continues from there and gives the same samples as an
+// uninterrupted run (the genotype file is still needed, for sample and locus names).
+
+#include <sydneyPaternity/parentage.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+
+struct genotype_table
+{
+  std::vector<std::string> loci;
+  std::vector<std::string> samples;
+  arma::ucube phenotypes; //2 x samples x loci, 0 is missing
+};
+
+genotype_table read_genotypes (const std::string& filename)
+{
+  std::ifstream input (filename);
+  if (!input) throw std::runtime_error("could not open " + filename);
+
+  genotype_table table;
+  std::vector<std::vector<unsigned>> calls;
+  std::string line;
+  while (std::getline(input, line))
+  {
+    std::istringstream fields (line);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (fields >> token) tokens.push_back(token);
+    if (tokens.empty()) continue;
+    if (table.loci.empty())
+    {
+      table.loci = tokens;
+      continue;
+    }
+    if (tokens.size() != table.loci.size() + 1)
+    {
+      throw std::runtime_error("sample " + tokens[0] + " does not have a genotype for each locus");
+    }
+    table.samples.push_back(tokens[0]);
+    std::vector<unsigned> alleles;
+    for (unsigned locus=0; locus<table.loci.size(); ++locus)
+    {
+      const std::string& call = tokens[locus+1];
+      const std::size_t split = call.find('/');
+      if (split == std::string::npos) throw std::runtime_error("genotype " + call + " is not of the form allele/allele");
+      for (auto allele : {call.substr(0, split), call.substr(split+1)})
+      {
+        alleles.push_back(allele == "NA" ? 0 : unsigned(std::stoul(allele)));
+      }
+    }
+    calls.push_back(alleles);
+  }
+
+  table.phenotypes.set_size(2, table.samples.size(), table.loci.size());
+  for (unsigned i=0; i<table.samples.size(); ++i)
+  {
+    for (unsigned locus=0; locus<table.loci.size(); ++locus)
+    {
+      table.phenotypes.at(0, i, locus) = calls[i][2*locus];
+      table.phenotypes.at(1, i, locus) = calls[i][2*locus+1];
+    }
+  }
+  return table;
+}
+
+void write_parentage (const std::string& filename, const genotype_table& table, const arma::imat& samples, const unsigned mother)
+{
+  // one row per MCMC iteration, one column per sample; the mother has no parentage
+  std::ofstream output (filename);
+  for (unsigned i=0; i<table.samples.size(); ++i) output << (i ? "\t" : "") << table.samples[i];
+  output << "\n";
+  for (unsigned iter=0; iter<samples.n_cols; ++iter)
+  {
+    for (unsigned i=0; i<samples.n_rows; ++i)
+    {
+      output << (i ? "\t" : "");
+      if (i == mother-1) output << "NA"; else output << samples.at(i, iter);
+    }
+    output << "\n";
+  }
+}
+
+void write_error_rates (const std::string& filename, const genotype_table& table,
+    const sydneyPaternity::parentage_posterior_samples& samples)
+{
+  std::ofstream output (filename);
+  output << "deviance";
+  for (auto& locus : table.loci) output << "\tdropout_" << locus;
+  for (auto& locus : table.loci) output << "\tmistyping_" << locus;
+  output << "\n";
+  for (unsigned iter=0; iter<samples.deviance.n_elem; ++iter)
+  {
+    output << samples.deviance.at(iter);
+    for (unsigned locus=0; locus<table.loci.size(); ++locus) output << "\t" << samples.dropout_rate.at(locus, iter);
+    for (unsigned locus=0; locus<table.loci.size(); ++locus) output << "\t" << samples.mistyping_rate.at(locus, iter);
+    output << "\n";
+  }
+}
+
+void write_genotypes (const std::string& filename, const genotype_table& table, const arma::ucube& genotypes)
+{
+  // same format as input
+  std::ofstream output (filename);
+  for (unsigned locus=0; locus<table.loci.size(); ++locus) output << (locus ? "\t" : "") << table.loci[locus];
+  output << "\n";
+  for (unsigned i=0; i<table.samples.size(); ++i)
+  {
+    output << table.samples[i];
+    for (unsigned locus=0; locus<table.loci.size(); ++locus)
+    {
+      output << "\t" << genotypes.at(0, i, locus) << "/" << genotypes.at(1, i, locus);
+    }
+    output << "\n";
+  }
+}
+
+void usage (void)
+{
+  std::cerr <<
+    "usage: sydney_paternity genotypes.txt output_prefix [options]\n"
+    "  --mother N                 1-based index of the phenotyped mother (1)\n"
+    "  --maternity L              comma-separated starting maternity labels, one per sample (all 0)\n"
+    "  --samples N                number of MCMC samples (1000)\n"
+    "  --burn-in N                burn-in iterations (0)\n"
+    "  --thin N                   thinning interval (1)\n"
+    "  --concentration X          Dirichlet process concentration (1)\n"
+    "  --lambda-mother X          Poisson prior on number of mothers, 0 to disable (0)\n"
+    "  --lambda-father X          Poisson prior on number of fathers, 0 to disable (0)\n"
+    "  --dropout X                starting dropout rate (0.01)\n"
+    "  --mistyping X              starting mistyping rate (0.01)\n"
+    "  --per-locus-error-rates    estimate error rates separately per locus\n"
+    "  --fixed-error-rates        do not update error rates\n"
+    "  --fixed-allele-frequencies do not update allele frequencies\n"
+    "  --linear-space             evaluate likelihoods with scaled products rather than logs\n"
+    "  --single-precision         evaluate likelihoods with single-precision emission probabilities\n"
+    "  --prune X                  drop parental genotypes explaining a phenotype with probability below X\n"
+    "  --threads N                threads for data augmentation over loci (1)\n"
+    "  --seed N                   random seed (from clock)\n"
+    "  --checkpoint N             save chain to output_prefix.checkpoint every N iterations\n"
+    "  --resume                   continue from output_prefix.checkpoint\n";
+}
+
+int main (int argc, char** argv)
+{
+  if (argc < 3) { usage(); return 1; }
+  const std::string genotype_file = argv[1];
+  const std::string prefix = argv[2];
+
+  unsigned mother = 1, number_of_mcmc_samples = 1000, burn_in = 0, thinning_interval = 1;
+  double concentration = 1., lambda_mother = 0., lambda_father = 0.;
+  double starting_dropout_rate = 0.01, starting_mistyping_rate = 0.01;
+  bool global_genotyping_error_rates = true, update_error_rates = true, update_allele_frequencies = true;
+  bool linear_space_likelihood = false, single_precision_likelihood = false;
+  double genotype_pruning_threshold = 0.;
+  uint64_t seed = std::chrono::system_clock::now().time_since_epoch().count();
+  std::string maternity_labels;
+  unsigned checkpoint_interval = 0;
+  unsigned number_of_threads = 1;
+  bool resume = false;
+
+  try
+  {
+    for (int i=3; i<argc; ++i)
+    {
+      const std::string option = argv[i];
+      auto value = [&] (void) -> std::string
+      {
+        if (i+1 >= argc) throw std::runtime_error("missing value for " + option);
+        return argv[++i];
+      };
+      if (option == "--mother") mother = std::stoul(value());
+      else if (option == "--maternity") maternity_labels = value();
+      else if (option == "--samples") number_of_mcmc_samples = std::stoul(value());
+      else if (option == "--burn-in") burn_in = std::stoul(value());
+      else if (option == "--thin") thinning_interval = std::stoul(value());
+      else if (option == "--concentration") concentration = std::stod(value());
+      else if (option == "--lambda-mother") lambda_mother = std::stod(value());
+      else if (option == "--lambda-father") lambda_father = std::stod(value());
+      else if (option == "--dropout") starting_dropout_rate = std::stod(value());
+      else if (option == "--mistyping") starting_mistyping_rate = std::stod(value());
+      else if (option == "--per-locus-error-rates") global_genotyping_error_rates = false;
+      else if (option == "--fixed-error-rates") update_error_rates = false;
+      else if (option == "--fixed-allele-frequencies") update_allele_frequencies = false;
+      else if (option == "--linear-space") linear_space_likelihood = true;
+      else if (option == "--single-precision") single_precision_likelihood = true;
+      else if (option == "--prune") genotype_pruning_threshold = std::stod(value());
+      else if (option == "--threads") number_of_threads = std::stoul(value());
+      else if (option == "--seed") seed = std::stoull(value());
+      else if (option == "--checkpoint") checkpoint_interval = std::stoul(value());
+      else if (option == "--resume") resume = true;
+      else { usage(); throw std::runtime_error("unknown option " + option); }
+    }
+
+    genotype_table table = read_genotypes(genotype_file);
+
+    arma::uvec maternity (table.samples.size(), arma::fill::zeros);
+    if (!maternity_labels.empty())
+    {
+      std::istringstream labels (maternity_labels);
+      std::string label;
+      unsigned i = 0;
+      while (std::getline(labels, label, ','))
+      {
+        if (i >= maternity.n_elem) break;
+        maternity.at(i++) = std::stoul(label);
+      }
+      if (i != maternity.n_elem) throw std::runtime_error("maternity must have a label for each sample");
+    }
+
+    const std::string checkpoint_file = prefix + ".checkpoint";
+    sydneyPaternity::random_number_generator rng (sydneyPaternity::splitmix64(seed));
+    sydneyPaternity::sampler_instrumentation instrumentation (false);
+    sydneyPaternity::parentage_posterior_samples samples = resume ?
+      sydneyPaternity::resume_parentage_and_error_rates(checkpoint_file, rng, instrumentation, std::cerr, checkpoint_interval, 
+          number_of_threads) :
+      sydneyPaternity::sample_parentage_and_error_rates(table.phenotypes, maternity, mother, burn_in, thinning_interval,
+          number_of_mcmc_samples, global_genotyping_error_rates, update_error_rates, update_allele_frequencies,
+          concentration, lambda_mother, lambda_father, starting_dropout_rate, starting_mistyping_rate,
+          rng, instrumentation, std::cerr, checkpoint_file, checkpoint_interval, false, linear_space_likelihood, 
+          single_precision_likelihood, genotype_pruning_threshold, number_of_threads);
+
+    write_parentage(prefix + ".paternity.txt", table, samples.paternity, mother);
+    write_parentage(prefix + ".maternity.txt", table, samples.maternity, mother);
+    write_error_rates(prefix + ".error_rates.txt", table, samples);
+    write_genotypes(prefix + ".imputed_genotypes.txt", table, samples.imputed_genotypes);
+  }
+  catch (std::exception& error)
+  {
+    std::cerr << "error: " << error.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,207 @@
+#ifndef _SYDNEYPATERNITY_CORE_ALLELE_BUCKETS_H
+#define _SYDNEYPATERNITY_CORE_ALLELE_BUCKETS_H
+
+#include <armadillo>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include "parentage.h"
+
+// Locus likelihood kernels specialized on an upper bound for the number of alleles
+// (4, 8, 16, 32), so that parental allele loops have compile-time bounds, allele
+// frequencies live in fixed-size stack arrays, and the triangular indexing of
+// unordered maternal genotypes comes from a constexpr table. Loci with more alleles
+// use the matrix kernel (BLAS). Kernels are chosen once per locus, before sampling.
+
+namespace sydneyPaternity {
+
+template <unsigned... I> struct index_sequence {};
+template <unsigned N, unsigned... I> struct make_index_sequence : make_index_sequence<N-1, N-1, I...> {};
+template <unsigned... I> struct make_index_sequence<0, I...> : index_sequence<I...> {};
+
+constexpr unsigned triangular_first_allele (const unsigned genotype, const unsigned number_of_alleles, const unsigned allele = 0)
+{
+  // 0-based first allele of the genotype'th (w, v >= w) pair
+  return genotype < number_of_alleles - allele ? allele :
+    triangular_first_allele(genotype - (number_of_alleles - allele), number_of_alleles, allele + 1);
+}
+
+constexpr unsigned triangular_second_allele (const unsigned genotype, const unsigned number_of_alleles, const unsigned allele = 0)
+{
+  return genotype < number_of_alleles - allele ? allele + genotype :
+    triangular_second_allele(genotype - (number_of_alleles - allele), number_of_alleles, allele + 1);
+}
+
+template <unsigned MAX_ALLELES, unsigned... I>
+constexpr std::array<unsigned char, sizeof...(I)> triangular_first_alleles (index_sequence<I...>)
+{
+  return {{ static_cast<unsigned char>(triangular_first_allele(I, MAX_ALLELES))... }};
+}
+
+template <unsigned MAX_ALLELES, unsigned... I>
+constexpr std::array<unsigned char, sizeof...(I)> triangular_second_alleles (index_sequence<I...>)
+{
+  return {{ static_cast<unsigned char>(triangular_second_allele(I, MAX_ALLELES))... }};
+}
+
+template <unsigned MAX_ALLELES>
+struct genotype_index_table
+{
+  static constexpr unsigned number_of_genotypes = MAX_ALLELES*(MAX_ALLELES+1)/2;
+  typedef std::array<unsigned char, number_of_genotypes> table;
+  static constexpr table first_allele = triangular_first_alleles<MAX_ALLELES>(make_index_sequence<number_of_genotypes>());
+  static constexpr table second_allele = triangular_second_alleles<MAX_ALLELES>(make_index_sequence<number_of_genotypes>());
+};
+
+template <unsigned MAX_ALLELES>
+constexpr typename genotype_index_table<MAX_ALLELES>::table genotype_index_table<MAX_ALLELES>::first_allele;
+template <unsigned MAX_ALLELES>
+constexpr typename genotype_index_table<MAX_ALLELES>::table genotype_index_table<MAX_ALLELES>::second_allele;
+
+template <unsigned MAX_ALLELES>
+double paternity_loglikelihood_by_locus_fixed
+ (const arma::uvec& paternity,
+  const arma::umat& offspring_phenotypes,
+  const arma::uvec& maternal_phenotype,
+  const arma::vec& allele_frequencies,
+  const double& dropout_rate,
+  const double& mistyping_rate)
+{
+  // same as paternity_loglikelihood_by_locus (and the same sums, in the same order), with
+  // offspring phenotype probabilities tabulated once per call rather than per maternal genotype
+  typedef genotype_index_table<MAX_ALLELES> genotypes;
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+
+  if (number_of_alleles > MAX_ALLELES) throw std::invalid_argument("too many alleles for specialized kernel");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  std::array<double, MAX_ALLELES> frequency;
+  frequency.fill(0.);
+  const double total_frequency = arma::accu(allele_frequencies);
+  for (unsigned u=0; u<number_of_alleles; ++u)
+  {
+    frequency[u] = allele_frequencies[u] / total_frequency;
+    if (frequency[u] < 0.) throw std::invalid_argument("negative allele frequencies");
+  }
+
+  // P(offspring phenotype | maternal allele a, paternal allele u), for nonmissing offspring
+  std::vector<std::array<double, MAX_ALLELES*MAX_ALLELES>> emission;
+  std::vector<unsigned> emission_index (paternity.n_elem, 0);
+  std::vector<bool> nonmissing (paternity.n_elem, false);
+  for (unsigned offspring=0; offspring<paternity.n_elem; ++offspring)
+  {
+    arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+    if (!arma::prod(offspring_phenotype)) continue;
+    nonmissing[offspring] = true;
+    emission_index[offspring] = emission.size();
+    emission.emplace_back();
+    for (unsigned a=0; a<number_of_alleles; ++a)
+    {
+      for (unsigned u=0; u<number_of_alleles; ++u)
+      {
+        emission.back()[a*MAX_ALLELES + u] =
+          genotyping_error_model(offspring_phenotype, a+1, u+1, number_of_alleles, dropout_rate, mistyping_rate);
+      }
+    }
+  }
+  std::vector<std::vector<unsigned>> offspring_from_father (fathers.n_elem);
+  for (unsigned i=0; i<fathers.n_elem; ++i)
+  {
+    for (unsigned offspring=0; offspring<paternity.n_elem; ++offspring)
+    {
+      if (paternity[offspring] == fathers[i] && nonmissing[offspring])
+      {
+        offspring_from_father[i].push_back(emission_index[offspring]);
+      }
+    }
+  }
+
+  double halfsib_likelihood = 0.;
+  double halfsib_running_maximum = -arma::datum::inf;
+  for (unsigned genotype=0; genotype<genotypes::number_of_genotypes; ++genotype) // maternal genotype (w, v >= w)
+  {
+    const unsigned w = genotypes::first_allele[genotype];
+    const unsigned v = genotypes::second_allele[genotype];
+    if (v >= number_of_alleles) continue; //padding
+    double maternal_genotype_probability =
+      (2.-int(w==v)) * frequency[w] * frequency[v]; //hwe prior
+    double log_halfsib_likelihood = log(maternal_genotype_probability);
+    if (arma::prod(maternal_phenotype))
+    {
+      double maternal_phenotype_probability =
+        genotyping_error_model(maternal_phenotype, w+1, v+1, number_of_alleles, dropout_rate, mistyping_rate);
+      log_halfsib_likelihood += log(maternal_phenotype_probability);
+    }
+    for (auto& offspring_group : offspring_from_father)
+    {
+      double fullsib_likelihood = 0.;
+      double fullsib_running_maximum = -arma::datum::inf;
+      for (unsigned u=0; u<MAX_ALLELES; ++u) // paternal allele
+      {
+        if (u >= number_of_alleles) break; //padding
+        double log_fullsib_likelihood = log(frequency[u]); //hwe prior
+        for (auto offspring : offspring_group)
+        {
+          const std::array<double, MAX_ALLELES*MAX_ALLELES>& probability = emission[offspring];
+          log_fullsib_likelihood += // Mendelian segregation probs * phenotype probabilities
+            log(0.5 * probability[w*MAX_ALLELES + u] + 0.5 * probability[v*MAX_ALLELES + u]);
+        }
+        if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
+        {
+          fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
+        } else {
+          fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
+          fullsib_likelihood += 1.;
+          fullsib_running_maximum = log_fullsib_likelihood;
+        }
+      }
+      log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
+    }
+    if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
+    {
+      halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
+    } else {
+      halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
+      halfsib_likelihood += 1.;
+      halfsib_running_maximum = log_halfsib_likelihood;
+    }
+  }
+  return log(halfsib_likelihood) + halfsib_running_maximum;
+}
+
+typedef double (*paternity_likelihood_kernel)
+ (const arma::uvec&, const arma::umat&, const arma::uvec&, const arma::vec&, const double&, const double&);
+
+inline paternity_likelihood_kernel select_paternity_likelihood_kernel
+ (const unsigned number_of_alleles)
+{
+  // smallest bucket that fits; above 32 alleles, paternity_loglikelihood_by_locus_matrix
+  if (number_of_alleles <= 4) return &paternity_loglikelihood_by_locus_fixed<4>;
+  if (number_of_alleles <= 8) return &paternity_loglikelihood_by_locus_fixed<8>;
+  if (number_of_alleles <= 16) return &paternity_loglikelihood_by_locus_fixed<16>;
+  if (number_of_alleles <= 32) return &paternity_loglikelihood_by_locus_fixed<32>;
+  return &paternity_loglikelihood_by_locus_matrix;
+}
+
+inline std::vector<paternity_likelihood_kernel> select_paternity_likelihood_kernels
+ (const std::vector<arma::vec>& allele_frequencies)
+{
+  // one kernel per locus
+  std::vector<paternity_likelihood_kernel> kernels;
+  for (auto& frequencies : allele_frequencies)
+  {
+    kernels.push_back(select_paternity_likelihood_kernel(frequencies.n_elem));
+  }
+  return kernels;
+}
+
+} // namespace sydneyPaternity
+
+#endif
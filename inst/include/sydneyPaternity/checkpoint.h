@@ -0,0 +1,134 @@
+#ifndef _SYDNEYPATERNITY_CORE_CHECKPOINT_H
+#define _SYDNEYPATERNITY_CORE_CHECKPOINT_H
+
+#include <armadillo>
+#include <vector>
+#include <string>
+#include <istream>
+#include <ostream>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+// Binary serialization of sampler state, so that long chains can be checkpointed
+// and resumed. Files are only meant to be read back by the same build on the same
+// platform (native byte order, Armadillo's arma_binary format for matrices).
+
+namespace sydneyPaternity {
+
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void write_checkpoint_value (std::ostream& stream, const T& value)
+{
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+void read_checkpoint_value (std::istream& stream, T& value)
+{
+  stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+  if (!stream) throw std::runtime_error("truncated checkpoint");
+}
+
+inline void write_checkpoint_value (std::ostream& stream, const std::string& value)
+{
+  const uint64_t length = value.size();
+  write_checkpoint_value(stream, length);
+  stream.write(value.data(), length);
+}
+
+inline void read_checkpoint_value (std::istream& stream, std::string& value)
+{
+  uint64_t length;
+  read_checkpoint_value(stream, length);
+  value.resize(length);
+  stream.read(&value[0], length);
+  if (!stream) throw std::runtime_error("truncated checkpoint");
+}
+
+template <typename eT>
+void write_checkpoint_value (std::ostream& stream, const arma::Mat<eT>& value)
+{
+  if (!value.save(stream, arma::arma_binary)) throw std::runtime_error("could not write checkpoint");
+}
+
+template <typename eT>
+void read_checkpoint_value (std::istream& stream, arma::Mat<eT>& value)
+{
+  if (!value.load(stream, arma::arma_binary)) throw std::runtime_error("corrupt checkpoint");
+}
+
+template <typename eT>
+void write_checkpoint_value (std::ostream& stream, const arma::Col<eT>& value)
+{
+  if (!value.save(stream, arma::arma_binary)) throw std::runtime_error("could not write checkpoint");
+}
+
+template <typename eT>
+void read_checkpoint_value (std::istream& stream, arma::Col<eT>& value)
+{
+  if (!value.load(stream, arma::arma_binary)) throw std::runtime_error("corrupt checkpoint");
+}
+
+template <typename eT>
+void write_checkpoint_value (std::ostream& stream, const arma::Cube<eT>& value)
+{
+  if (!value.save(stream, arma::arma_binary)) throw std::runtime_error("could not write checkpoint");
+}
+
+template <typename eT>
+void read_checkpoint_value (std::istream& stream, arma::Cube<eT>& value)
+{
+  if (!value.load(stream, arma::arma_binary)) throw std::runtime_error("corrupt checkpoint");
+}
+
+template <typename T>
+void write_checkpoint_value (std::ostream& stream, const std::vector<T>& value)
+{
+  const uint64_t length = value.size();
+  write_checkpoint_value(stream, length);
+  for (auto& element : value) write_checkpoint_value(stream, element);
+}
+
+template <typename T>
+void read_checkpoint_value (std::istream& stream, std::vector<T>& value)
+{
+  uint64_t length;
+  read_checkpoint_value(stream, length);
+  value.resize(length);
+  for (auto& element : value) read_checkpoint_value(stream, element);
+}
+
+template <class STATE>
+void save_checkpoint (const STATE& state, const std::string& filename)
+{
+  // write to a temporary file and rename, so that an interrupted write
+  // leaves the previous checkpoint intact
+  const std::string temporary = filename + ".tmp";
+  {
+    std::ofstream stream (temporary, std::ios::binary | std::ios::trunc);
+    if (!stream) throw std::runtime_error("could not open checkpoint " + temporary);
+    state.write(stream);
+    stream.flush();
+    if (!stream) throw std::runtime_error("could not write checkpoint " + temporary);
+  }
+  if (std::rename(temporary.c_str(), filename.c_str()) != 0) 
+  {
+    throw std::runtime_error("could not replace checkpoint " + filename);
+  }
+}
+
+template <class STATE>
+STATE load_checkpoint (const std::string& filename)
+{
+  std::ifstream stream (filename, std::ios::binary);
+  if (!stream) throw std::runtime_error("could not open checkpoint " + filename);
+  STATE state;
+  state.read(stream);
+  return state;
+}
+
+} // namespace sydneyPaternity
+
+#endif
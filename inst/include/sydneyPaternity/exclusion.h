@@ -0,0 +1,125 @@
+#ifndef _SYDNEYPATERNITY_CORE_EXCLUSION_H
+#define _SYDNEYPATERNITY_CORE_EXCLUSION_H
+
+#include <armadillo>
+#include <vector>
+#include <bitset>
+#include <cstdint>
+#include <stdexcept>
+
+// Exclusion of implausible parent pairs by Mendelian mismatches, for large sets of
+// candidate parents. For each locus and allele there is a bitmask over candidate
+// fathers (haploid) carrying that allele. An offspring phenotype (a, b) is compatible
+// with mother (w, v) and father u if the mother carries a and the father b, or vice
+// versa; for each mother, the fathers with more than "tolerance" incompatible loci are
+// found 64 at a time with bit-sliced counters, and the rest are candidates.
+
+namespace sydneyPaternity {
+
+class parent_exclusion_index
+{
+  typedef uint64_t word;
+  unsigned number_of_fathers;
+  unsigned number_of_mothers;
+  unsigned number_of_words;
+  arma::ucube maternal_genotypes; //2 x mothers x loci
+  arma::uvec number_of_alleles;
+  std::vector<std::vector<word>> fathers_with_allele; //per locus, (allele, word), alleles 1-based
+
+  word valid_fathers (const unsigned i) const
+  {
+    // mask for the fathers in the i'th word
+    const unsigned remainder = number_of_fathers - 64*i;
+    return remainder >= 64 ? ~word(0) : (word(1) << remainder) - 1;
+  }
+
+  public:
+  parent_exclusion_index
+   (const arma::ucube& maternal_genotypes,
+    const arma::ucube& paternal_genotypes,
+    const arma::uvec& number_of_alleles) :
+    number_of_fathers(paternal_genotypes.n_cols), number_of_mothers(maternal_genotypes.n_cols),
+    number_of_words((paternal_genotypes.n_cols + 63)/64), maternal_genotypes(maternal_genotypes),
+    number_of_alleles(number_of_alleles)
+  {
+    // genotypes are 1-based alleles, as in the samplers; fathers are haploid (first row)
+    if (maternal_genotypes.n_rows != 2) throw std::invalid_argument("maternal genotypes must have 2 rows");
+    if (maternal_genotypes.n_slices != number_of_alleles.n_elem) throw std::invalid_argument("maternal genotypes must have a slice for each locus");
+    if (paternal_genotypes.n_slices != number_of_alleles.n_elem) throw std::invalid_argument("paternal genotypes must have a slice for each locus");
+    for (unsigned locus=0; locus<number_of_alleles.n_elem; ++locus)
+    {
+      std::vector<word> mask ((number_of_alleles[locus]+1) * number_of_words, 0);
+      for (unsigned father=0; father<number_of_fathers; ++father)
+      {
+        const unsigned allele = paternal_genotypes.at(0, father, locus);
+        if (allele < 1 || allele > number_of_alleles[locus]) throw std::out_of_range("paternal allele out of range");
+        mask[allele*number_of_words + father/64] |= word(1) << (father % 64);
+      }
+      fathers_with_allele.push_back(mask);
+    }
+  }
+
+  arma::uvec candidates (const arma::umat& offspring_phenotype, const unsigned tolerance) const
+  {
+    // pairs (father + number_of_fathers * mother) with at most "tolerance" incompatible loci, given the
+    // offspring's 2 x loci phenotype; loci where the phenotype is missing (0) are compatible
+    if (offspring_phenotype.n_rows != 2 || offspring_phenotype.n_cols != number_of_alleles.n_elem)
+    {
+      throw std::invalid_argument("offspring phenotype must be 2 x loci");
+    }
+    const unsigned levels = tolerance + 2;
+    std::vector<word> at_least (levels * number_of_words); //(k, word): fathers with at least k incompatible loci
+    std::vector<arma::uword> pairs;
+    for (unsigned mother=0; mother<number_of_mothers; ++mother)
+    {
+      for (unsigned i=0; i<number_of_words; ++i)
+      {
+        at_least[i] = valid_fathers(i);
+        for (unsigned k=1; k<levels; ++k) at_least[k*number_of_words + i] = 0;
+      }
+      for (unsigned locus=0; locus<number_of_alleles.n_elem; ++locus)
+      {
+        const unsigned a = offspring_phenotype.at(0, locus), b = offspring_phenotype.at(1, locus);
+        if (!a || !b) continue;
+        const unsigned w = maternal_genotypes.at(0, mother, locus), v = maternal_genotypes.at(1, mother, locus);
+        const bool carries_a = w == a || v == a;
+        const bool carries_b = w == b || v == b;
+        const word* fathers_with_a = &fathers_with_allele[locus][a*number_of_words];
+        const word* fathers_with_b = &fathers_with_allele[locus][b*number_of_words];
+        for (unsigned i=0; i<number_of_words; ++i)
+        {
+          const word compatible = (carries_a ? fathers_with_b[i] : 0) | (carries_b ? fathers_with_a[i] : 0);
+          const word mismatch = ~compatible & valid_fathers(i);
+          for (unsigned k=levels-1; k>0; --k) //saturating count, highest level first
+          {
+            at_least[k*number_of_words + i] |= at_least[(k-1)*number_of_words + i] & mismatch;
+          }
+        }
+      }
+      for (unsigned i=0; i<number_of_words; ++i)
+      {
+        word allowed = ~at_least[(levels-1)*number_of_words + i] & valid_fathers(i);
+        pairs.reserve(pairs.size() + std::bitset<64>(allowed).count());
+        for (unsigned bit=0; allowed; ++bit, allowed >>= 1)
+        {
+          if (allowed & 1) pairs.push_back(64*i + bit + number_of_fathers * mother);
+        }
+      }
+    }
+    return arma::uvec(pairs);
+  }
+
+  unsigned fathers (void) const
+  {
+    return number_of_fathers;
+  }
+
+  unsigned mothers (void) const
+  {
+    return number_of_mothers;
+  }
+};
+
+} // namespace sydneyPaternity
+
+#endif
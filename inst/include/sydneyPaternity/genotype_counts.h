@@ -0,0 +1,88 @@
+#ifndef _SYDNEYPATERNITY_CORE_GENOTYPE_COUNTS_H
+#define _SYDNEYPATERNITY_CORE_GENOTYPE_COUNTS_H
+
+#include <armadillo>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+// Sparse tally of the genotypes visited by each individual at a locus, in place
+// of a dense alleles x alleles x individuals cube. Over a chain an individual
+// visits a handful of genotypes, so each keeps a short list of (genotype, count).
+// Genotypes are unordered, so pairs are folded onto the upper triangle (first
+// allele <= second allele) and sorted by column-major position within it; the
+// output is the same sparse list, never a dense cube.
+
+namespace sydneyPaternity {
+
+class genotype_counts
+{
+  typedef std::pair<uint32_t, double> entry; //packed upper-triangle genotype index, count
+  uint32_t number_of_alleles;
+  std::vector<std::vector<entry>> counts;
+
+  public:
+  genotype_counts (const unsigned number_of_alleles = 0, const unsigned number_of_individuals = 0) :
+    number_of_alleles(number_of_alleles), counts(number_of_individuals) {}
+
+  void add (const unsigned individual, const unsigned first, const unsigned second, const double weight = 1.)
+  {
+    // alleles are 1-based
+    if (first < 1 || first > number_of_alleles || second < 1 || second > number_of_alleles)
+    {
+      throw std::out_of_range("allele out of range");
+    }
+    const uint32_t lower = std::min(first, second) - 1, upper = std::max(first, second) - 1;
+    const uint32_t genotype = upper * (upper + 1) / 2 + lower; //packed upper triangle
+    std::vector<entry>& tally = counts.at(individual);
+    auto position = tally.begin();
+    while (position != tally.end() && position->first < genotype) ++position;
+    if (position != tally.end() && position->first == genotype)
+    {
+      position->second += weight;
+    } else {
+      tally.insert(position, entry(genotype, weight));
+    }
+  }
+
+  arma::mat triplets (const double scale = 1.) const
+  {
+    // one row per visited genotype: individual, first allele, second allele (all 1-based, first <= second), 
+    // scaled count; rows are sorted by individual then by column-major position in the upper triangle, so
+    // the first maximum per individual is the one R's which(x == max(x), arr.ind=TRUE)[1,] would pick
+    unsigned number_of_entries = 0;
+    for (auto& tally : counts) number_of_entries += tally.size();
+    arma::mat out (number_of_entries, 4);
+    unsigned row = 0;
+    for (unsigned i=0; i<counts.size(); ++i)
+    {
+      for (auto& visited : counts[i])
+      {
+        uint32_t upper = 0;
+        while ((upper + 1) * (upper + 2) / 2 <= visited.first) ++upper;
+        out.at(row, 0) = i + 1;
+        out.at(row, 1) = visited.first - upper * (upper + 1) / 2 + 1;
+        out.at(row, 2) = upper + 1;
+        out.at(row, 3) = visited.second * scale;
+        row++;
+      }
+    }
+    return out;
+  }
+
+  unsigned alleles (void) const
+  {
+    return number_of_alleles;
+  }
+
+  unsigned individuals (void) const
+  {
+    return counts.size();
+  }
+};
+
+} // namespace sydneyPaternity
+
+#endif
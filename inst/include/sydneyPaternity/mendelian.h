@@ -0,0 +1,150 @@
+#ifndef _SYDNEYPATERNITY_CORE_MENDELIAN_H
+#define _SYDNEYPATERNITY_CORE_MENDELIAN_H
+
+#include <array>
+#include <cmath>
+
+// Scalar phenotype error and Mendelian transmission probabilities, specialized for
+// diploid and haploid individuals, for the innermost loops of the genotype-augmented
+// samplers. Alleles are passed by value and nothing is allocated; the batched forms
+// fill a caller-owned buffer with the probabilities of one offspring phenotype given
+// every maternal allele (and paternal allele). Alleles are 1-based, as in phenotypes.
+
+namespace sydneyPaternity {
+
+struct genotyping_error_rates
+{
+  double e1; //dropout rate
+  double e2; //probability of mistyping to a particular allele
+  double E2; //mistyping rate
+  bool monomorphic;
+
+  genotyping_error_rates (const unsigned number_of_alleles, const double dropout_rate, const double mistyping_rate) :
+    e1(dropout_rate), e2(number_of_alleles > 1 ? mistyping_rate/double(number_of_alleles-1) : 0.),
+    E2(mistyping_rate), monomorphic(number_of_alleles == 1) {}
+};
+
+inline double diploid_phenotype_probability
+ (const unsigned first_phenotype, const unsigned second_phenotype,
+  const unsigned first_genotype, const unsigned second_genotype,
+  const genotyping_error_rates& rate)
+{
+  // same as phenotype_error_model for diploids (Eqs 1 & 2 in Wang 2004 Genetics)
+  if (rate.monomorphic) return 1.;
+  const double e1 = rate.e1, e2 = rate.e2, E2 = rate.E2;
+  const bool phenotype_is_homozygous = first_phenotype == second_phenotype;
+  if (first_genotype == second_genotype)
+  {
+    const bool first_matches = first_phenotype == first_genotype;
+    const bool second_matches = second_phenotype == first_genotype;
+    if (phenotype_is_homozygous && first_matches) return (1.-E2)*(1.-E2);
+    if (first_matches != second_matches) return 2.*e2*(1.-E2);
+    return (2.-int(phenotype_is_homozygous))*e2*e2;
+  }
+  if ((first_phenotype == first_genotype && second_phenotype == second_genotype) ||
+      (second_phenotype == first_genotype && first_phenotype == second_genotype))
+  {
+    return (1.-E2)*(1.-E2) + e2*e2 - 2.*e1*(1.-E2-e2)*(1.-E2-e2);
+  }
+  if (phenotype_is_homozygous && (first_phenotype == first_genotype || first_phenotype == second_genotype))
+  {
+    return e2*(1.-E2) + e1*(1.-E2-e2)*(1.-E2-e2);
+  }
+  if (first_phenotype != first_genotype && first_phenotype != second_genotype &&
+      second_phenotype != first_genotype && second_phenotype != second_genotype)
+  {
+    return (2.-int(phenotype_is_homozygous))*e2*e2;
+  }
+  return e2*(1.-E2+e2); // Wang 2018 has (1-E2-e2) and Wang 2004 has (1-E2+e2), latter is correct
+}
+
+inline double haploid_phenotype_probability
+ (const unsigned phenotype, const unsigned genotype, const genotyping_error_rates& rate)
+{
+  // only mistyping errors
+  if (rate.monomorphic) return 1.;
+  return phenotype == genotype ? 1.-rate.E2 : rate.e2;
+}
+
+inline double diploid_mendelian_probability
+ (const unsigned first_phenotype, const unsigned second_phenotype,
+  const unsigned first_maternal_allele, const unsigned second_maternal_allele,
+  const unsigned paternal_allele,
+  const genotyping_error_rates& rate)
+{
+  // diploid offspring of a diploid mother and haploid father; offspring genotypes are
+  // ordered (maternal, paternal) as in mendelian_genotype_model
+  return 0.5 * diploid_phenotype_probability(first_phenotype, second_phenotype, first_maternal_allele, paternal_allele, rate) +
+    0.5 * diploid_phenotype_probability(first_phenotype, second_phenotype, second_maternal_allele, paternal_allele, rate);
+}
+
+inline double haploid_mendelian_probability
+ (const unsigned phenotype,
+  const unsigned first_maternal_allele, const unsigned second_maternal_allele,
+  const genotyping_error_rates& rate)
+{
+  // haploid offspring of a diploid mother
+  return 0.5 * haploid_phenotype_probability(phenotype, first_maternal_allele, rate) +
+    0.5 * haploid_phenotype_probability(phenotype, second_maternal_allele, rate);
+}
+
+inline void diploid_transmission_column
+ (const unsigned first_phenotype, const unsigned second_phenotype,
+  const unsigned paternal_allele,
+  const unsigned number_of_alleles,
+  const genotyping_error_rates& rate,
+  double* probability)
+{
+  // probability[a] = P(offspring phenotype | maternal allele a+1, paternal allele); a maternal
+  // genotype (w, v) then has probability 0.5 * (probability[w-1] + probability[v-1])
+  for (unsigned a=0; a<number_of_alleles; ++a)
+  {
+    probability[a] = diploid_phenotype_probability(first_phenotype, second_phenotype, a+1, paternal_allele, rate);
+  }
+}
+
+inline void diploid_transmission_table
+ (const unsigned first_phenotype, const unsigned second_phenotype,
+  const unsigned number_of_alleles,
+  const genotyping_error_rates& rate,
+  double* probability)
+{
+  // column-major alleles x alleles table, probability[a + number_of_alleles * u] =
+  // P(offspring phenotype | maternal allele a+1, paternal allele u+1)
+  for (unsigned u=0; u<number_of_alleles; ++u)
+  {
+    diploid_transmission_column(first_phenotype, second_phenotype, u+1, number_of_alleles, rate,
+        probability + number_of_alleles * u);
+  }
+}
+
+template <class RNG>
+std::array<unsigned, 2> sample_diploid_mendelian_genotype
+ (const unsigned first_phenotype, const unsigned second_phenotype,
+  const unsigned first_maternal_allele, const unsigned second_maternal_allele,
+  const unsigned paternal_allele,
+  const genotyping_error_rates& rate,
+  RNG& rng)
+{
+  // (maternal allele, paternal allele) given the phenotype, in one draw
+  const double first = diploid_phenotype_probability(first_phenotype, second_phenotype, first_maternal_allele, paternal_allele, rate);
+  const double second = diploid_phenotype_probability(first_phenotype, second_phenotype, second_maternal_allele, paternal_allele, rate);
+  const bool first_is_transmitted = rng.uniform() * (first + second) < first;
+  return {{first_is_transmitted ? first_maternal_allele : second_maternal_allele, paternal_allele}};
+}
+
+template <class RNG>
+unsigned sample_haploid_mendelian_genotype
+ (const unsigned phenotype,
+  const unsigned first_maternal_allele, const unsigned second_maternal_allele,
+  const genotyping_error_rates& rate,
+  RNG& rng)
+{
+  const double first = haploid_phenotype_probability(phenotype, first_maternal_allele, rate);
+  const double second = haploid_phenotype_probability(phenotype, second_maternal_allele, rate);
+  return rng.uniform() * (first + second) < first ? first_maternal_allele : second_maternal_allele;
+}
+
+} // namespace sydneyPaternity
+
+#endif
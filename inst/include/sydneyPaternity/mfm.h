@@ -0,0 +1,91 @@
+#ifndef _SYDNEYPATERNITY_CORE_MFM_H
+#define _SYDNEYPATERNITY_CORE_MFM_H
+
+#include <armadillo>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+// Coefficients V_n(t) of the mixture-of-finite-mixtures prior with a uniform prior on
+// 1..K components (Eq 3.2 in Miller & Harrison 2015), for all t = 1..n at once:
+//   V_n(t) = sum_{k=t}^K k!/(k-t)! / (gamma k)^(n) / K
+// The log factorials and log ascending factorials are tabulated once over k (O(K) lgamma
+// calls), so each term is a sum of table entries, and each V_n(t) is the exact sum of its
+// terms, relative to the largest (log_uniform_MFM_prior in the package makes lgamma calls
+// for every term). Tables for the samplers, which allow as many components as observations
+// (K = n), are cached by (n, gamma) and shared across calls and threads.
+
+namespace sydneyPaternity {
+
+inline arma::vec log_uniform_mfm_coefficients
+ (const unsigned n, const double gamma, const unsigned max_number_of_components)
+{
+  // element t-1 is log V_n(t); V_n(t) = 0 for t > max_number_of_components
+  if (n == 0) throw std::invalid_argument("need at least one observation");
+  if (gamma <= 0.) throw std::invalid_argument("mfm concentration must be positive");
+  if (max_number_of_components == 0) throw std::invalid_argument("need at least one component");
+
+  const unsigned K = max_number_of_components;
+  arma::vec log_factorial (K + 1); //log k!
+  arma::vec log_ascending_factorial (K + 1); //log (gamma k)^(n)
+  log_factorial[0] = 0.;
+  log_ascending_factorial[0] = 0.;
+  for (unsigned k=1; k<=K; ++k)
+  {
+    log_factorial[k] = log_factorial[k-1] + std::log(double(k));
+    log_ascending_factorial[k] = std::lgamma(gamma * double(k) + double(n)) - std::lgamma(gamma * double(k));
+  }
+
+  const double log_prior = -std::log(double(K));
+  arma::vec coefficients (n);
+  coefficients.fill(-arma::datum::inf);
+  arma::vec log_terms (K);
+  for (unsigned t=1; t<=std::min(n, K); ++t)
+  {
+    for (unsigned k=t; k<=K; ++k)
+    {
+      log_terms[k-t] = log_factorial[k] - log_factorial[k-t] - log_ascending_factorial[k] + log_prior;
+    }
+    const arma::vec terms = log_terms.head(K - t + 1);
+    const double maximum = terms.max();
+    coefficients[t-1] = log(arma::accu(arma::exp(terms - maximum))) + maximum;
+  }
+  return coefficients;
+}
+
+inline std::shared_ptr<const arma::vec> cached_log_uniform_mfm_coefficients
+ (const unsigned n, const double gamma, bool* cache_hit = nullptr)
+{
+  // log_uniform_mfm_coefficients with K = n, computed once per (n, gamma) and kept for the life 
+  // of the process; the cache is cleared when it gets large, which only costs recomputation.
+  // If "cache_hit" is given, it is set to whether the table was already cached
+  typedef std::pair<unsigned, double> key;
+  static std::map<key, std::shared_ptr<const arma::vec>> cache;
+  static std::mutex cache_mutex;
+  const unsigned max_cache_size = 256;
+
+  const key index (n, gamma);
+  {
+    std::lock_guard<std::mutex> lock (cache_mutex);
+    auto found = cache.find(index);
+    if (cache_hit) *cache_hit = found != cache.end();
+    if (found != cache.end()) return found->second;
+  }
+  std::shared_ptr<const arma::vec> coefficients =
+    std::make_shared<const arma::vec>(log_uniform_mfm_coefficients(n, gamma, n));
+  {
+    // if another thread got there first, its table is kept and returned, so that
+    // every caller shares one table per key
+    std::lock_guard<std::mutex> lock (cache_mutex);
+    if (cache.size() >= max_cache_size) cache.clear();
+    return cache.emplace(index, coefficients).first->second;
+  }
+}
+
+} // namespace sydneyPaternity
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef _SYDNEYPATERNITY_CORE_PARALLEL_H
+#define _SYDNEYPATERNITY_CORE_PARALLEL_H
+
+#include <exception>
+
+// Parallel loops over independent tasks (loci, individuals, colonies). Exceptions must not
+// escape an OpenMP region (that terminates the process), so they are captured per task and
+// rethrown on the calling thread, where the R interface turns them into ordinary errors.
+
+namespace sydneyPaternity {
+
+template <class Task>
+void run_parallel_tasks (const unsigned number_of_tasks, const unsigned number_of_threads, Task task)
+{
+  // task(i) for i in [0, number_of_tasks) over "number_of_threads"; an exception thrown by a task is 
+  // rethrown on the calling thread once all tasks are done, rather than escaping the parallel region
+  std::exception_ptr error = nullptr;
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(number_of_threads)
+  #endif
+  for (int i=0; i<int(number_of_tasks); ++i)
+  {
+    try
+    {
+      task(unsigned(i));
+    }
+    catch (...)
+    {
+      #ifdef _OPENMP
+      #pragma omp critical
+      #endif
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+} // namespace sydneyPaternity
+
+#endif
@@ -0,0 +1,1862 @@
+#ifndef _SYDNEYPATERNITY_CORE_PARENTAGE_H
+#define _SYDNEYPATERNITY_CORE_PARENTAGE_H
+
+#include <armadillo>
+#include <vector>
+#include <tuple>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+#include "random.h"
+#include "parallel.h"
+#include "profiling.h"
+#include "checkpoint.h"
+#include "trace.h"
+#include "scaled.h"
+
+// R-independent core of the parentage sampler (sample_parentage_and_error_rates),
+// shared by the R package and the command-line sampler in inst/cli. Errors are
+// thrown as std::exception, which Rcpp turns into R errors. Samplers are templated
+// on the random number generator (see random.h).
+
+namespace sydneyPaternity {
+
+inline arma::umat recode_to_contiguous_integers (arma::umat input)
+{
+  arma::uvec uniq = arma::unique(input);
+  for(unsigned i=0; i<uniq.n_elem; ++i) input.replace(uniq.at(i), i);
+  return input;
+}
+
+inline std::vector<arma::vec> collapse_alleles_and_generate_genotype_prior
+ (arma::ucube& phenotypes, 
+  const bool add_unsampled_allele = false)
+{
+  // recode alleles into 1-based contiguous integers and return allele frequency prior
+  
+  const unsigned num_loci = phenotypes.n_slices;
+  std::vector<arma::vec> allele_frequencies;
+
+  for (unsigned locus=0; locus<num_loci; ++locus)
+  {
+    arma::uvec alleles = arma::unique(arma::nonzeros(phenotypes.slice(locus)));
+    for (int i=1; i<=alleles.n_elem; ++i)
+    {
+      phenotypes.slice(locus).replace(alleles.at(i-1), i);
+    }
+    unsigned number_of_alleles = alleles.n_elem + int(add_unsampled_allele);
+    arma::vec frequencies (number_of_alleles); 
+    frequencies.fill(1./double(number_of_alleles));
+    allele_frequencies.push_back(frequencies); 
+  }
+  return allele_frequencies;
+}
+
+inline std::vector<arma::uvec> unique_alleles
+ (const arma::ucube& phenotypes, 
+  const bool add_unsampled_allele = false)
+{
+  const unsigned num_loci = phenotypes.n_slices;
+  std::vector<arma::uvec> allele_names;
+  for (unsigned locus=0; locus<num_loci; ++locus)
+  {
+    arma::uvec alleles = arma::unique(arma::nonzeros(phenotypes.slice(locus)));
+    if (add_unsampled_allele) alleles = arma::join_vert(alleles, arma::uvec({999}));
+    allele_names.push_back(alleles);
+  }
+  return allele_names;
+}
+
+inline double genotyping_error_model 
+ (const arma::uvec& phenotype,
+  const unsigned& genotype0, 
+  const unsigned& genotype1, 
+  const unsigned& number_of_alleles,
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // from Eqs 1 & 2 in Wang 2004 Genetics
+  const double e1 = dropout_rate;
+  const double e2 = mistyping_rate/double(number_of_alleles-1);
+  const double E2 = mistyping_rate;
+
+  const arma::uvec genotype = {genotype0, genotype1};
+  const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
+  const bool genotype_is_homozygous = genotype[0] == genotype[1];
+
+  if (number_of_alleles == 1) return 1.; //monomorphic loci
+
+  if (genotype_is_homozygous) 
+  {
+    if (phenotype_is_homozygous && phenotype[0] == genotype[0])
+    {
+      return std::pow(1.-E2, 2);
+    } else if ((phenotype[0] == genotype[0] && phenotype[1] != genotype[0]) || 
+               (phenotype[0] != genotype[0] && phenotype[1] == genotype[0]) ){
+      return 2.*e2*(1-E2);
+    } else if (phenotype[0] != genotype[0] && phenotype[1] != genotype[0]) {
+      return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
+    }  
+  } else {
+    if ( (phenotype[0] == genotype[0] && phenotype[1] == genotype[1]) ||
+         (phenotype[1] == genotype[0] && phenotype[0] == genotype[1]) )
+    {
+      return std::pow(1.-E2, 2) + std::pow(e2, 2) - 2.*e1*std::pow(1.-E2-e2, 2);
+    } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
+      return e2*(1.-E2) + e1*std::pow(1.-E2-e2, 2);
+    } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
+               phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
+      return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
+    } else {
+      // Wang 2018 has (1-E2-e2) and Wang 2004 has (1-E2+e2), latter is correct
+      return e2*(1.-E2+e2);
+    }
+  }
+  return 0.;
+}
+
+template <class RNG>
+arma::uvec simulate_genotyping_errors
+ (const arma::uvec& phenotype,
+  const unsigned& genotype0, 
+  const unsigned& genotype1, 
+  const unsigned& number_of_alleles,
+  const double& dropout_rate, 
+  const double& mistyping_rate,
+  RNG& rng)
+{
+  const double e1 = dropout_rate;
+  const double e2 = mistyping_rate/double(number_of_alleles-1);
+  const double E2 = mistyping_rate;
+
+  const arma::uvec genotype = {genotype0, genotype1};
+  const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
+  const bool genotype_is_homozygous = genotype[0] == genotype[1];
+
+  if (number_of_alleles == 1) return arma::uvec({0,0}); //monomorphic loci
+
+  if (genotype_is_homozygous) 
+  {
+    if (phenotype_is_homozygous && phenotype[0] == genotype[0])
+    {
+      return arma::uvec({0, 0});
+    } else if ((phenotype[0] == genotype[0] && phenotype[1] != genotype[0]) || 
+               (phenotype[0] != genotype[0] && phenotype[1] == genotype[0]) ){
+      return arma::uvec({0, 1});
+    } else if (phenotype[0] != genotype[0] && phenotype[1] != genotype[0]) {
+      return arma::uvec({0, 2});
+    }  
+  } else {
+    if ( (phenotype[0] == genotype[0] && phenotype[1] == genotype[1]) ||
+         (phenotype[1] == genotype[0] && phenotype[0] == genotype[1]) )
+    {
+      // either: no errors occurred OR 
+      //         there was no dropout error but two typing errors
+      //         there was a dropout error that got fixed by single typing error
+      // prop.table(c((1-2*e1)*(1-E2)^2, (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)))
+      // sum(c((1-2*e1)*(1-E2)^2, (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)))
+      // (1-E2)^2 + e2^2 - 2*e1*(1-E2-e2)^2
+      // [0,0] [0,2] [1,1]
+      const arma::vec probs = {(1-2*e1)*(1-E2)*(1-E2), (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)};
+      const arma::umat counts = {{0,0},{0,2},{1,1}};
+      return counts.row(rng.categorical(probs)).t();
+    } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
+      // one class 2 error OR there was a dropout error and no typing errors
+      // prop.table(c(e1*(1-E2)^2, (1-2*e1)*e2*(1-E2), e1*e2*e2))
+      // sum(c(e1*(1-E2)^2, (1-2*e1)*e2*(1-E2), e1*e2*e2))
+      // e2*(1-E2) + e1*(1-E2-e2)^2
+      // [0 1] [1 0] [1 2]
+      const arma::vec probs = {e1*(1-E2)*(1-E2), (1-2*e1)*e2*(1-E2), e1*e2*e2};
+      const arma::umat counts = {{1,0},{0,1},{1,2}};
+      return counts.row(rng.categorical(probs)).t();
+    } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
+               phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
+      // two class 2 errors occurred, regardless of whether class 1 error occurs
+      // prop.table(c( (1-2*e1)*e2*e2 , 2*e1*e2*e2 ))
+      // [0 2] [1 2]
+      const arma::vec probs = {(1-2*e1)*e2*e2, 2*e1*e2*e2};
+      const arma::umat counts = {{0,2},{1,2}};
+      return counts.row(rng.categorical(probs)).t();
+    } else {
+      // "otherwise" ... there's one match but phenotype is heterozygous?
+      // 1. could have: sequencing error at one, no sequencing error at other
+      // 2. sequencing error gets fixed by second sequencing error
+      // dropout could happen in either case
+      // prop.table(c( (1-2*e1)*e2*(1-E2), (1-2*e1)*e2*e2, 2*e1*e2*(1-E2), 2*e1*e2*e2 ))
+      // [0 1] [0 2] [1 1] [1 2]
+      const arma::vec probs = {(1-2*e1)*e2*(1-E2), (1-2*e1)*e2*e2, 2*e1*e2*(1-E2), 2*e1*e2*e2};
+      const arma::umat counts = {{0,1},{0,2},{1,1},{1,2}};
+      return counts.row(rng.categorical(probs)).t();
+    }
+  }
+  return arma::uvec{{0,0}};
+}
+
+template <class RNG>
+arma::uvec sample_matrix (arma::mat probabilities, RNG& rng)
+{
+  // draw (row, column) with probability proportional to entries
+  arma::uvec draw (2);
+  probabilities /= arma::accu(probabilities);
+  arma::vec row_sums = arma::sum(probabilities, 1);
+  draw[0] = rng.categorical(row_sums);
+  draw[1] = rng.categorical(arma::trans(probabilities.row(draw[0])));
+  return draw;
+}
+
+template <class RNG>
+std::tuple<arma::umat, arma::uvec, arma::uvec, arma::uvec, arma::uvec, arma::uvec> 
+sample_genotypes_given_parentage
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate,
+  RNG& rng)
+{
+  // assumes a single "known" maternal phenotype; index 0 in "maternity" refers to the associated mother
+  
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  // alternatively pass in as mutable argument
+  arma::umat maternal_genotypes (2, mothers.n_elem);
+  arma::umat offspring_genotypes (2, paternity.n_elem);
+  arma::uvec paternal_genotypes (fathers.n_elem);
+  maternal_genotypes.fill(arma::datum::nan);
+  offspring_genotypes.fill(arma::datum::nan);
+  paternal_genotypes.fill(arma::datum::nan);
+
+  // tabulate sib groups
+  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    offspring_counts.at(paternity[sib],maternity[sib])++;
+  }
+
+  // simulate maternal genotype; there are choose(k,2)+k possible genotypes
+  // marginalize over paternal & offspring genotypes to calculate posterior genotype probabilities
+  unsigned number_of_genotypes = number_of_alleles*(number_of_alleles + 1)/2;
+  for (auto mother : mothers)
+  {
+    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
+    arma::vec maternal_genotype_posterior (number_of_genotypes);
+    arma::umat possible_maternal_genotypes (2, number_of_genotypes);
+    unsigned genotype = 0;
+    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+    { 
+      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+      {
+        double maternal_genotype_probability = 
+          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+        double log_halfsib_likelihood = log(maternal_genotype_probability); 
+        if (mother == 0 && arma::prod(maternal_phenotype)) //index 0 is "phenotyped" mother
+        {
+          double maternal_phenotype_probability = 
+            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+          log_halfsib_likelihood += log(maternal_phenotype_probability);
+        }
+        for (auto father : mated_fathers)
+        {
+          double fullsib_likelihood = 0.;
+          double running_maximum = -arma::datum::inf;
+          arma::uvec offspring_from_father = arma::find(paternity == father);
+          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+          {
+            double paternal_genotype_probability = 
+              allele_frequencies_normalized[u-1]; //hwe prior
+            double log_fullsib_likelihood = log(paternal_genotype_probability);
+            for (auto offspring : offspring_from_father)
+            {
+              arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+              if (arma::prod(offspring_phenotype)) { 
+                double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
+                  0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
+                  0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
+                log_fullsib_likelihood += log(offspring_phenotype_probability);
+              }
+            }
+            if (log_fullsib_likelihood <= running_maximum) //underflow protection
+            {
+              fullsib_likelihood += exp(log_fullsib_likelihood - running_maximum);
+            } else {
+              fullsib_likelihood *= exp(running_maximum - log_fullsib_likelihood);
+              fullsib_likelihood += 1.;
+              running_maximum = log_fullsib_likelihood;
+            }
+          }
+          log_halfsib_likelihood += log(fullsib_likelihood) + running_maximum;
+        }
+        maternal_genotype_posterior.at(genotype) = log_halfsib_likelihood;
+        possible_maternal_genotypes.col(genotype) = arma::uvec({w, v});
+        genotype++;
+      }
+    }
+    maternal_genotype_posterior -= maternal_genotype_posterior.max();
+    maternal_genotypes.col(mother) = 
+      possible_maternal_genotypes.col(rng.categorical(arma::exp(maternal_genotype_posterior)));
+  }
+
+  // simulate paternal genotype; there are k possible genotypes
+  // paternal genotypes are conditionally independent with fixed maternal genotype
+  // calculate posterior genotype probabilities by marginalizing over offspring genotypes
+  for (auto father : fathers)
+  {
+    arma::vec paternal_genotype_posterior (number_of_alleles);
+    arma::uvec possible_paternal_genotypes (number_of_alleles);
+    arma::uvec offspring_from_father = arma::find(paternity == father);
+    for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+    {
+      double paternal_genotype_probability = 
+          allele_frequencies_normalized[u-1]; //hwe prior
+      double log_fullsib_likelihood = log(paternal_genotype_probability);
+      for (auto offspring : offspring_from_father)
+      {
+        arma::uvec maternal_genotype = maternal_genotypes.col(maternity[offspring]);
+        arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+        if (arma::prod(offspring_phenotype)) { 
+          double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
+            0.5 * genotyping_error_model(offspring_phenotype, maternal_genotype[0], u, number_of_alleles, dropout_rate, mistyping_rate) + 
+            0.5 * genotyping_error_model(offspring_phenotype, maternal_genotype[1], u, number_of_alleles, dropout_rate, mistyping_rate); 
+          log_fullsib_likelihood += log(offspring_phenotype_probability);
+        }
+      }
+      paternal_genotype_posterior[u-1] = log_fullsib_likelihood;
+      possible_paternal_genotypes[u-1] = u;
+    }
+    paternal_genotype_posterior -= paternal_genotype_posterior.max();
+    paternal_genotypes.at(father) = possible_paternal_genotypes.at(rng.categorical(arma::exp(paternal_genotype_posterior)));
+  }
+
+  // simulate offspring genotypes
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    arma::uvec maternal_genotype = maternal_genotypes.col(maternity[sib]);
+    arma::uvec offspring_phenotype = offspring_phenotypes.col(sib);
+    arma::vec offspring_genotype_posterior (2);
+    arma::umat possible_offspring_genotypes (2, 2);
+    for (unsigned i=0; i<2; ++i)
+    {
+      offspring_genotype_posterior[i] = log(0.5); //Mendelian segregation
+      if (arma::prod(offspring_phenotype)) { 
+        offspring_genotype_posterior[i] += 
+          log(genotyping_error_model(offspring_phenotype, maternal_genotype[i], 
+                paternal_genotypes.at(paternity.at(sib)), number_of_alleles, dropout_rate, mistyping_rate));
+      }
+      possible_offspring_genotypes.col(i) = 
+        arma::uvec({maternal_genotype[i], paternal_genotypes.at(paternity.at(sib))});
+    }
+    offspring_genotype_posterior -= offspring_genotype_posterior.max();
+    offspring_genotypes.col(sib) = 
+      possible_offspring_genotypes.col(rng.categorical(arma::exp(offspring_genotype_posterior)));
+  }
+
+  //simulate numbers of errors given genotypes and phenotypes
+  //0-index is the mother, remaining indices are offspring
+  arma::uvec dropouts (paternity.n_elem+1, arma::fill::zeros);
+  arma::uvec mistypes (paternity.n_elem+1, arma::fill::zeros);
+  arma::uvec heterozygous (paternity.n_elem+1, arma::fill::zeros);
+  arma::uvec nonmissing (paternity.n_elem+1, arma::fill::zeros);
+  if (arma::prod(maternal_phenotype))
+  {
+    arma::uvec maternal_genotype = maternal_genotypes.col(0); //genotype of phenotyped mother
+    arma::uvec errors =
+      simulate_genotyping_errors(maternal_phenotype, maternal_genotype[0], 
+          maternal_genotype[1], number_of_alleles, dropout_rate, mistyping_rate, rng);
+    dropouts.at(0) = errors.at(0);
+    mistypes.at(0) = errors.at(1);
+    nonmissing.at(0) += 2;
+    if (maternal_genotype[0] != maternal_genotype[1]) heterozygous.at(0) += 1;
+  }
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    arma::uvec offspring_phenotype = offspring_phenotypes.col(sib);
+    if (arma::prod(offspring_phenotype)) { 
+      arma::uvec errors =
+        simulate_genotyping_errors(offspring_phenotype, offspring_genotypes.at(0,sib), 
+          offspring_genotypes.at(1,sib), number_of_alleles, dropout_rate, mistyping_rate, rng);
+      dropouts.at(sib+1) = errors.at(0);
+      mistypes.at(sib+1) = errors.at(1);
+      nonmissing.at(sib+1) += 2;
+      if (offspring_genotypes.at(0,sib) != offspring_genotypes.at(1,sib)) heterozygous.at(sib+1) += 1;
+    }
+  }
+
+  // tally maternal/paternal alleles
+  arma::uvec allele_counts (number_of_alleles, arma::fill::zeros);
+  for (unsigned mother=0; mother<mothers.n_elem; ++mother)
+  {
+    allele_counts[maternal_genotypes.at(0,mother)-1]++;
+    allele_counts[maternal_genotypes.at(1,mother)-1]++;
+  }
+  for (unsigned father=0; father<fathers.n_elem; ++father)
+  {
+    allele_counts[paternal_genotypes[father]-1]++;
+  }
+
+  // output
+  arma::umat genotypes = arma::join_horiz(maternal_genotypes.col(0), offspring_genotypes);
+  return std::make_tuple(genotypes, allele_counts, dropouts, heterozygous, mistypes, nonmissing);
+}
+
+inline double parentage_loglikelihood_by_locus 
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // likelihood of offspring paternity given offspring phenotypes, maternal phenotype, haplodiploidy
+  // modified from Eqs 3 & 4 in Wang 2004 Genetics
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  // tabulate sib groups
+  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    offspring_counts.at(paternity[sib],maternity[sib])++;
+  }
+
+  double log_likelihood = 0;
+  for (auto mother : mothers)
+  {
+    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
+    double halfsib_likelihood = 0.;
+    double halfsib_running_maximum = -arma::datum::inf;
+    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+    { 
+      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+      {
+        double maternal_genotype_probability = 
+          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+        double log_halfsib_likelihood = log(maternal_genotype_probability); 
+        if (mother == 0 && arma::prod(maternal_phenotype)) //0'th mother is phenotyped
+        {
+          double maternal_phenotype_probability = 
+            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+          log_halfsib_likelihood += log(maternal_phenotype_probability);
+        }
+        for (auto father : mated_fathers)
+        {
+          double fullsib_likelihood = 0.;
+          double fullsib_running_maximum = -arma::datum::inf;
+          arma::uvec offspring_from_father = arma::find(paternity == father);
+          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+          {
+            double paternal_genotype_probability = 
+              allele_frequencies_normalized[u-1]; //hwe prior
+            double log_fullsib_likelihood = log(paternal_genotype_probability);
+            for (auto offspring : offspring_from_father)
+            {
+              arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+              if (arma::prod(offspring_phenotype)) { 
+                double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
+                  0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
+                  0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
+                log_fullsib_likelihood += log(offspring_phenotype_probability);
+              } 
+            }
+            if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
+            {
+              fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
+            } else {
+              fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
+              fullsib_likelihood += 1.;
+              fullsib_running_maximum = log_fullsib_likelihood;
+            }
+          }
+          log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
+        }
+        if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
+        {
+          halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
+        } else {
+          halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
+          halfsib_likelihood += 1.;
+          halfsib_running_maximum = log_halfsib_likelihood;
+        }
+      }
+    }
+    log_likelihood += log(halfsib_likelihood) + halfsib_running_maximum;
+  }
+  return log_likelihood;
+}
+
+inline double parentage_loglikelihood_by_locus_scaled
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // as parentage_loglikelihood_by_locus, but with products over offspring and sums over
+  // parental genotypes in linear space (see scaled.h), so that there is a single log
+  // per mother rather than a log per offspring and an exp per parental genotype
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  // tabulate sib groups
+  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    offspring_counts.at(paternity[sib],maternity[sib])++;
+  }
+
+  double log_likelihood = 0;
+  for (auto mother : mothers)
+  {
+    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
+    scaled_sum halfsib_likelihood;
+    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+    { 
+      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+      {
+        scaled_double halfsib_term =
+          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+        if (mother == 0 && arma::prod(maternal_phenotype)) //0'th mother is phenotyped
+        {
+          halfsib_term *= genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+        }
+        for (auto father : mated_fathers)
+        {
+          scaled_sum fullsib_likelihood;
+          arma::uvec offspring_from_father = arma::find(paternity == father);
+          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+          {
+            scaled_double fullsib_term = allele_frequencies_normalized[u-1]; //hwe prior
+            for (auto offspring : offspring_from_father)
+            {
+              arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+              if (arma::prod(offspring_phenotype)) { 
+                fullsib_term *= // Mendelian segregation probs * phenotype probabilities
+                  0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
+                  0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
+              } 
+            }
+            fullsib_likelihood.add(fullsib_term);
+          }
+          halfsib_term *= fullsib_likelihood.value();
+        }
+        halfsib_likelihood.add(halfsib_term);
+      }
+    }
+    log_likelihood += halfsib_likelihood.log();
+  }
+  return log_likelihood;
+}
+
+template <typename eT>
+arma::Mat<eT> offspring_emission_table
+ (const arma::umat& offspring_phenotypes,
+  const unsigned number_of_alleles,
+  const double dropout_rate,
+  const double mistyping_rate)
+{
+  // P(phenotype | genotype) for each offspring; column a + number_of_alleles*offspring
+  // holds probabilities across paternal alleles u for maternal allele a (1 if phenotype is missing)
+  arma::Mat<eT> emission (number_of_alleles, number_of_alleles * offspring_phenotypes.n_cols, arma::fill::ones);
+  for (unsigned offspring=0; offspring<offspring_phenotypes.n_cols; ++offspring)
+  {
+    arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+    if (!arma::prod(offspring_phenotype)) continue;
+    for (unsigned a=1; a<=number_of_alleles; ++a)
+    {
+      for (unsigned u=1; u<=number_of_alleles; ++u)
+      {
+        emission.at(u-1, a-1 + number_of_alleles*offspring) = 
+          eT(genotyping_error_model(offspring_phenotype, a, u, number_of_alleles, dropout_rate, mistyping_rate));
+      }
+    }
+  }
+  return emission;
+}
+
+// Matrix formulation of the locus likelihood. For a sib group, log P(offspring | maternal genotype (w, v),
+// paternal allele u) is a sum over offspring of log(0.5 * E(w, u) + 0.5 * E(v, u)), and the Mendelian
+// mixtures for every maternal genotype, paternal allele and offspring are a single product of a
+// genotypes x alleles design matrix with the stacked emission tables. Sums over paternal alleles are then
+// matrix-vector products. Both go through BLAS (gemm/gemv), which pays off at loci with many alleles.
+
+const unsigned matrix_likelihood_min_alleles = 16; //with fewer alleles, the loops are as fast
+
+inline arma::mat maternal_genotype_design (const unsigned number_of_alleles)
+{
+  // row for each maternal genotype (w, v >= w), in the order of the loops in parentage_loglikelihood_by_locus,
+  // with 1/2 on each allele, so that design * E(., u) is the Mendelian mixture of emission probabilities
+  const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
+  arma::mat design (number_of_genotypes, number_of_alleles, arma::fill::zeros);
+  unsigned genotype = 0;
+  for (unsigned w=0; w<number_of_alleles; ++w)
+  {
+    for (unsigned v=w; v<number_of_alleles; ++v)
+    {
+      design.at(genotype, w) += 0.5;
+      design.at(genotype, v) += 0.5;
+      genotype++;
+    }
+  }
+  return design;
+}
+
+inline arma::vec maternal_genotype_logprior
+ (const arma::uvec& maternal_phenotype,
+  const arma::vec& allele_frequencies_normalized,
+  const double& dropout_rate,
+  const double& mistyping_rate,
+  const bool phenotyped)
+{
+  // log P(maternal genotype) [+ log P(maternal phenotype | genotype)], in the order of maternal_genotype_design
+  const unsigned number_of_alleles = allele_frequencies_normalized.n_elem;
+  arma::vec logprior (number_of_alleles*(number_of_alleles+1)/2);
+  unsigned genotype = 0;
+  for (unsigned w=1; w<=number_of_alleles; ++w)
+  {
+    for (unsigned v=w; v<=number_of_alleles; ++v)
+    {
+      logprior[genotype] = log((2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]); //hwe prior
+      if (phenotyped)
+      {
+        logprior[genotype] += log(genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate));
+      }
+      genotype++;
+    }
+  }
+  return logprior;
+}
+
+const unsigned matrix_likelihood_block_size = 64; //offspring per gemm, so that memory is bounded in the size of the sib group
+
+inline arma::vec fullsib_loglikelihood_matrix
+ (const arma::mat& design,
+  const arma::mat& emission,
+  const arma::uvec& offspring,
+  const arma::vec& allele_frequencies_normalized)
+{
+  // log likelihood of a sib group for each maternal genotype, summed over paternal alleles;
+  // "emission" is from offspring_emission_table, "offspring" are nonmissing members of the group
+  const unsigned number_of_alleles = allele_frequencies_normalized.n_elem;
+  const unsigned number_of_genotypes = design.n_rows;
+  if (offspring.n_elem == 0) return arma::vec(number_of_genotypes, arma::fill::zeros);
+
+  // product over offspring, a block of offspring at a time
+  arma::mat log_fullsib_likelihood (number_of_genotypes, number_of_alleles, arma::fill::zeros);
+  arma::mat stacked (number_of_alleles, number_of_alleles * std::min(unsigned(offspring.n_elem), matrix_likelihood_block_size));
+  for (unsigned start=0; start<offspring.n_elem; start+=matrix_likelihood_block_size)
+  {
+    // maternal alleles by (paternal allele, offspring)
+    const unsigned block = std::min(unsigned(offspring.n_elem) - start, matrix_likelihood_block_size);
+    for (unsigned i=0; i<block; ++i)
+    {
+      stacked.cols(number_of_alleles*i, number_of_alleles*(i+1)-1) = 
+        arma::trans(emission.cols(number_of_alleles*offspring[start+i], number_of_alleles*(offspring[start+i]+1)-1));
+    }
+    const arma::mat log_mixture = arma::log(design * stacked.head_cols(number_of_alleles*block)); // Mendelian segregation probs * phenotype probabilities
+    for (unsigned i=0; i<block; ++i)
+    {
+      log_fullsib_likelihood += log_mixture.cols(number_of_alleles*i, number_of_alleles*(i+1)-1);
+    }
+  }
+
+  // sum over paternal alleles
+  arma::vec running_maximum = arma::max(log_fullsib_likelihood, 1); //underflow protection
+  running_maximum.elem(arma::find_nonfinite(running_maximum)).zeros(); //impossible maternal genotypes stay at -inf
+  log_fullsib_likelihood.each_col() -= running_maximum;
+  return arma::log(arma::exp(log_fullsib_likelihood) * allele_frequencies_normalized) + running_maximum; //hwe prior
+}
+
+inline double halfsib_loglikelihood_matrix (const arma::vec& log_halfsib_likelihood)
+{
+  // log sum over maternal genotypes
+  const double running_maximum = log_halfsib_likelihood.max(); //underflow protection
+  if (!std::isfinite(running_maximum)) return running_maximum;
+  return log(arma::accu(arma::exp(log_halfsib_likelihood - running_maximum))) + running_maximum;
+}
+
+inline double parentage_loglikelihood_by_locus_matrix
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // as parentage_loglikelihood_by_locus, with the sums over parental genotypes as matrix operations;
+  // a sib group's likelihood does not depend on the mother, so it is computed once per father
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  // tabulate sib groups
+  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    offspring_counts.at(paternity[sib],maternity[sib])++;
+  }
+
+  const arma::mat design = maternal_genotype_design(number_of_alleles);
+  const arma::mat emission = offspring_emission_table<double>(offspring_phenotypes, number_of_alleles, dropout_rate, mistyping_rate);
+  arma::mat log_fullsib_likelihood (design.n_rows, fathers.max()+1, arma::fill::zeros);
+  for (auto father : fathers)
+  {
+    std::vector<unsigned> offspring;
+    for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+    {
+      if (paternity[sib] == father && arma::prod(offspring_phenotypes.col(sib))) offspring.push_back(sib);
+    }
+    log_fullsib_likelihood.col(father) = 
+      fullsib_loglikelihood_matrix(design, emission, arma::conv_to<arma::uvec>::from(offspring), allele_frequencies_normalized);
+  }
+
+  double log_likelihood = 0;
+  for (auto mother : mothers)
+  {
+    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
+    arma::vec log_halfsib_likelihood = maternal_genotype_logprior(maternal_phenotype, allele_frequencies_normalized, 
+        dropout_rate, mistyping_rate, mother == 0 && arma::prod(maternal_phenotype)); //0'th mother is phenotyped
+    for (auto father : mated_fathers)
+    {
+      log_halfsib_likelihood += log_fullsib_likelihood.col(father);
+    }
+    log_likelihood += halfsib_loglikelihood_matrix(log_halfsib_likelihood);
+  }
+  return log_likelihood;
+}
+
+inline double paternity_loglikelihood_by_locus 
+ (const arma::uvec& paternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // likelihood of offspring paternity given offspring phenotypes, maternal phenotype, haplodiploidy
+  // modified from Eqs 3 & 4 in Wang 2004 Genetics
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  double halfsib_likelihood = 0.;
+  double halfsib_running_maximum = -arma::datum::inf;
+  for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+  { 
+    for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+    {
+      double maternal_genotype_probability = 
+        (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+      double log_halfsib_likelihood = log(maternal_genotype_probability); 
+      if (arma::prod(maternal_phenotype))
+      {
+        double maternal_phenotype_probability = 
+          genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+        log_halfsib_likelihood += log(maternal_phenotype_probability);
+      }
+      for (auto father : fathers)
+      {
+        double fullsib_likelihood = 0.;
+        double fullsib_running_maximum = -arma::datum::inf;
+        arma::uvec offspring_from_father = arma::find(paternity == father);
+        for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+        {
+          double paternal_genotype_probability = 
+            allele_frequencies_normalized[u-1]; //hwe prior
+          double log_fullsib_likelihood = log(paternal_genotype_probability);
+          for (auto offspring : offspring_from_father)
+          {
+            arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
+            if (arma::prod(offspring_phenotype)) { 
+              double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
+                0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
+                0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
+              log_fullsib_likelihood += log(offspring_phenotype_probability);
+            } 
+          }
+          if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
+          {
+            fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
+          } else {
+            fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
+            fullsib_likelihood += 1.;
+            fullsib_running_maximum = log_fullsib_likelihood;
+          }
+        }
+        log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
+      }
+      if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
+      {
+        halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
+      } else {
+        halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
+        halfsib_likelihood += 1.;
+        halfsib_running_maximum = log_halfsib_likelihood;
+      }
+    }
+  }
+  return log(halfsib_likelihood) + halfsib_running_maximum;
+}
+
+inline double paternity_loglikelihood_by_locus_matrix
+ (const arma::uvec& paternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // as paternity_loglikelihood_by_locus (a single mother), with the sums over parental genotypes as matrix operations
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  const arma::mat design = maternal_genotype_design(number_of_alleles);
+  const arma::mat emission = offspring_emission_table<double>(offspring_phenotypes, number_of_alleles, dropout_rate, mistyping_rate);
+  arma::vec log_halfsib_likelihood = maternal_genotype_logprior(maternal_phenotype, allele_frequencies_normalized, 
+      dropout_rate, mistyping_rate, arma::prod(maternal_phenotype) > 0);
+  for (auto father : fathers)
+  {
+    std::vector<unsigned> offspring;
+    for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+    {
+      if (paternity[sib] == father && arma::prod(offspring_phenotypes.col(sib))) offspring.push_back(sib);
+    }
+    log_halfsib_likelihood += 
+      fullsib_loglikelihood_matrix(design, emission, arma::conv_to<arma::uvec>::from(offspring), allele_frequencies_normalized);
+  }
+  return halfsib_loglikelihood_matrix(log_halfsib_likelihood);
+}
+
+inline double parentage_loglikelihood_by_locus_single_precision
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  // as parentage_loglikelihood_by_locus, but with offspring emission probabilities tabulated in 
+  // single precision, and the product over offspring formed in single precision across all paternal
+  // alleles at once (contiguous, so it vectorizes). Every few offspring the partial products are 
+  // folded into double-precision logs; a block whose product leaves the normal float range is 
+  // recomputed in double precision. Sums over parental genotypes are in double precision.
+  const unsigned block_size = 4; //offspring per float product; emission probabilities are rarely < 1e-9
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+  // tabulate sib groups
+  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  {
+    offspring_counts.at(paternity[sib],maternity[sib])++;
+  }
+
+  const arma::fmat emission = offspring_emission_table<float>(offspring_phenotypes, number_of_alleles, dropout_rate, mistyping_rate);
+  arma::fvec block_product (number_of_alleles);
+  arma::vec log_product (number_of_alleles);
+
+  double log_likelihood = 0;
+  for (auto mother : mothers)
+  {
+    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
+    double halfsib_likelihood = 0.;
+    double halfsib_running_maximum = -arma::datum::inf;
+    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+    { 
+      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+      {
+        double maternal_genotype_probability = 
+          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+        double log_halfsib_likelihood = log(maternal_genotype_probability); 
+        if (mother == 0 && arma::prod(maternal_phenotype)) //0'th mother is phenotyped
+        {
+          double maternal_phenotype_probability = 
+            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+          log_halfsib_likelihood += log(maternal_phenotype_probability);
+        }
+        for (auto father : mated_fathers)
+        {
+          arma::uvec offspring_from_father = arma::find(paternity == father);
+          log_product.zeros();
+          for (unsigned start=0; start<offspring_from_father.n_elem; start+=block_size)
+          {
+            const unsigned end = std::min(start + block_size, unsigned(offspring_from_father.n_elem));
+            block_product.ones();
+            for (unsigned j=start; j<end; ++j) // Mendelian segregation probs * phenotype probabilities
+            {
+              const unsigned offspring = offspring_from_father[j];
+              const float* emission_w = emission.colptr(w-1 + number_of_alleles*offspring);
+              const float* emission_v = emission.colptr(v-1 + number_of_alleles*offspring);
+              for (unsigned u=0; u<number_of_alleles; ++u) 
+              {
+                block_product[u] *= 0.5f * (emission_w[u] + emission_v[u]);
+              }
+            }
+            for (unsigned u=0; u<number_of_alleles; ++u) 
+            {
+              if (block_product[u] >= std::numeric_limits<float>::min())
+              {
+                log_product[u] += log(double(block_product[u]));
+              } else { //guardrail: underflow in single precision, redo block in double
+                for (unsigned j=start; j<end; ++j)
+                {
+                  const unsigned offspring = offspring_from_father[j];
+                  log_product[u] += log(0.5 * double(emission.at(u, w-1 + number_of_alleles*offspring)) + 
+                                        0.5 * double(emission.at(u, v-1 + number_of_alleles*offspring)));
+                }
+              }
+            }
+          }
+          double fullsib_likelihood = 0.;
+          double fullsib_running_maximum = -arma::datum::inf;
+          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
+          {
+            double paternal_genotype_probability = 
+              allele_frequencies_normalized[u-1]; //hwe prior
+            double log_fullsib_likelihood = log(paternal_genotype_probability) + log_product[u-1];
+            if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
+            {
+              fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
+            } else {
+              fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
+              fullsib_likelihood += 1.;
+              fullsib_running_maximum = log_fullsib_likelihood;
+            }
+          }
+          log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
+        }
+        if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
+        {
+          halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
+        } else {
+          halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
+          halfsib_likelihood += 1.;
+          halfsib_running_maximum = log_halfsib_likelihood;
+        }
+      }
+    }
+    log_likelihood += log(halfsib_likelihood) + halfsib_running_maximum;
+  }
+  return log_likelihood;
+}
+
+inline double parentage_loglikelihood_by_locus_pruned
+ (const arma::uvec& paternity,
+  const arma::uvec& maternity,
+  const arma::umat& offspring_phenotypes, 
+  const arma::uvec& maternal_phenotype, 
+  const arma::vec& allele_frequencies, 
+  const double& dropout_rate, 
+  const double& mistyping_rate,
+  const double& pruning_threshold,
+  double& log_error_bound)
+{
+  // as parentage_loglikelihood_by_locus, but summing only over candidate parental genotypes:
+  //  - a paternal allele u is dropped for a sib group if some offspring in it has
+  //    P(phenotype | a, u) < pruning_threshold for every maternal allele a;
+  //  - a maternal genotype (w, v) is dropped if P(maternal phenotype | w, v) < pruning_threshold,
+  //    or if some offspring has P(phenotype | w or v, u) < pruning_threshold for every candidate u.
+  // Every factor is a probability, so a dropped term is at most pruning_threshold times its prior
+  // (times the mass of dropped paternal alleles). The sum of these is an upper bound on the neglected
+  // likelihood, and log_error_bound is incremented by the implied bound on the log likelihood error
+  // (the returned value is never larger than the exact one).
+  const unsigned number_of_alleles = allele_frequencies.n_elem;
+  const arma::uvec fathers = arma::unique(paternity);
+  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
+  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
+
+  if (paternity.n_elem != maternity.n_elem) throw std::invalid_argument("maternity/paternity vectors must be the same length");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
+  if (pruning_threshold < 0. || pruning_threshold >= 1.) throw std::invalid_argument("pruning threshold must be in [0, 1)");
+
+  const arma::mat emission = offspring_emission_table<double>(offspring_phenotypes, number_of_alleles, dropout_rate, mistyping_rate);
+  std::vector<bool> nonmissing (paternity.n_elem);
+  for (unsigned sib=0; sib<paternity.n_elem; ++sib) nonmissing[sib] = arma::prod(offspring_phenotypes.col(sib)) > 0;
+
+  double log_likelihood = 0;
+  for (auto mother : mothers)
+  {
+    // candidate paternal alleles per sib group, and mass of dropped alleles
+    arma::uvec mated_fathers = arma::unique(paternity.elem(arma::find(maternity == mother)));
+    std::vector<arma::uvec> offspring_from_father;
+    std::vector<arma::uvec> candidate_paternal_alleles;
+    std::vector<double> dropped_paternal_frequency;
+    for (auto father : mated_fathers)
+    {
+      std::vector<unsigned> offspring, candidates;
+      for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+      {
+        if (paternity[sib] == father && nonmissing[sib]) offspring.push_back(sib); //as in parentage_loglikelihood_by_locus
+      }
+      double dropped = 0.;
+      for (unsigned u=0; u<number_of_alleles; ++u)
+      {
+        bool candidate = true;
+        for (auto sib : offspring)
+        {
+          double best = 0.;
+          for (unsigned a=0; a<number_of_alleles; ++a) best = std::max(best, emission.at(u, a + number_of_alleles*sib));
+          if (best < pruning_threshold) { candidate = false; break; }
+        }
+        if (candidate) candidates.push_back(u); else dropped += allele_frequencies_normalized[u];
+      }
+      if (candidates.empty()) //no paternal allele explains this sib group, threshold is far too large
+      {
+        return parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes, maternal_phenotype,
+            allele_frequencies, dropout_rate, mistyping_rate);
+      }
+      offspring_from_father.push_back(arma::conv_to<arma::uvec>::from(offspring));
+      candidate_paternal_alleles.push_back(arma::conv_to<arma::uvec>::from(candidates));
+      dropped_paternal_frequency.push_back(dropped);
+    }
+
+    // maternal alleles that, with some candidate paternal allele, explain each offspring
+    std::vector<arma::uvec> compatible_maternal_alleles; //number_of_alleles x offspring of this mother
+    for (unsigned f=0; f<offspring_from_father.size(); ++f)
+    {
+      for (auto sib : offspring_from_father[f])
+      {
+        arma::uvec compatible (number_of_alleles, arma::fill::zeros);
+        for (unsigned a=0; a<number_of_alleles; ++a)
+        {
+          for (auto u : candidate_paternal_alleles[f])
+          {
+            if (emission.at(u, a + number_of_alleles*sib) >= pruning_threshold) { compatible[a] = 1; break; }
+          }
+        }
+        compatible_maternal_alleles.push_back(compatible);
+      }
+    }
+
+    double halfsib_likelihood = 0.;
+    double halfsib_running_maximum = -arma::datum::inf;
+    double neglected_likelihood = 0.;
+    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
+    { 
+      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
+      {
+        double maternal_genotype_probability = 
+          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
+        double log_halfsib_likelihood = log(maternal_genotype_probability); 
+        if (mother == 0 && arma::prod(maternal_phenotype)) //0'th mother is phenotyped
+        {
+          double maternal_phenotype_probability = 
+            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+          if (maternal_phenotype_probability < pruning_threshold)
+          {
+            neglected_likelihood += maternal_genotype_probability * pruning_threshold;
+            continue;
+          }
+          maternal_genotype_probability *= maternal_phenotype_probability;
+          log_halfsib_likelihood += log(maternal_phenotype_probability);
+        }
+        bool compatible = true;
+        for (auto& alleles : compatible_maternal_alleles)
+        {
+          if (!alleles[w-1] && !alleles[v-1]) { compatible = false; break; }
+        }
+        if (!compatible)
+        {
+          neglected_likelihood += maternal_genotype_probability * pruning_threshold;
+          continue;
+        }
+        for (unsigned f=0; f<offspring_from_father.size(); ++f)
+        {
+          double fullsib_likelihood = 0.;
+          double fullsib_running_maximum = -arma::datum::inf;
+          for (auto u : candidate_paternal_alleles[f]) // paternal allele
+          {
+            double paternal_genotype_probability = 
+              allele_frequencies_normalized[u]; //hwe prior
+            double log_fullsib_likelihood = log(paternal_genotype_probability);
+            for (auto sib : offspring_from_father[f]) // Mendelian segregation probs * phenotype probabilities
+            {
+              log_fullsib_likelihood += log(0.5 * emission.at(u, w-1 + number_of_alleles*sib) + 
+                                            0.5 * emission.at(u, v-1 + number_of_alleles*sib));
+            }
+            if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
+            {
+              fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
+            } else {
+              fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
+              fullsib_likelihood += 1.;
+              fullsib_running_maximum = log_fullsib_likelihood;
+            }
+          }
+          log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
+          neglected_likelihood += maternal_genotype_probability * pruning_threshold * dropped_paternal_frequency[f];
+        }
+        if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
+        {
+          halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
+        } else {
+          halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
+          halfsib_likelihood += 1.;
+          halfsib_running_maximum = log_halfsib_likelihood;
+        }
+      }
+    }
+    if (halfsib_likelihood == 0.) //everything pruned, threshold is far too large
+    {
+      return parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes, maternal_phenotype,
+          allele_frequencies, dropout_rate, mistyping_rate);
+    }
+    const double log_kept_likelihood = log(halfsib_likelihood) + halfsib_running_maximum;
+    log_likelihood += log_kept_likelihood;
+    if (neglected_likelihood > 0.)
+    {
+      log_error_bound += std::log1p(std::exp(log(neglected_likelihood) - log_kept_likelihood));
+    }
+  }
+  return log_likelihood;
+}
+
+inline double parentage_loglikelihood 
+ (arma::uvec paternity, 
+  arma::uvec maternity,
+  arma::ucube offspring_phenotypes, 
+  arma::umat maternal_phenotype,
+  std::vector<arma::vec> allele_frequencies,
+  arma::vec dropout_rate,
+  arma::vec mistyping_rate,
+  const bool linear_space = false,
+  const bool single_precision = false,
+  const double pruning_threshold = 0.,
+  double* log_error_bound = nullptr)
+{
+  // if pruning_threshold > 0, genotypes are pruned (see parentage_loglikelihood_by_locus_pruned)
+  // and a bound on the resulting error is added to log_error_bound
+
+  // check number of loci match
+  const unsigned number_of_loci = allele_frequencies.size();
+  if (maternal_phenotype.n_cols != number_of_loci) throw std::invalid_argument("must have maternal phenotypes for each locus");
+  if (offspring_phenotypes.n_slices != number_of_loci) throw std::invalid_argument("must have offspring phenotypes for each locus");
+  if (dropout_rate.n_elem != number_of_loci) throw std::invalid_argument("must have dropout rates for each locus");
+  if (mistyping_rate.n_elem != number_of_loci) throw std::invalid_argument("must have mistyping rates for each locus");
+
+  double log_likelihood = 0.;
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    if (pruning_threshold > 0.)
+    {
+      double locus_error_bound = 0.;
+      log_likelihood += 
+        parentage_loglikelihood_by_locus_pruned(paternity, maternity, offspring_phenotypes.slice(locus), 
+            maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus],
+            pruning_threshold, locus_error_bound);
+      if (log_error_bound) *log_error_bound += locus_error_bound;
+      continue;
+    }
+    log_likelihood += single_precision ?
+      parentage_loglikelihood_by_locus_single_precision(paternity, maternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]) :
+      linear_space ?
+      parentage_loglikelihood_by_locus_scaled(paternity, maternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]) :
+      allele_frequencies[locus].n_elem >= matrix_likelihood_min_alleles ?
+      parentage_loglikelihood_by_locus_matrix(paternity, maternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]) :
+      parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
+  }
+  return log_likelihood;
+}
+
+struct parentage_posterior_samples
+{
+  arma::imat paternity;
+  arma::imat maternity;
+  arma::mat dropout_rate;
+  arma::mat mistyping_rate;
+  arma::mat dropout_errors;
+  arma::mat mistyping_errors;
+  arma::ucube imputed_genotypes;
+  arma::vec deviance;
+  unsigned mother;
+  double pruning_error_bound; //see parentage_chain
+  bool compressed; //if so, paternity/maternity are empty and traces are filled
+  parentage_trace paternity_trace;
+  parentage_trace maternity_trace;
+};
+
+struct parentage_chain
+{
+  // settings and full state of a chain from sample_parentage_and_error_rates,
+  // sufficient to continue the chain from a checkpoint
+
+  // settings
+  arma::ucube phenotypes;
+  unsigned mother;
+  unsigned burn_in;
+  unsigned thinning_interval;
+  unsigned number_of_mcmc_samples;
+  bool global_genotyping_error_rates;
+  bool update_error_rates;
+  bool update_allele_frequencies;
+  double concentration;
+  double lambda_mother;
+  double lambda_father;
+  bool compress_traces;
+  bool linear_space_likelihood;
+  bool single_precision_likelihood;
+  double genotype_pruning_threshold;
+
+  // state
+  int iteration; //next iteration, negative during burn-in
+  arma::uvec paternity;
+  arma::uvec maternity;
+  arma::vec dropout_rate;
+  arma::vec mistyping_rate;
+  std::vector<arma::vec> allele_frequencies;
+  double deviance;
+  double pruning_error_bound; //largest bound on log likelihood error from pruning, over evaluations
+  std::string rng_state; //only current when written to a checkpoint
+
+  // storage
+  arma::imat paternity_samples; //empty if traces are compressed
+  arma::imat maternity_samples;
+  parentage_trace paternity_trace;
+  parentage_trace maternity_trace;
+  arma::mat dropout_rate_samples;
+  arma::mat mistyping_rate_samples;
+  arma::vec deviance_samples;
+  arma::mat dropout_errors;
+  arma::mat mistyping_errors;
+  std::vector<arma::mat> first_allele_counts; //alleles x individuals, for MAP genotypes
+  std::vector<arma::mat> second_allele_counts;
+
+  void write (std::ostream& stream) const
+  {
+    write_checkpoint_value(stream, std::string("sydneyPaternity::parentage_chain 7"));
+    write_checkpoint_value(stream, phenotypes);
+    write_checkpoint_value(stream, mother);
+    write_checkpoint_value(stream, burn_in);
+    write_checkpoint_value(stream, thinning_interval);
+    write_checkpoint_value(stream, number_of_mcmc_samples);
+    write_checkpoint_value(stream, global_genotyping_error_rates);
+    write_checkpoint_value(stream, update_error_rates);
+    write_checkpoint_value(stream, update_allele_frequencies);
+    write_checkpoint_value(stream, concentration);
+    write_checkpoint_value(stream, lambda_mother);
+    write_checkpoint_value(stream, lambda_father);
+    write_checkpoint_value(stream, compress_traces);
+    write_checkpoint_value(stream, linear_space_likelihood);
+    write_checkpoint_value(stream, single_precision_likelihood);
+    write_checkpoint_value(stream, genotype_pruning_threshold);
+    write_checkpoint_value(stream, iteration);
+    write_checkpoint_value(stream, paternity);
+    write_checkpoint_value(stream, maternity);
+    write_checkpoint_value(stream, dropout_rate);
+    write_checkpoint_value(stream, mistyping_rate);
+    write_checkpoint_value(stream, allele_frequencies);
+    write_checkpoint_value(stream, deviance);
+    write_checkpoint_value(stream, pruning_error_bound);
+    write_checkpoint_value(stream, rng_state);
+    write_checkpoint_value(stream, paternity_samples);
+    write_checkpoint_value(stream, maternity_samples);
+    paternity_trace.write(stream);
+    maternity_trace.write(stream);
+    write_checkpoint_value(stream, dropout_rate_samples);
+    write_checkpoint_value(stream, mistyping_rate_samples);
+    write_checkpoint_value(stream, deviance_samples);
+    write_checkpoint_value(stream, dropout_errors);
+    write_checkpoint_value(stream, mistyping_errors);
+    write_checkpoint_value(stream, first_allele_counts);
+    write_checkpoint_value(stream, second_allele_counts);
+  }
+
+  void read (std::istream& stream)
+  {
+    std::string version;
+    read_checkpoint_value(stream, version);
+    if (version != "sydneyPaternity::parentage_chain 7") throw std::runtime_error("not a parentage sampler checkpoint");
+    read_checkpoint_value(stream, phenotypes);
+    read_checkpoint_value(stream, mother);
+    read_checkpoint_value(stream, burn_in);
+    read_checkpoint_value(stream, thinning_interval);
+    read_checkpoint_value(stream, number_of_mcmc_samples);
+    read_checkpoint_value(stream, global_genotyping_error_rates);
+    read_checkpoint_value(stream, update_error_rates);
+    read_checkpoint_value(stream, update_allele_frequencies);
+    read_checkpoint_value(stream, concentration);
+    read_checkpoint_value(stream, lambda_mother);
+    read_checkpoint_value(stream, lambda_father);
+    read_checkpoint_value(stream, compress_traces);
+    read_checkpoint_value(stream, linear_space_likelihood);
+    read_checkpoint_value(stream, single_precision_likelihood);
+    read_checkpoint_value(stream, genotype_pruning_threshold);
+    read_checkpoint_value(stream, iteration);
+    read_checkpoint_value(stream, paternity);
+    read_checkpoint_value(stream, maternity);
+    read_checkpoint_value(stream, dropout_rate);
+    read_checkpoint_value(stream, mistyping_rate);
+    read_checkpoint_value(stream, allele_frequencies);
+    read_checkpoint_value(stream, deviance);
+    read_checkpoint_value(stream, pruning_error_bound);
+    read_checkpoint_value(stream, rng_state);
+    read_checkpoint_value(stream, paternity_samples);
+    read_checkpoint_value(stream, maternity_samples);
+    paternity_trace.read(stream);
+    maternity_trace.read(stream);
+    read_checkpoint_value(stream, dropout_rate_samples);
+    read_checkpoint_value(stream, mistyping_rate_samples);
+    read_checkpoint_value(stream, deviance_samples);
+    read_checkpoint_value(stream, dropout_errors);
+    read_checkpoint_value(stream, mistyping_errors);
+    read_checkpoint_value(stream, first_allele_counts);
+    read_checkpoint_value(stream, second_allele_counts);
+  }
+};
+
+inline parentage_chain initialize_parentage_chain
+ (arma::ucube phenotypes, 
+  arma::uvec maternity,
+  const unsigned mother,
+  const unsigned burn_in,
+  const unsigned thinning_interval,
+  const unsigned number_of_mcmc_samples,
+  const bool global_genotyping_error_rates,
+  const bool update_error_rates,
+  const bool update_allele_frequencies,
+  const double concentration,
+  const double lambda_mother,
+  const double lambda_father,
+  const double starting_dropout_rate,
+  const double starting_mistyping_rate,
+  const bool compress_traces = false,
+  const bool linear_space_likelihood = false,
+  const bool single_precision_likelihood = false,
+  const double genotype_pruning_threshold = 0.)
+{
+  if (linear_space_likelihood && single_precision_likelihood) throw std::invalid_argument("choose one of linear space, single precision likelihoods");
+  if (genotype_pruning_threshold > 0. && (linear_space_likelihood || single_precision_likelihood))
+  {
+    throw std::invalid_argument("genotype pruning is only available for the default likelihood");
+  }
+  if (genotype_pruning_threshold < 0. || genotype_pruning_threshold >= 1.) throw std::invalid_argument("pruning threshold must be in [0, 1)");
+  if (mother > phenotypes.n_cols || mother < 1) throw std::invalid_argument("1-based index of mother out of range");
+  if (maternity.n_elem != phenotypes.n_cols) throw std::invalid_argument("maternity vector wrong dimension");
+
+  const unsigned max_iter = number_of_mcmc_samples;
+  const unsigned num_loci = phenotypes.n_slices;
+  const unsigned num_offspring = phenotypes.n_cols - 1;
+
+  parentage_chain chain;
+  chain.phenotypes = phenotypes;
+  chain.mother = mother;
+  chain.burn_in = burn_in;
+  chain.thinning_interval = thinning_interval;
+  chain.number_of_mcmc_samples = number_of_mcmc_samples;
+  chain.global_genotyping_error_rates = global_genotyping_error_rates;
+  chain.update_error_rates = update_error_rates;
+  chain.update_allele_frequencies = update_allele_frequencies;
+  chain.concentration = concentration;
+  chain.lambda_mother = lambda_mother;
+  chain.lambda_father = lambda_father;
+  chain.compress_traces = compress_traces;
+  chain.linear_space_likelihood = linear_space_likelihood;
+  chain.single_precision_likelihood = single_precision_likelihood;
+  chain.genotype_pruning_threshold = genotype_pruning_threshold;
+
+  chain.allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, false);
+
+  // initialize (could draw from prior instead)
+  //arma::uvec paternity = arma::zeros<arma::uvec>(num_offspring);//this could be randomized
+  //arma::uvec maternity = arma::zeros<arma::uvec>(num_offspring);//this could be randomized, but must include 0
+  maternity.shed_row(mother-1);
+  arma::uvec paternity = maternity;
+  chain.maternity = recode_to_contiguous_integers(maternity); //check that 0 is in maternity vector?
+  chain.paternity = recode_to_contiguous_integers(paternity);
+  chain.dropout_rate = arma::vec(num_loci); chain.dropout_rate.fill(starting_dropout_rate);
+  chain.mistyping_rate = arma::vec(num_loci); chain.mistyping_rate.fill(starting_mistyping_rate);
+  chain.deviance = 0.;
+  chain.pruning_error_bound = 0.;
+  chain.iteration = -int(burn_in);
+
+  // storage
+  if (compress_traces)
+  {
+    chain.paternity_trace = parentage_trace(num_offspring);
+    chain.maternity_trace = parentage_trace(num_offspring, 100, 1); //label 0 is the phenotyped mother
+  } else {
+    chain.paternity_samples = arma::imat(num_offspring, max_iter);
+    chain.maternity_samples = arma::imat(num_offspring, max_iter);
+  }
+  chain.dropout_rate_samples = arma::mat(num_loci, max_iter);
+  chain.mistyping_rate_samples = arma::mat(num_loci, max_iter);
+  chain.deviance_samples = arma::vec(max_iter);
+  chain.dropout_errors = arma::mat(num_offspring+1, num_loci, arma::fill::zeros);
+  chain.mistyping_errors = arma::mat(num_offspring+1, num_loci, arma::fill::zeros);
+  for(unsigned locus=0; locus<num_loci; ++locus) 
+  {
+    chain.first_allele_counts.emplace_back(arma::mat(chain.allele_frequencies[locus].n_elem,num_offspring+1,arma::fill::zeros));
+    chain.second_allele_counts.emplace_back(arma::mat(chain.allele_frequencies[locus].n_elem,num_offspring+1,arma::fill::zeros));
+  }
+  return chain;
+}
+
+inline parentage_posterior_samples summarize_parentage_chain
+ (const parentage_chain& chain)
+{
+  const unsigned mother = chain.mother;
+  const unsigned max_iter = chain.number_of_mcmc_samples;
+  const unsigned num_loci = chain.phenotypes.n_slices;
+  const unsigned num_offspring = chain.phenotypes.n_cols - 1;
+  const arma::ucube& phenotypes = chain.phenotypes;
+  const std::vector<arma::mat>& first_allele_counts = chain.first_allele_counts;
+  const std::vector<arma::mat>& second_allele_counts = chain.second_allele_counts;
+  std::vector<arma::uvec> allele_lengths = unique_alleles(phenotypes, false);
+  arma::imat paternity_samples = chain.paternity_samples;
+  arma::imat maternity_samples = chain.maternity_samples;
+  arma::mat dropout_errors = chain.dropout_errors;
+  arma::mat mistyping_errors = chain.mistyping_errors;
+
+  // MAP estimates for genotypes, reorder to mirror input
+  arma::ucube imputed_genotypes (arma::size(phenotypes));
+  for (unsigned locus=0; locus<num_loci; ++locus)
+  {
+    arma::umat genotypes (2, num_offspring+1);
+    for (unsigned i=0; i<num_offspring+1; ++i)
+    {
+      // marginals of the (ordered) genotype posterior; the MAP only ever used these, so
+      // a dense alleles x alleles tally per individual is unnecessary
+      genotypes.at(0, i) = allele_lengths[locus].at(arma::index_max(second_allele_counts[locus].col(i)));
+      genotypes.at(1, i) = allele_lengths[locus].at(arma::index_max(first_allele_counts[locus].col(i)));
+    }
+    arma::uvec maternal_genotype = genotypes.col(0);
+    genotypes.shed_col(0); genotypes.insert_cols(mother-1, maternal_genotype);
+    imputed_genotypes.slice(locus) = genotypes;
+  }
+
+  // posterior expectation of error counts & reorder matrices to mirror input (0'th index is mother, offspring are 1-based indices)
+  dropout_errors /= double(max_iter);
+  arma::rowvec maternal_dropout_errors = dropout_errors.row(0); 
+  dropout_errors.shed_row(0); dropout_errors.insert_rows(mother-1, maternal_dropout_errors);
+
+  mistyping_errors /= double(max_iter);
+  arma::rowvec maternal_mistyping_errors = mistyping_errors.row(0); 
+  mistyping_errors.shed_row(0); mistyping_errors.insert_rows(mother-1, maternal_mistyping_errors);
+
+  parentage_posterior_samples samples;
+  samples.mother = mother;
+  samples.compressed = chain.compress_traces;
+  if (chain.compress_traces)
+  {
+    samples.paternity_trace = chain.paternity_trace;
+    samples.maternity_trace = chain.maternity_trace;
+  } else {
+    arma::irowvec maternal_parentage (max_iter); maternal_parentage.fill(arma::datum::nan);
+    maternity_samples.insert_rows(mother-1, maternal_parentage);
+    paternity_samples.insert_rows(mother-1, maternal_parentage);
+  }
+  samples.paternity = paternity_samples;
+  samples.maternity = maternity_samples;
+  samples.dropout_rate = chain.dropout_rate_samples;
+  samples.mistyping_rate = chain.mistyping_rate_samples;
+  samples.dropout_errors = dropout_errors;
+  samples.mistyping_errors = mistyping_errors;
+  samples.imputed_genotypes = imputed_genotypes;
+  samples.deviance = chain.deviance_samples;
+  samples.pruning_error_bound = chain.pruning_error_bound;
+  return samples;
+}
+
+
+template <class RNG>
+parentage_posterior_samples sample_parentage_and_error_rates
+ (parentage_chain& chain,
+  RNG& rng,
+  sampler_instrumentation& instrumentation,
+  std::ostream& output,
+  const std::string& checkpoint_file = "",
+  const unsigned checkpoint_interval = 0,
+  const unsigned number_of_threads = 1)
+{
+  // samples from posterior distribution of full sib groups with Dirichlet process prior,
+  // using algorithm 8 from Neal 2000 JCGS; continues from the current state of the chain,
+  // writing it to checkpoint_file every checkpoint_interval iterations. Data augmentation
+  // is done over loci with "number_of_threads"; the chain does not depend on the number of threads
+  if (number_of_threads < 1) throw std::invalid_argument("need at least one thread");
+
+  // wait a damn minute. b/c we have observed the maternal phenotypes they should ALWAYS go in the likelihood, even when there are no offspring for that mother
+  
+  const unsigned mother = chain.mother;
+  const unsigned burn_in = chain.burn_in;
+  const unsigned thinning_interval = chain.thinning_interval;
+  const bool global_genotyping_error_rates = chain.global_genotyping_error_rates;
+  const bool update_error_rates = chain.update_error_rates;
+  const bool update_allele_frequencies = chain.update_allele_frequencies;
+  const double lambda_mother = chain.lambda_mother;
+  const double lambda_father = chain.lambda_father;
+  const bool linear_space = chain.linear_space_likelihood;
+  const bool single_precision = chain.single_precision_likelihood;
+  const double pruning_threshold = chain.genotype_pruning_threshold;
+
+  const unsigned max_iter = chain.number_of_mcmc_samples;
+  const unsigned num_loci = chain.phenotypes.n_slices;
+  const unsigned num_offspring = chain.phenotypes.n_cols - 1;
+
+  // priors (hardcoded for now)
+  const double alpha = std::fabs(chain.concentration); //dirichlet process concentration parameter
+  const double delta = 1.; //allele frequency concentration parameter
+  const arma::vec dropout_rate_prior = {{1.,1.}}; //beta(number of dropout homozygotes, number of heterozygotes)
+  const arma::vec mistyping_rate_prior = {{1.,1.}}; //beta(number of mistypes, number of correct calls)
+  arma::ucube phenotypes = chain.phenotypes;
+  collapse_alleles_and_generate_genotype_prior(phenotypes, false); //recodes alleles; frequencies are part of chain state
+
+  // split maternal, offspring phenotypes
+  arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
+  arma::ucube offspring_phenotypes = phenotypes; offspring_phenotypes.shed_col(mother-1);
+
+  // state
+  arma::uvec& paternity = chain.paternity;
+  arma::uvec& maternity = chain.maternity;
+  arma::vec& dropout_rate = chain.dropout_rate;
+  arma::vec& mistyping_rate = chain.mistyping_rate;
+  std::vector<arma::vec>& allele_frequencies = chain.allele_frequencies;
+  double& deviance = chain.deviance;
+
+  // storage
+  arma::imat& paternity_samples = chain.paternity_samples;
+  arma::imat& maternity_samples = chain.maternity_samples;
+  arma::mat& dropout_rate_samples = chain.dropout_rate_samples;
+  arma::mat& mistyping_rate_samples = chain.mistyping_rate_samples;
+  arma::vec& deviance_samples = chain.deviance_samples;
+  arma::mat& dropout_errors = chain.dropout_errors;
+  arma::mat& mistyping_errors = chain.mistyping_errors;
+  std::vector<arma::mat>& first_allele_counts = chain.first_allele_counts;
+  std::vector<arma::mat>& second_allele_counts = chain.second_allele_counts;
+
+  for (int iter=chain.iteration; iter<int(max_iter); ++iter)
+  {
+    for (unsigned thin=0; thin<thinning_interval; ++thin)
+    {
+      // update paternity vector
+      for (unsigned sib=0; sib<num_offspring; ++sib)
+      {
+        phase_timer timer (instrumentation, PARENTAGE_UPDATE);
+
+        // tally size of sib groups
+        unsigned current_number_of_fathers = paternity.max() + 1;
+        unsigned current_number_of_mothers = maternity.max() + 1;
+        arma::umat offspring_per_mating (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
+        for (unsigned i=0; i<paternity.n_elem; ++i) offspring_per_mating.at(paternity[i],maternity[i])++;
+        offspring_per_mating.at(paternity[sib],maternity[sib])--; //remove sib from group
+        arma::uvec offspring_per_father = arma::sum(offspring_per_mating, 1);
+        arma::urowvec offspring_per_mother = arma::sum(offspring_per_mating, 0);
+
+        // find permissible matings under constraint of single mating/father
+        arma::umat permissible_matings (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
+        unsigned new_fathers = 0;
+        for (unsigned father=0; father<permissible_matings.n_rows; ++father)
+        {
+          for (unsigned mother=0; mother<permissible_matings.n_cols; ++mother)
+          {
+            const bool existing_father = offspring_per_father.at(father) > 0;
+            const bool existing_mother = offspring_per_mother.at(mother) > 0;
+            const bool existing_mating = offspring_per_mating.at(father,mother) > 0;
+            permissible_matings.at(father,mother) = unsigned(
+                ( existing_mating                    ) || 
+                ( existing_mother && !existing_father) || 
+                (!existing_mother && !existing_father) );
+            if (permissible_matings.at(father,mother) && !existing_father) new_fathers++;
+          }
+        }
+
+        // calculate parentage likelihoods across permissible matings
+        arma::mat log_likelihood (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
+        arma::mat log_prior (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
+        for (unsigned father=0; father<log_likelihood.n_rows; ++father)
+        {
+          for (unsigned mother=0; mother<log_likelihood.n_cols; ++mother)
+          {
+            if (permissible_matings.at(father,mother))
+            {
+              instrumentation.increment(CANDIDATE_LABELS);
+              instrumentation.increment(LIKELIHOOD_EVALUATIONS, num_loci);
+              paternity[sib] = father;
+              maternity[sib] = mother;
+              double log_error_bound = 0.;
+              log_likelihood.at(father,mother) = 
+                parentage_loglikelihood(paternity, maternity, offspring_phenotypes, maternal_phenotype, 
+                    allele_frequencies, dropout_rate, mistyping_rate, linear_space, single_precision, 
+                    pruning_threshold, &log_error_bound);
+              chain.pruning_error_bound = std::max(chain.pruning_error_bound, log_error_bound);
+
+              // "restraunt process" prior on number of matings
+              // TODO would be useful to have a way to sample from the prior
+              if (alpha > 0.)
+              {
+                log_prior.at(father,mother) += offspring_per_mating.at(father,mother) > 0 ?
+                  log(double(offspring_per_mating.at(father,mother))) - log(double(num_offspring)-1.+alpha): 
+                  log(alpha) - log(double(new_fathers)) - log(double(num_offspring)-1.+alpha);
+              }
+              if (lambda_mother > 0.)
+              {
+                unsigned num_mother = arma::accu(offspring_per_mother > 0)+1; //+1 because its nonzero
+                log_prior.at(father,mother) += offspring_per_mother.at(mother) > 0 ?
+                  (num_mother)*log(lambda_mother)-lambda_mother-std::lgamma(num_mother+1) :
+                  (num_mother+1)*log(lambda_mother)-lambda_mother-std::lgamma(num_mother+2) ;
+              }
+              if (lambda_father > 0.)
+              {
+                unsigned num_father = arma::accu(offspring_per_father > 0)+1; //+1 because its nonzero
+                log_prior.at(father,mother) += offspring_per_father.at(father) > 0 ?
+                  (num_father)*log(lambda_father)-lambda_father-std::lgamma(num_father+1) :
+                  (num_father+1)*log(lambda_father)-lambda_father-std::lgamma(num_father+2) ;
+              }
+            } else { log_likelihood.at(father,mother) = -arma::datum::inf; }
+          } 
+        }
+
+        // sample new father
+        arma::mat log_conditional = log_prior + log_likelihood;
+        arma::uvec new_parentage = sample_matrix(arma::exp(log_conditional - log_conditional.max()), rng);
+        paternity[sib] = new_parentage.at(0); maternity[sib] = new_parentage.at(1);
+        deviance = -2 * log_likelihood.at(paternity[sib],maternity[sib]);
+
+        // this song and dance forces the 0-index to correspond to the known mother
+        paternity = recode_to_contiguous_integers(paternity); 
+        arma::uvec maternity_aux = recode_to_contiguous_integers(arma::join_vert(maternity, arma::uvec({0})));
+        maternity = maternity_aux.head(num_offspring);
+        //why recode? indices will increase, if pre-existing singleton is moved to a father with a higher index
+      }
+
+      // update error rates and allele frequencies via data augmentation; loci are conditionally independent
+      // given parentage, so are augmented in parallel, each from a stream seeded from "rng" once per sweep, 
+      // then counts are reduced in locus order
+      std::vector<std::tuple<arma::umat, arma::uvec, arma::uvec, arma::uvec, arma::uvec, arma::uvec>> augmented (num_loci);
+      {
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+        const uint64_t seed = random_seed(rng);
+        run_parallel_tasks(num_loci, number_of_threads, [&] (const unsigned locus)
+        {
+          stream_random_number_generator locus_rng (seed, locus);
+          augmented[locus] = sample_genotypes_given_parentage(paternity, maternity, offspring_phenotypes.slice(locus), 
+              maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus], locus_rng);
+        });
+      }
+      unsigned global_dropouts = 0, global_heterozygous = 0, global_mistypes = 0, global_nonmissing = 0;
+      for (unsigned locus=0; locus<num_loci; ++locus)
+      {
+        arma::umat genotypes;
+        arma::uvec allele_counts, dropouts, heterozygous, mistypes, nonmissing;
+        {
+          phase_timer timer (instrumentation, DATA_AUGMENTATION);
+          std::tie(genotypes, allele_counts, dropouts, heterozygous, mistypes, nonmissing) = std::move(augmented[locus]);
+
+          // track expected errors, genotypes
+          if (iter >= 0 && thin == 0)
+          {
+            for (unsigned i=0; i<num_offspring+1; ++i)
+            {
+              dropout_errors.at(i,locus) += double(dropouts.at(i));
+              mistyping_errors.at(i,locus) += double(mistypes.at(i));
+              first_allele_counts[locus].at(genotypes.at(0,i)-1, i) += 1.0;//genotypes are 1-indexed so convert
+              second_allele_counts[locus].at(genotypes.at(1,i)-1, i) += 1.0;
+            }
+          }
+
+          // update error rates
+          if (update_error_rates)
+          {
+            global_dropouts += arma::accu(dropouts); global_mistypes += arma::accu(mistypes);
+            global_heterozygous += arma::accu(heterozygous); global_nonmissing += arma::accu(nonmissing);
+            dropout_rate[locus] = 0.5 * rng.beta(1. + arma::accu(dropouts), 1. + arma::accu(heterozygous) - arma::accu(dropouts));
+            mistyping_rate[locus] = rng.beta(1. + arma::accu(mistypes), 1. + arma::accu(nonmissing) - arma::accu(mistypes));
+          }
+        }
+
+        // update allele frequencies
+        if (update_allele_frequencies)
+        {
+          phase_timer timer (instrumentation, ALLELE_FREQUENCY_UPDATE);
+          for (unsigned allele=0; allele<allele_frequencies[locus].n_elem; ++allele)
+          {
+            allele_frequencies[locus][allele] = rng.gamma(1. + allele_counts[allele]);
+          }
+          allele_frequencies[locus] /= arma::accu(allele_frequencies[locus]);
+        }
+      }
+      if (update_error_rates && global_genotyping_error_rates)
+      {
+        // overwrite per-locus rates with global rate
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+        dropout_rate.fill(0.5 * rng.beta(1. + global_dropouts, 1. + global_heterozygous - global_dropouts));
+        mistyping_rate.fill(rng.beta(1. + global_mistypes, 1. + global_nonmissing - global_mistypes));
+      }
+
+      // store state
+      if (iter >= 0 && thin == 0)
+      {
+        phase_timer timer (instrumentation, STORAGE);
+        if (chain.compress_traces)
+        {
+          chain.paternity_trace.push(paternity);
+          chain.maternity_trace.push(maternity);
+        } else {
+          paternity_samples.col(iter) = arma::conv_to<arma::ivec>::from(paternity);
+          maternity_samples.col(iter) = arma::conv_to<arma::ivec>::from(maternity);
+        }
+        dropout_rate_samples.col(iter) = dropout_rate;
+        mistyping_rate_samples.col(iter) = mistyping_rate;
+        deviance_samples.at(iter) = deviance;
+      }
+
+      if (thin == 0 && iter >= 0 && iter % 100 == 0) output << "sampling [" << iter << "] " << "deviance: " << deviance << std::endl;
+    }
+
+    // checkpoint at end of iteration
+    chain.iteration = iter + 1;
+    if (checkpoint_interval > 0 && !checkpoint_file.empty() && (iter + int(burn_in) + 1) % int(checkpoint_interval) == 0)
+    {
+      phase_timer timer (instrumentation, STORAGE);
+      chain.rng_state = rng.state();
+      save_checkpoint(chain, checkpoint_file);
+    }
+  }
+
+  return summarize_parentage_chain(chain);
+}
+
+template <class RNG>
+parentage_posterior_samples sample_parentage_and_error_rates
+ (arma::ucube phenotypes, 
+  arma::uvec maternity,
+  const unsigned mother,
+  const unsigned burn_in,
+  const unsigned thinning_interval,
+  const unsigned number_of_mcmc_samples,
+  const bool global_genotyping_error_rates,
+  const bool update_error_rates,
+  const bool update_allele_frequencies,
+  const double concentration,
+  const double lambda_mother,
+  const double lambda_father,
+  const double starting_dropout_rate,
+  const double starting_mistyping_rate,
+  RNG& rng,
+  sampler_instrumentation& instrumentation,
+  std::ostream& output,
+  const std::string& checkpoint_file = "",
+  const unsigned checkpoint_interval = 0,
+  const bool compress_traces = false,
+  const bool linear_space_likelihood = false,
+  const bool single_precision_likelihood = false,
+  const double genotype_pruning_threshold = 0.,
+  const unsigned number_of_threads = 1)
+{
+  parentage_chain chain = initialize_parentage_chain(phenotypes, maternity, mother, burn_in, thinning_interval,
+      number_of_mcmc_samples, global_genotyping_error_rates, update_error_rates, update_allele_frequencies, 
+      concentration, lambda_mother, lambda_father, starting_dropout_rate, starting_mistyping_rate, compress_traces,
+      linear_space_likelihood, single_precision_likelihood, genotype_pruning_threshold);
+  return sample_parentage_and_error_rates(chain, rng, instrumentation, output, checkpoint_file, checkpoint_interval, number_of_threads);
+}
+
+template <class RNG>
+parentage_posterior_samples resume_parentage_and_error_rates
+ (const std::string& checkpoint_file,
+  RNG& rng,
+  sampler_instrumentation& instrumentation,
+  std::ostream& output,
+  const unsigned checkpoint_interval = 0,
+  const unsigned number_of_threads = 1)
+{
+  // continues a chain from a checkpoint, including the state of the random number 
+  // generator, so that the result matches an uninterrupted run (with any number of threads)
+  parentage_chain chain = load_checkpoint<parentage_chain>(checkpoint_file);
+  rng.set_state(chain.rng_state);
+  return sample_parentage_and_error_rates(chain, rng, instrumentation, output, checkpoint_file, checkpoint_interval, number_of_threads);
+}
+
+} // namespace sydneyPaternity
+
+#endif
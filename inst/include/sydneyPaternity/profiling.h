@@ -0,0 +1,209 @@
+#ifndef _SYDNEYPATERNITY_CORE_PROFILING_H
+#define _SYDNEYPATERNITY_CORE_PROFILING_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <array>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#include <cstdint>
+#endif
+
+// Opt-in instrumentation of samplers: wall time per phase and event counters.
+// When disabled, timers and counters do nothing (beyond a branch), so that
+// instrumented code paths can stay in place. Optionally, hardware performance
+// counters (Linux perf_event_open) are accumulated per phase as well.
+
+namespace sydneyPaternity {
+
+enum sampler_phase
+{
+  PARENTAGE_UPDATE,
+  DATA_AUGMENTATION,
+  ALLELE_FREQUENCY_UPDATE,
+  STORAGE,
+  NUMBER_OF_PHASES
+};
+
+enum sampler_counter
+{
+  LIKELIHOOD_EVALUATIONS, //calls to per-locus likelihood kernels
+  CANDIDATE_LABELS, //parent labels scored during parentage updates
+  CACHE_HITS,
+  NUMBER_OF_COUNTERS
+};
+
+enum hardware_event
+{
+  CPU_CYCLES,
+  INSTRUCTIONS,
+  L1D_READ_MISSES,
+  LLC_READ_MISSES,
+  BRANCH_MISSES,
+  NUMBER_OF_HARDWARE_EVENTS
+};
+
+typedef std::array<double, NUMBER_OF_HARDWARE_EVENTS> hardware_event_counts;
+
+class hardware_counters
+{
+  // per-event counters for the calling thread and any threads it creates while
+  // the counters are open (user space only), so that parallel regions count
+  // if the OpenMP team is spawned after profiling starts; worker threads that
+  // already exist (e.g. a thread pool kept from an earlier parallel region in
+  // the same process) are not counted. Events the kernel or CPU does not
+  // support (e.g. in VMs, or with a restrictive perf_event_paranoid) are left
+  // closed and reported as NA
+  std::array<int, NUMBER_OF_HARDWARE_EVENTS> descriptors;
+
+#ifdef __linux__
+  static int open_event (const uint32_t type, const uint64_t config)
+  {
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1; //reads include counts from threads spawned after opening
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  static uint64_t cache_miss (const uint64_t cache)
+  {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  }
+#endif
+
+  public:
+  hardware_counters (const bool enabled)
+  {
+    descriptors.fill(-1);
+#ifdef __linux__
+    if (!enabled) return;
+    descriptors[CPU_CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    descriptors[INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    descriptors[L1D_READ_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D));
+    descriptors[LLC_READ_MISSES] = open_event(PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL));
+    descriptors[BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    for (auto fd : descriptors)
+    {
+      if (fd >= 0)
+      {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  ~hardware_counters (void)
+  {
+#ifdef __linux__
+    for (auto fd : descriptors) if (fd >= 0) close(fd);
+#endif
+  }
+
+  hardware_counters (const hardware_counters&) = delete;
+  hardware_counters& operator= (const hardware_counters&) = delete;
+
+  bool available (const hardware_event event) const
+  {
+    return descriptors[event] >= 0;
+  }
+
+  bool any_available (void) const
+  {
+    for (auto fd : descriptors) if (fd >= 0) return true;
+    return false;
+  }
+
+  hardware_event_counts read (void) const
+  {
+    // counts since opening, scaled up if the kernel multiplexed the counter
+    hardware_event_counts counts; counts.fill(0.);
+#ifdef __linux__
+    for (unsigned event=0; event<NUMBER_OF_HARDWARE_EVENTS; ++event)
+    {
+      uint64_t buffer[3]; //value, time enabled, time running
+      if (descriptors[event] >= 0 && ::read(descriptors[event], buffer, sizeof(buffer)) == sizeof(buffer))
+      {
+        counts[event] = buffer[2] > 0 ? 
+          double(buffer[0]) * double(buffer[1]) / double(buffer[2]) : 0.;
+      }
+    }
+#endif
+    return counts;
+  }
+};
+
+class sampler_instrumentation
+{
+  public:
+  const bool enabled;
+  const bool profile_hardware;
+  std::vector<double> seconds;
+  std::vector<double> counts;
+  std::vector<hardware_event_counts> events;
+  hardware_counters hardware;
+
+  sampler_instrumentation (const bool enabled, const bool profile_hardware = false) :
+    enabled(enabled || profile_hardware), profile_hardware(profile_hardware), 
+    seconds(NUMBER_OF_PHASES, 0.), counts(NUMBER_OF_COUNTERS, 0.), 
+    events(NUMBER_OF_PHASES), hardware(profile_hardware)
+  {
+    for (auto& phase : events) phase.fill(0.);
+  }
+
+  void increment (const sampler_counter counter, const double by = 1.)
+  {
+    if (enabled) counts[counter] += by;
+  }
+};
+
+class phase_timer
+{
+  // adds wall time (and hardware events, if profiled) of enclosing scope to a phase
+  typedef std::chrono::steady_clock clock;
+  sampler_instrumentation& instrumentation;
+  const sampler_phase phase;
+  clock::time_point start;
+  hardware_event_counts start_events;
+
+  public:
+  phase_timer (sampler_instrumentation& instrumentation, const sampler_phase phase) :
+    instrumentation(instrumentation), phase(phase)
+  {
+    if (instrumentation.profile_hardware) start_events = instrumentation.hardware.read();
+    if (instrumentation.enabled) start = clock::now();
+  }
+
+  ~phase_timer (void)
+  {
+    if (instrumentation.enabled)
+    {
+      instrumentation.seconds[phase] += std::chrono::duration<double>(clock::now() - start).count();
+    }
+    if (instrumentation.profile_hardware)
+    {
+      const hardware_event_counts end_events = instrumentation.hardware.read();
+      for (unsigned event=0; event<NUMBER_OF_HARDWARE_EVENTS; ++event)
+      {
+        instrumentation.events[phase][event] += end_events[event] - start_events[event];
+      }
+    }
+  }
+};
+
+} // namespace sydneyPaternity
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef _SYDNEYPATERNITY_CORE_RANDOM_H
+#define _SYDNEYPATERNITY_CORE_RANDOM_H
+
+#include <armadillo>
+#include <random>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "sampling.h"
+
+// Independent random number streams, so that batches of replicates can be simulated
+// and fit without touching R's global RNG state. Samplers are templated on the 
+// generator; the R package supplies a generator with the same interface that draws 
+// from R's RNG (see src/random.h).
+
+namespace sydneyPaternity {
+
+class random_number_generator
+{
+  std::mt19937_64 engine;
+  std::uniform_real_distribution<double> uniform_distribution;
+
+  public:
+  random_number_generator (const uint64_t seed) : engine(seed), uniform_distribution(0., 1.) {}
+
+  double uniform (void)
+  {
+    return uniform_distribution(engine);
+  }
+
+  unsigned integer (const unsigned upper)
+  {
+    // uniform on [0, upper)
+    return std::uniform_int_distribution<unsigned>(0, upper-1)(engine);
+  }
+
+  double gamma (const double shape)
+  {
+    return std::gamma_distribution<double>(shape, 1.)(engine);
+  }
+
+  double beta (const double a, const double b)
+  {
+    const double x = gamma(a);
+    const double y = gamma(b);
+    return x / (x + y);
+  }
+
+  arma::uword categorical (const arma::vec& pvec)
+  {
+    // inverse cdf; pvec need not be normalized
+    return sample_categorical(pvec.memptr(), pvec.n_elem, *this);
+  }
+
+  std::string state (void) const
+  {
+    // for checkpointing; restoring continues the stream exactly
+    std::ostringstream stream;
+    stream << engine << " " << uniform_distribution;
+    return stream.str();
+  }
+
+  void set_state (const std::string& state)
+  {
+    std::istringstream stream (state);
+    stream >> engine >> uniform_distribution;
+    if (!stream) throw std::runtime_error("invalid random number generator state");
+  }
+};
+
+inline uint64_t splitmix64 (uint64_t x)
+{
+  // hash used to derive well-separated seeds for independent streams from a single seed
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+class stream_random_number_generator
+{
+  // counter-based stream (splitmix64 over a counter) keyed by (seed, stream): cheap to start, so that
+  // parallel tasks can each have their own stream, making draws independent of the number of threads
+  uint64_t counter;
+
+  public:
+  typedef uint64_t result_type;
+  static constexpr result_type min (void) { return 0; }
+  static constexpr result_type max (void) { return ~result_type(0); }
+
+  stream_random_number_generator (const uint64_t seed, const uint64_t stream) : counter(splitmix64(seed ^ splitmix64(stream))) {}
+
+  result_type operator() (void)
+  {
+    const uint64_t x = splitmix64(counter);
+    counter += 0x9e3779b97f4a7c15ULL;
+    return x;
+  }
+
+  double uniform (void)
+  {
+    // on (0, 1), from the top 53 bits
+    return (double((*this)() >> 11) + 0.5) / 9007199254740992.;
+  }
+
+  unsigned integer (const unsigned upper)
+  {
+    // uniform on [0, upper)
+    return std::min(unsigned(uniform() * double(upper)), upper-1);
+  }
+
+  double gamma (const double shape)
+  {
+    return std::gamma_distribution<double>(shape, 1.)(*this);
+  }
+
+  double beta (const double a, const double b)
+  {
+    const double x = gamma(a);
+    const double y = gamma(b);
+    return x / (x + y);
+  }
+
+  arma::uword categorical (const arma::vec& pvec)
+  {
+    // inverse cdf; pvec need not be normalized
+    return sample_categorical(pvec.memptr(), pvec.n_elem, *this);
+  }
+};
+
+template <class RNG>
+uint64_t random_seed (RNG& rng)
+{
+  // 64-bit seed from two uniform draws, to start streams for parallel tasks from any generator
+  const uint64_t upper = uint64_t(rng.uniform() * 4294967296.);
+  const uint64_t lower = uint64_t(rng.uniform() * 4294967296.);
+  return (upper << 32) ^ lower;
+}
+
+} // namespace sydneyPaternity
+
+#endif
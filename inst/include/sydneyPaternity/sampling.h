@@ -0,0 +1,165 @@
+#ifndef _SYDNEYPATERNITY_CORE_SAMPLING_H
+#define _SYDNEYPATERNITY_CORE_SAMPLING_H
+
+#include <armadillo>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+// Categorical, Dirichlet and beta draws that work in place on caller-owned weights,
+// for use once per sib or genotype per sweep. Weights need not be normalized, and
+// log-weights need not have their maximum subtracted. For repeated draws from a
+// fixed distribution, alias_table gives O(1) draws after O(n) setup (Vose 1991).
+// All are templated on a generator with the interface in random.h.
+
+namespace sydneyPaternity {
+
+template <class RNG>
+arma::uword sample_categorical (const double* weights, const arma::uword n, RNG& rng)
+{
+  // inverse cdf on unnormalized, nonnegative weights; if rounding carries the target past the
+  // end, the last category with positive weight is returned
+  double total = 0.;
+  arma::uword last = n;
+  for (arma::uword k=0; k<n; ++k) 
+  {
+    total += weights[k];
+    if (weights[k] > 0.) last = k;
+  }
+  if (last == n || !std::isfinite(total)) throw std::invalid_argument("categorical weights must have a positive, finite sum");
+  double target = rng.uniform() * total;
+  for (arma::uword k=0; k<last; ++k)
+  {
+    target -= weights[k];
+    if (target < 0.) return k;
+  }
+  return last;
+}
+
+template <class RNG>
+arma::uword sample_log_categorical (const double* log_weights, const arma::uword n, RNG& rng)
+{
+  // inverse cdf on exp(log_weights - max), with the exponentials recomputed rather than stored; if
+  // rounding carries the target past the end, the last category with finite log-weight is returned
+  double maximum = -std::numeric_limits<double>::infinity();
+  arma::uword last = n;
+  for (arma::uword k=0; k<n; ++k) 
+  {
+    if (log_weights[k] > maximum) maximum = log_weights[k];
+    if (log_weights[k] > -std::numeric_limits<double>::infinity()) last = k;
+  }
+  if (last == n || !std::isfinite(maximum)) throw std::invalid_argument("categorical log-weights must be finite and not all -inf");
+  double total = 0.;
+  for (arma::uword k=0; k<n; ++k) total += std::exp(log_weights[k] - maximum);
+  if (std::isnan(total)) throw std::invalid_argument("categorical log-weights must be finite and not all -inf");
+  double target = rng.uniform() * total;
+  for (arma::uword k=0; k<last; ++k)
+  {
+    target -= std::exp(log_weights[k] - maximum);
+    if (target < 0.) return k;
+  }
+  return last;
+}
+
+template <class RNG>
+arma::uword sample_log_categorical_gumbel (const double* log_weights, const arma::uword n, RNG& rng)
+{
+  // argmax of log_weights + Gumbel noise; one pass, no exponentials, but a uniform per category
+  arma::uword draw = n;
+  double maximum = -std::numeric_limits<double>::infinity();
+  for (arma::uword k=0; k<n; ++k)
+  {
+    if (log_weights[k] == -std::numeric_limits<double>::infinity()) continue;
+    if (!std::isfinite(log_weights[k])) throw std::invalid_argument("categorical log-weights must be finite and not all -inf");
+    const double perturbed = log_weights[k] - std::log(-std::log(rng.uniform()));
+    if (draw == n || perturbed > maximum)
+    {
+      maximum = perturbed;
+      draw = k;
+    }
+  }
+  if (draw == n) throw std::invalid_argument("categorical log-weights must be finite and not all -inf");
+  return draw;
+}
+
+template <class RNG>
+arma::uword sample_log_categorical (const arma::vec& log_weights, RNG& rng)
+{
+  return sample_log_categorical(log_weights.memptr(), log_weights.n_elem, rng);
+}
+
+class alias_table
+{
+  std::vector<double> threshold;
+  std::vector<arma::uword> alias;
+
+  public:
+  alias_table (void) {}
+
+  alias_table (const arma::vec& weights) : threshold(weights.n_elem), alias(weights.n_elem)
+  {
+    const arma::uword n = weights.n_elem;
+    if (n == 0) throw std::invalid_argument("alias table needs at least one category");
+    const double total = arma::accu(weights);
+    if (!(total > 0.) || !std::isfinite(total)) throw std::invalid_argument("alias table needs positive, finite total weight");
+    std::vector<arma::uword> small, large;
+    for (arma::uword k=0; k<n; ++k)
+    {
+      if (weights[k] < 0.) throw std::invalid_argument("negative weight");
+      threshold[k] = weights[k] * double(n) / total;
+      alias[k] = k;
+      (threshold[k] < 1. ? small : large).push_back(k);
+    }
+    while (!small.empty() && !large.empty())
+    {
+      const arma::uword s = small.back(); small.pop_back();
+      const arma::uword l = large.back();
+      alias[s] = l;
+      threshold[l] -= 1. - threshold[s];
+      if (threshold[l] < 1.)
+      {
+        large.pop_back();
+        small.push_back(l);
+      }
+    }
+    for (auto k : small) threshold[k] = 1.; //rounding
+    for (auto k : large) threshold[k] = 1.;
+  }
+
+  template <class RNG>
+  arma::uword draw (RNG& rng) const
+  {
+    const double u = rng.uniform() * double(threshold.size());
+    const arma::uword k = std::min(arma::uword(u), arma::uword(threshold.size() - 1));
+    return u - double(k) < threshold[k] ? k : alias[k];
+  }
+
+  arma::uword size (void) const
+  {
+    return threshold.size();
+  }
+};
+
+template <class RNG>
+void sample_dirichlet (const double* concentration, const arma::uword n, double* out, RNG& rng)
+{
+  // normalized gammas, written to "out" (which may alias "concentration")
+  double total = 0.;
+  for (arma::uword k=0; k<n; ++k)
+  {
+    out[k] = rng.gamma(concentration[k]);
+    total += out[k];
+  }
+  for (arma::uword k=0; k<n; ++k) out[k] /= total;
+}
+
+template <class RNG>
+void sample_beta (const double* first_shape, const double* second_shape, const arma::uword n, double* out, RNG& rng)
+{
+  for (arma::uword k=0; k<n; ++k) out[k] = rng.beta(first_shape[k], second_shape[k]);
+}
+
+} // namespace sydneyPaternity
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _SYDNEYPATERNITY_CORE_SCALED_H
+#define _SYDNEYPATERNITY_CORE_SCALED_H
+
+#include <cmath>
+#include <limits>
+
+// Probabilities in linear space with a separate power-of-two exponent, so that long
+// products (e.g. over offspring in a sib group) and sums of such products can be
+// formed without underflow and without a log/exp per term. Rescaling is by powers
+// of two, hence exact; the only transcendental call is the final log().
+
+namespace sydneyPaternity {
+
+struct scaled_double
+{
+  double mantissa;
+  int exponent; //value is mantissa * 2^exponent
+
+  static constexpr int rescale_bits = 256;
+
+  scaled_double (const double value = 0.) : mantissa(value), exponent(0) {}
+
+  scaled_double& operator*= (const double factor)
+  {
+    // rescaling is checked once per product term, rather than normalizing (frexp) every time
+    mantissa *= factor;
+    if (mantissa < std::ldexp(1., -rescale_bits) && mantissa > 0.)
+    {
+      mantissa = std::ldexp(mantissa, rescale_bits);
+      exponent -= rescale_bits;
+    }
+    return *this;
+  }
+
+  scaled_double& operator*= (const scaled_double& factor)
+  {
+    *this *= factor.mantissa;
+    exponent += factor.exponent;
+    return *this;
+  }
+
+  double log (void) const
+  {
+    return std::log(mantissa) + double(exponent) * 0.693147180559945309417; //log(2)
+  }
+};
+
+class scaled_sum
+{
+  // sum of scaled_doubles, aligned to the exponent of the largest term seen so far
+  // (the analogue of the running maximum used for underflow protection in log space)
+  scaled_double total;
+  bool empty;
+
+  public:
+  scaled_sum (void) : total(0.), empty(true) {}
+
+  void add (const scaled_double& term)
+  {
+    if (term.mantissa == 0.) return;
+    if (empty)
+    {
+      total = term;
+      empty = false;
+    } else if (term.exponent <= total.exponent) {
+      total.mantissa += std::ldexp(term.mantissa, term.exponent - total.exponent);
+    } else {
+      total.mantissa = std::ldexp(total.mantissa, total.exponent - term.exponent) + term.mantissa;
+      total.exponent = term.exponent;
+    }
+  }
+
+  scaled_double value (void) const
+  {
+    return total;
+  }
+
+  double log (void) const
+  {
+    return empty ? -std::numeric_limits<double>::infinity() : total.log();
+  }
+};
+
+} // namespace sydneyPaternity
+
+#endif
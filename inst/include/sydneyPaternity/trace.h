@@ -0,0 +1,229 @@
+#ifndef _SYDNEYPATERNITY_CORE_TRACE_H
+#define _SYDNEYPATERNITY_CORE_TRACE_H
+
+#include <armadillo>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "checkpoint.h"
+
+// Delta-encoded history of a vector of labels (e.g. paternity of each offspring
+// across MCMC iterations). Once a chain has settled, few labels change between
+// iterations, so only changed entries are stored, with a full keyframe every
+// keyframe_interval iterations so that any single iteration decodes quickly.
+
+namespace sydneyPaternity {
+
+inline arma::uvec canonical_labels (const arma::uvec& labels, const unsigned fixed_labels = 0)
+{
+  // labels below "fixed_labels" are kept, the rest are renumbered from "fixed_labels" by order of
+  // first appearance; so that relabelling exchangeable groups (e.g. by recode_to_contiguous_integers,
+  // when a group empties) does not look like a change
+  const uint32_t unassigned = std::numeric_limits<uint32_t>::max();
+  arma::uvec canonical (labels.n_elem);
+  if (labels.is_empty()) return canonical;
+  std::vector<uint32_t> relabel (labels.max() + 1, unassigned);
+  uint32_t next = fixed_labels;
+  for (unsigned i=0; i<labels.n_elem; ++i)
+  {
+    if (labels[i] < fixed_labels)
+    {
+      canonical[i] = labels[i];
+    } else {
+      if (relabel[labels[i]] == unassigned) relabel[labels[i]] = next++;
+      canonical[i] = relabel[labels[i]];
+    }
+  }
+  return canonical;
+}
+
+class parentage_trace
+{
+  uint32_t number_of_labels;
+  uint32_t keyframe_interval;
+  uint32_t fixed_labels; //see canonical_labels
+  uint32_t number_of_iterations;
+  std::vector<int32_t> keyframes; //number_of_labels per keyframe
+  std::vector<uint32_t> change_offsets; //start of each iteration's changes
+  std::vector<uint32_t> changed_index;
+  std::vector<int32_t> changed_label;
+  std::vector<int32_t> last; //most recently stored labels
+
+  public:
+  parentage_trace (const unsigned number_of_labels = 0, const unsigned keyframe_interval = 100, const unsigned fixed_labels = 0) :
+    number_of_labels(number_of_labels), keyframe_interval(keyframe_interval), fixed_labels(fixed_labels), 
+    number_of_iterations(0), change_offsets(1, 0), last(number_of_labels, 0)
+  {
+    if (keyframe_interval == 0) throw std::invalid_argument("keyframe interval must be positive");
+  }
+
+  void push (const arma::uvec& raw_labels)
+  {
+    // labels are stored in canonical order, so the trace decodes to canonical_labels of what was pushed
+    if (raw_labels.n_elem != number_of_labels) throw std::invalid_argument("trace labels have wrong dimension");
+    const arma::uvec labels = canonical_labels(raw_labels, fixed_labels);
+    if (number_of_iterations % keyframe_interval == 0)
+    {
+      for (unsigned i=0; i<number_of_labels; ++i)
+      {
+        last[i] = int32_t(labels[i]);
+        keyframes.push_back(last[i]);
+      }
+    } else {
+      for (unsigned i=0; i<number_of_labels; ++i)
+      {
+        if (int32_t(labels[i]) != last[i])
+        {
+          last[i] = int32_t(labels[i]);
+          changed_index.push_back(i);
+          changed_label.push_back(last[i]);
+        }
+      }
+    }
+    change_offsets.push_back(changed_index.size());
+    number_of_iterations++;
+  }
+
+  arma::ivec column (const unsigned iteration) const
+  {
+    // labels at a single iteration, replaying changes since the previous keyframe
+    if (iteration >= number_of_iterations) throw std::out_of_range("trace iteration out of range");
+    const unsigned keyframe = iteration / keyframe_interval;
+    arma::ivec labels (number_of_labels);
+    for (unsigned i=0; i<number_of_labels; ++i) labels[i] = keyframes[keyframe*number_of_labels + i];
+    for (unsigned j=change_offsets[keyframe*keyframe_interval]; j<change_offsets[iteration+1]; ++j)
+    {
+      labels[changed_index[j]] = changed_label[j];
+    }
+    return labels;
+  }
+
+  arma::imat decode (void) const
+  {
+    // dense labels by iterations
+    arma::imat dense (number_of_labels, number_of_iterations);
+    arma::ivec labels (number_of_labels);
+    for (unsigned iteration=0; iteration<number_of_iterations; ++iteration)
+    {
+      if (iteration % keyframe_interval == 0)
+      {
+        const unsigned keyframe = iteration / keyframe_interval;
+        for (unsigned i=0; i<number_of_labels; ++i) labels[i] = keyframes[keyframe*number_of_labels + i];
+      }
+      for (unsigned j=change_offsets[iteration]; j<change_offsets[iteration+1]; ++j)
+      {
+        labels[changed_index[j]] = changed_label[j];
+      }
+      dense.col(iteration) = labels;
+    }
+    return dense;
+  }
+
+  unsigned size (void) const
+  {
+    return number_of_iterations;
+  }
+
+  unsigned labels (void) const
+  {
+    return number_of_labels;
+  }
+
+  unsigned interval (void) const
+  {
+    return keyframe_interval;
+  }
+
+  unsigned fixed (void) const
+  {
+    return fixed_labels;
+  }
+
+  double bytes (void) const
+  {
+    return double(keyframes.size() * sizeof(int32_t) + change_offsets.size() * sizeof(uint32_t) +
+        changed_index.size() * sizeof(uint32_t) + changed_label.size() * sizeof(int32_t));
+  }
+
+  const std::vector<int32_t>& keyframe_labels (void) const { return keyframes; }
+  const std::vector<uint32_t>& offsets (void) const { return change_offsets; }
+  const std::vector<uint32_t>& change_indices (void) const { return changed_index; }
+  const std::vector<int32_t>& change_labels (void) const { return changed_label; }
+
+  static parentage_trace from_components
+   (const unsigned number_of_labels,
+    const unsigned keyframe_interval,
+    const unsigned fixed_labels,
+    const std::vector<int32_t>& keyframes,
+    const std::vector<uint32_t>& change_offsets,
+    const std::vector<uint32_t>& changed_index,
+    const std::vector<int32_t>& changed_label)
+  {
+    // rebuild a trace (e.g. one passed back from R), checking consistency
+    parentage_trace trace (number_of_labels, keyframe_interval, fixed_labels);
+    if (change_offsets.empty() || change_offsets[0] != 0) throw std::invalid_argument("trace offsets must start at 0");
+    trace.number_of_iterations = change_offsets.size() - 1;
+    const unsigned number_of_keyframes = (trace.number_of_iterations + keyframe_interval - 1) / keyframe_interval;
+    if (keyframes.size() != size_t(number_of_keyframes) * number_of_labels) throw std::invalid_argument("trace has wrong number of keyframes");
+    if (changed_index.size() != changed_label.size() || change_offsets.back() != changed_index.size())
+    {
+      throw std::invalid_argument("trace changes are inconsistent with offsets");
+    }
+    for (unsigned i=1; i<change_offsets.size(); ++i)
+    {
+      if (change_offsets[i] < change_offsets[i-1]) throw std::invalid_argument("trace offsets must be nondecreasing");
+    }
+    for (auto index : changed_index) if (index >= number_of_labels) throw std::invalid_argument("trace change index out of range");
+    trace.keyframes = keyframes;
+    trace.change_offsets = change_offsets;
+    trace.changed_index = changed_index;
+    trace.changed_label = changed_label;
+    for (auto label : keyframes) if (label < 0) throw std::invalid_argument("trace labels must be non-negative");
+    for (auto label : changed_label) if (label < 0) throw std::invalid_argument("trace labels must be non-negative");
+    const arma::imat dense = trace.decode();
+    for (unsigned iteration=0; iteration<dense.n_cols; ++iteration)
+    {
+      const arma::uvec labels = arma::conv_to<arma::uvec>::from(dense.col(iteration));
+      if (arma::any(canonical_labels(labels, fixed_labels) != labels))
+      {
+        throw std::invalid_argument("trace labels are not in canonical order for its fixed labels");
+      }
+    }
+    if (trace.number_of_iterations > 0)
+    {
+      for (unsigned i=0; i<number_of_labels; ++i) trace.last[i] = dense.at(i, trace.number_of_iterations - 1);
+    }
+    return trace;
+  }
+
+  void write (std::ostream& stream) const
+  {
+    write_checkpoint_value(stream, number_of_labels);
+    write_checkpoint_value(stream, keyframe_interval);
+    write_checkpoint_value(stream, fixed_labels);
+    write_checkpoint_value(stream, number_of_iterations);
+    write_checkpoint_value(stream, keyframes);
+    write_checkpoint_value(stream, change_offsets);
+    write_checkpoint_value(stream, changed_index);
+    write_checkpoint_value(stream, changed_label);
+    write_checkpoint_value(stream, last);
+  }
+
+  void read (std::istream& stream)
+  {
+    read_checkpoint_value(stream, number_of_labels);
+    read_checkpoint_value(stream, keyframe_interval);
+    read_checkpoint_value(stream, fixed_labels);
+    read_checkpoint_value(stream, number_of_iterations);
+    read_checkpoint_value(stream, keyframes);
+    read_checkpoint_value(stream, change_offsets);
+    read_checkpoint_value(stream, changed_index);
+    read_checkpoint_value(stream, changed_label);
+    read_checkpoint_value(stream, last);
+  }
+};
+
+} // namespace sydneyPaternity
+
+#endif
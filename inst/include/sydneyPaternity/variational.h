@@ -0,0 +1,338 @@
+#ifndef _SYDNEYPATERNITY_CORE_VARIATIONAL_H
+#define _SYDNEYPATERNITY_CORE_VARIATIONAL_H
+
+#include <armadillo>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "mendelian.h"
+
+// Mean-field variational approximation to the paternity model of paternity_loglikelihood_by_locus
+// (one diploid mother, haploid fathers, diploid offspring; error rates and allele frequencies fixed),
+// for screening many colonies without MCMC. Offspring are assigned to one of K fathers with weights
+// pi ~ Dirichlet(concentration/K), and the posterior is approximated by
+//   q(maternal genotype at each locus) q(allele of each father at each locus) q(fathers of offspring) q(pi)
+// with coordinate ascent on the evidence lower bound (ELBO), which cannot decrease from one pass to the next
+// in exact arithmetic (a decrease beyond the tolerance is flagged, as numerical trouble). Fathers are
+// seeded deterministically: the offspring with the most typed loci seeds the first, then the offspring
+// that is explained worst by the existing fathers seeds another, for as long as a new father would
+// explain it better. Transmission probabilities depend on offspring only through their phenotype at
+// a locus, so are tabulated once per distinct phenotype.
+
+namespace sydneyPaternity {
+
+inline double digamma_function (double x)
+{
+  // recurrence up to x >= 6, then the asymptotic series
+  double out = 0.;
+  for (; x < 6.; x += 1.) out -= 1./x;
+  const double x2 = 1./(x*x);
+  return out + std::log(x) - 0.5/x - x2*(1./12. - x2*(1./120. - x2*(1./252. - x2*(1./240. - x2/132.))));
+}
+
+struct paternity_variational_fit
+{
+  arma::mat assignment; //offspring x fathers, q(father of offspring), fathers in decreasing order of size
+  arma::uvec paternity; //column of "assignment" with the largest probability
+  arma::vec expected_offspring; //per father
+  double expected_number_of_fathers; //with at least one offspring
+  arma::vec elbo; //per pass
+  unsigned iterations;
+  bool converged; //ELBO changed by less than the tolerance
+  bool elbo_decreased; //ELBO fell by more than the tolerance at some pass
+};
+
+inline paternity_variational_fit fit_paternity_variational
+ (const arma::ucube& offspring_phenotypes,
+  const arma::umat& maternal_phenotype,
+  const std::vector<arma::vec>& allele_frequencies,
+  const arma::vec& dropout_rate,
+  const arma::vec& mistyping_rate,
+  const double concentration = 1.,
+  const unsigned max_number_of_fathers = 0,
+  const unsigned max_iterations = 100,
+  const double convergence_tolerance = 1e-6)
+{
+  // phenotypes are 1-based contiguous alleles with 0 missing, as from collapse_alleles_and_generate_genotype_prior;
+  // "max_number_of_fathers" of 0 allows as many fathers as offspring
+  const unsigned number_of_loci = allele_frequencies.size();
+  const unsigned number_of_offspring = offspring_phenotypes.n_cols;
+
+  if (number_of_loci < 1) throw std::invalid_argument("need at least one locus");
+  if (number_of_offspring < 1) throw std::invalid_argument("need at least one offspring");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_slices != number_of_loci) throw std::invalid_argument("must have offspring phenotypes for each locus");
+  if (maternal_phenotype.n_rows != 2 || maternal_phenotype.n_cols != number_of_loci) throw std::invalid_argument("must have maternal phenotypes for each locus");
+  if (dropout_rate.n_elem != number_of_loci) throw std::invalid_argument("must have dropout rates for each locus");
+  if (mistyping_rate.n_elem != number_of_loci) throw std::invalid_argument("must have mistyping rates for each locus");
+  if (concentration <= 0.) throw std::invalid_argument("concentration must be positive");
+
+  const unsigned max_fathers = max_number_of_fathers == 0 ?
+    number_of_offspring : std::min(max_number_of_fathers, number_of_offspring);
+
+  auto normalize_log = [] (arma::vec& log_weights)
+  {
+    // log weights to probabilities, in place
+    log_weights = arma::exp(log_weights - log_weights.max());
+    log_weights /= arma::accu(log_weights);
+  };
+
+  auto expected_log = [] (const arma::vec& probability, const arma::vec& log_weights)
+  {
+    // sum of probability * log_weights, with 0 * log(0) = 0
+    double out = 0.;
+    for (unsigned j=0; j<probability.n_elem; ++j) if (probability[j] > 0.) out += probability[j] * log_weights[j];
+    return out;
+  };
+
+  // per locus: log allele frequencies; log prior times maternal phenotype probability of maternal genotypes
+  // (w, v >= w, in the order of the likelihood kernels); and log transmission probabilities,
+  // (paternal allele, maternal genotype, distinct offspring phenotype)
+  std::vector<arma::vec> log_frequency (number_of_loci);
+  std::vector<arma::vec> log_genotype_prior (number_of_loci);
+  std::vector<arma::cube> log_transmission (number_of_loci);
+  arma::imat phenotype_class (number_of_offspring, number_of_loci); //-1 if missing
+  arma::uvec typed_loci (number_of_offspring, arma::fill::zeros);
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    const unsigned number_of_alleles = allele_frequencies[locus].n_elem;
+    const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
+    if (number_of_alleles < 1) throw std::invalid_argument("need at least one allele per locus");
+    if (arma::any(allele_frequencies[locus] < 0.) || arma::accu(allele_frequencies[locus]) <= 0.) throw std::invalid_argument("invalid allele frequencies");
+    if (offspring_phenotypes.slice(locus).max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+    if (maternal_phenotype.col(locus).max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+    if (dropout_rate[locus] <= 0. || mistyping_rate[locus] <= 0.) throw std::invalid_argument("negative genotyping error rates");
+
+    const genotyping_error_rates rate (number_of_alleles, dropout_rate[locus], mistyping_rate[locus]);
+    const arma::vec frequency = allele_frequencies[locus] / arma::accu(allele_frequencies[locus]);
+    log_frequency[locus] = arma::log(frequency);
+
+    arma::uvec first_allele (number_of_genotypes), second_allele (number_of_genotypes);
+    log_genotype_prior[locus].set_size(number_of_genotypes);
+    const unsigned m0 = maternal_phenotype.at(0, locus), m1 = maternal_phenotype.at(1, locus);
+    for (unsigned w=0, g=0; w<number_of_alleles; ++w)
+    {
+      for (unsigned v=w; v<number_of_alleles; ++v, ++g)
+      {
+        first_allele[g] = w; second_allele[g] = v;
+        log_genotype_prior[locus][g] = std::log((2.-int(w==v)) * frequency[w] * frequency[v]); //hwe prior
+        if (m0 && m1) log_genotype_prior[locus][g] += std::log(diploid_phenotype_probability(m0, m1, w+1, v+1, rate));
+      }
+    }
+
+    std::map<std::pair<unsigned, unsigned>, int> classes;
+    std::vector<std::pair<unsigned, unsigned>> phenotypes;
+    for (unsigned i=0; i<number_of_offspring; ++i)
+    {
+      const unsigned a = offspring_phenotypes.at(0, i, locus), b = offspring_phenotypes.at(1, i, locus);
+      if (!a || !b) { phenotype_class.at(i, locus) = -1; continue; }
+      auto found = classes.emplace(std::make_pair(a, b), int(phenotypes.size()));
+      if (found.second) phenotypes.emplace_back(a, b);
+      phenotype_class.at(i, locus) = found.first->second;
+      typed_loci[i]++;
+    }
+
+    log_transmission[locus].set_size(number_of_alleles, number_of_genotypes, phenotypes.size());
+    arma::mat emission (number_of_alleles, number_of_alleles); //(maternal allele, paternal allele)
+    for (unsigned c=0; c<phenotypes.size(); ++c)
+    {
+      diploid_transmission_table(phenotypes[c].first, phenotypes[c].second, number_of_alleles, rate, emission.memptr());
+      for (unsigned g=0; g<number_of_genotypes; ++g)
+      {
+        for (unsigned u=0; u<number_of_alleles; ++u)
+        {
+          log_transmission[locus].at(u, g, c) =
+            std::log(0.5 * emission.at(first_allele[g], u) + 0.5 * emission.at(second_allele[g], u));
+        }
+      }
+    }
+  }
+
+  // variational factors; "expected_log_transmission" is, for each distinct offspring phenotype, the
+  // expected log transmission probability over q(maternal genotype) given each paternal allele
+  std::vector<arma::vec> genotype_posterior (number_of_loci);
+  std::vector<arma::mat> allele_posterior (number_of_loci);
+  std::vector<arma::mat> expected_log_transmission (number_of_loci);
+
+  auto update_expected_log_transmission = [&] (const unsigned locus)
+  {
+    const arma::cube& table = log_transmission[locus];
+    expected_log_transmission[locus].set_size(table.n_rows, table.n_slices);
+    for (unsigned c=0; c<table.n_slices; ++c)
+    {
+      expected_log_transmission[locus].col(c) = table.slice(c) * genotype_posterior[locus];
+    }
+  };
+
+  auto offspring_per_phenotype = [&] (const unsigned locus, const arma::mat& weights)
+  {
+    // sums rows of offspring x fathers "weights" over offspring with the same phenotype
+    arma::mat out (log_transmission[locus].n_slices, weights.n_cols, arma::fill::zeros);
+    for (unsigned i=0; i<number_of_offspring; ++i)
+    {
+      if (phenotype_class.at(i, locus) >= 0) out.row(phenotype_class.at(i, locus)) += weights.row(i);
+    }
+    return out;
+  };
+
+  // start from the maternal phenotype alone, then seed fathers
+  arma::vec new_father_score (number_of_offspring, arma::fill::zeros);
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    genotype_posterior[locus] = log_genotype_prior[locus];
+    normalize_log(genotype_posterior[locus]);
+    update_expected_log_transmission(locus);
+    allele_posterior[locus].set_size(allele_frequencies[locus].n_elem, 0);
+    for (unsigned i=0; i<number_of_offspring; ++i)
+    {
+      const int c = phenotype_class.at(i, locus);
+      if (c < 0) continue;
+      const arma::vec log_weights = log_frequency[locus] + expected_log_transmission[locus].col(c);
+      new_father_score[i] += log_weights.max() + std::log(arma::accu(arma::exp(log_weights - log_weights.max())));
+    }
+  }
+
+  arma::vec best_father_score (number_of_offspring); best_father_score.fill(-arma::datum::inf);
+  arma::uword seed = typed_loci.index_max();
+  for (unsigned k=0; k<max_fathers; ++k)
+  {
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      arma::vec log_weights = log_frequency[locus];
+      const int c = phenotype_class.at(seed, locus);
+      if (c >= 0) log_weights += expected_log_transmission[locus].col(c);
+      normalize_log(log_weights);
+      allele_posterior[locus].insert_cols(k, log_weights);
+    }
+    arma::vec father_score (number_of_offspring, arma::fill::zeros);
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      const arma::vec score = expected_log_transmission[locus].t() * allele_posterior[locus].col(k);
+      for (unsigned i=0; i<number_of_offspring; ++i)
+      {
+        if (phenotype_class.at(i, locus) >= 0) father_score[i] += score[phenotype_class.at(i, locus)];
+      }
+    }
+    best_father_score = arma::max(best_father_score, father_score);
+    const arma::vec gain = new_father_score - best_father_score;
+    seed = gain.index_max();
+    if (gain[seed] <= 0.) break;
+  }
+  const unsigned number_of_fathers = allele_posterior[0].n_cols;
+  const double prior_weight = concentration / double(number_of_fathers);
+
+  arma::mat assignment (number_of_offspring, number_of_fathers);
+  arma::vec dirichlet (number_of_fathers); dirichlet.fill(prior_weight + double(number_of_offspring)/double(number_of_fathers));
+  std::vector<double> elbo;
+  bool converged = false, elbo_decreased = false;
+  unsigned iter;
+  for (iter=0; iter<max_iterations; ++iter)
+  {
+    arma::vec expected_log_weight = dirichlet;
+    const double expected_log_total = digamma_function(arma::accu(dirichlet));
+    expected_log_weight.transform([&] (double x) { return digamma_function(x) - expected_log_total; });
+
+    // fathers of offspring
+    assignment.each_row() = expected_log_weight.t();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      const arma::mat score = expected_log_transmission[locus].t() * allele_posterior[locus]; //phenotype x father
+      for (unsigned i=0; i<number_of_offspring; ++i)
+      {
+        if (phenotype_class.at(i, locus) >= 0) assignment.row(i) += score.row(phenotype_class.at(i, locus));
+      }
+    }
+    for (unsigned i=0; i<number_of_offspring; ++i)
+    {
+      arma::vec log_weights = assignment.row(i).t();
+      normalize_log(log_weights);
+      assignment.row(i) = log_weights.t();
+    }
+
+    // weights of fathers
+    dirichlet = prior_weight + arma::sum(assignment, 0).t();
+
+    // maternal genotypes, then paternal alleles
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      const arma::cube& table = log_transmission[locus];
+      const arma::mat expected_paternal_allele = // paternal allele x phenotype
+        allele_posterior[locus] * offspring_per_phenotype(locus, assignment).t();
+      arma::vec log_weights = log_genotype_prior[locus];
+      for (unsigned c=0; c<table.n_slices; ++c) log_weights += table.slice(c).t() * expected_paternal_allele.col(c);
+      normalize_log(log_weights);
+      genotype_posterior[locus] = log_weights;
+      update_expected_log_transmission(locus);
+
+      allele_posterior[locus] = expected_log_transmission[locus] * offspring_per_phenotype(locus, assignment);
+      allele_posterior[locus].each_col() += log_frequency[locus];
+      for (unsigned k=0; k<number_of_fathers; ++k)
+      {
+        arma::vec weights = allele_posterior[locus].col(k);
+        normalize_log(weights);
+        allele_posterior[locus].col(k) = weights;
+      }
+    }
+
+    // evidence lower bound
+    expected_log_weight = dirichlet;
+    const double expected_log_total_update = digamma_function(arma::accu(dirichlet));
+    expected_log_weight.transform([&] (double x) { return digamma_function(x) - expected_log_total_update; });
+    double bound = 0.;
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      const arma::vec& genotypes = genotype_posterior[locus];
+      bound += expected_log(genotypes, log_genotype_prior[locus]) - expected_log(genotypes, arma::log(genotypes));
+      for (unsigned k=0; k<number_of_fathers; ++k)
+      {
+        const arma::vec alleles = allele_posterior[locus].col(k);
+        bound += expected_log(alleles, log_frequency[locus]) - expected_log(alleles, arma::log(alleles));
+      }
+      bound += arma::accu((expected_log_transmission[locus].t() * allele_posterior[locus]) %
+          offspring_per_phenotype(locus, assignment));
+    }
+    for (unsigned i=0; i<number_of_offspring; ++i)
+    {
+      const arma::vec fathers = assignment.row(i).t();
+      bound += expected_log(fathers, expected_log_weight) - expected_log(fathers, arma::log(fathers));
+    }
+    bound += std::lgamma(concentration) - double(number_of_fathers) * std::lgamma(prior_weight) +
+      (prior_weight - 1.) * arma::accu(expected_log_weight);
+    bound -= std::lgamma(arma::accu(dirichlet)) + arma::accu((dirichlet - 1.) % expected_log_weight);
+    for (auto alpha : dirichlet) bound += std::lgamma(alpha);
+    elbo.push_back(bound);
+
+    if (iter == 0) continue;
+    const double delta = elbo[iter] - elbo[iter-1];
+    if (delta < -convergence_tolerance) elbo_decreased = true;
+    if (std::fabs(delta) < convergence_tolerance)
+    {
+      converged = true;
+      iter++;
+      break;
+    }
+  }
+
+  // order fathers by size, dropping those that are numerically empty
+  const double empty_father = 1e-8;
+  paternity_variational_fit fit;
+  arma::vec expected_offspring = arma::sum(assignment, 0).t();
+  arma::uvec order = arma::sort_index(expected_offspring, "descend");
+  order = order.elem(arma::find(expected_offspring.elem(order) >= empty_father));
+  fit.expected_number_of_fathers = arma::accu(1. - arma::exp(arma::sum(arma::log(1. - assignment), 0)));
+  fit.assignment = assignment.cols(order);
+  fit.expected_offspring = expected_offspring.elem(order);
+  fit.paternity = arma::index_max(fit.assignment, 1);
+  fit.elbo = arma::vec(elbo);
+  fit.iterations = iter;
+  fit.converged = converged;
+  fit.elbo_decreased = elbo_decreased;
+  return fit;
+}
+
+} // namespace sydneyPaternity
+
+#endif
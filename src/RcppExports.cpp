@@ -49,6 +49,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// log_uniform_MFM_coefficients
+arma::vec log_uniform_MFM_coefficients(const unsigned n, const double gamma, const unsigned max_number_of_components);
+RcppExport SEXP _sydneyPaternity_log_uniform_MFM_coefficients(SEXP nSEXP, SEXP gammaSEXP, SEXP max_number_of_componentsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const unsigned >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const double >::type gamma(gammaSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type max_number_of_components(max_number_of_componentsSEXP);
+    rcpp_result_gen = Rcpp::wrap(log_uniform_MFM_coefficients(n, gamma, max_number_of_components));
+    return rcpp_result_gen;
+END_RCPP
+}
 // genotyping_error_model
 double genotyping_error_model(const arma::uvec& phenotype, const unsigned& genotype0, const unsigned& genotype1, const unsigned& number_of_alleles, const double& dropout_rate, const double& mistyping_rate);
 RcppExport SEXP _sydneyPaternity_genotyping_error_model(SEXP phenotypeSEXP, SEXP genotype0SEXP, SEXP genotype1SEXP, SEXP number_of_allelesSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP) {
@@ -78,6 +91,22 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// genotyping_error_model_derivatives
+arma::vec genotyping_error_model_derivatives(const arma::uvec& phenotype, const unsigned& genotype0, const unsigned& genotype1, const unsigned& number_of_alleles, const double& dropout_rate, const double& mistyping_rate);
+RcppExport SEXP _sydneyPaternity_genotyping_error_model_derivatives(SEXP phenotypeSEXP, SEXP genotype0SEXP, SEXP genotype1SEXP, SEXP number_of_allelesSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const arma::uvec& >::type phenotype(phenotypeSEXP);
+    Rcpp::traits::input_parameter< const unsigned& >::type genotype0(genotype0SEXP);
+    Rcpp::traits::input_parameter< const unsigned& >::type genotype1(genotype1SEXP);
+    Rcpp::traits::input_parameter< const unsigned& >::type number_of_alleles(number_of_allelesSEXP);
+    Rcpp::traits::input_parameter< const double& >::type dropout_rate(dropout_rateSEXP);
+    Rcpp::traits::input_parameter< const double& >::type mistyping_rate(mistyping_rateSEXP);
+    rcpp_result_gen = Rcpp::wrap(genotyping_error_model_derivatives(phenotype, genotype0, genotype1, number_of_alleles, dropout_rate, mistyping_rate));
+    return rcpp_result_gen;
+END_RCPP
+}
 // simulate_genotyping_errors
 arma::uvec simulate_genotyping_errors(const arma::uvec& phenotype, const unsigned& genotype0, const unsigned& genotype1, const unsigned& number_of_alleles, const double& dropout_rate, const double& mistyping_rate);
 RcppExport SEXP _sydneyPaternity_simulate_genotyping_errors(SEXP phenotypeSEXP, SEXP genotype0SEXP, SEXP genotype1SEXP, SEXP number_of_allelesSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP) {
@@ -94,9 +123,29 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// simulate_colonies
+Rcpp::List simulate_colonies(const unsigned number_of_replicates, arma::mat offspring_per_mating, std::vector<arma::vec> allele_frequencies, arma::vec dropout_rate, arma::vec mistyping_rate, const double probability_of_missing_data, const unsigned number_of_offspring, const unsigned number_of_sampled_mothers, Rcpp::Nullable<Rcpp::IntegerVector> maternal_genotypes, Rcpp::Nullable<Rcpp::IntegerMatrix> paternal_genotypes);
+RcppExport SEXP _sydneyPaternity_simulate_colonies(SEXP number_of_replicatesSEXP, SEXP offspring_per_matingSEXP, SEXP allele_frequenciesSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP, SEXP probability_of_missing_dataSEXP, SEXP number_of_offspringSEXP, SEXP number_of_sampled_mothersSEXP, SEXP maternal_genotypesSEXP, SEXP paternal_genotypesSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_replicates(number_of_replicatesSEXP);
+    Rcpp::traits::input_parameter< arma::mat >::type offspring_per_mating(offspring_per_matingSEXP);
+    Rcpp::traits::input_parameter< std::vector<arma::vec> >::type allele_frequencies(allele_frequenciesSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type dropout_rate(dropout_rateSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type mistyping_rate(mistyping_rateSEXP);
+    Rcpp::traits::input_parameter< const double >::type probability_of_missing_data(probability_of_missing_dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_offspring(number_of_offspringSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_sampled_mothers(number_of_sampled_mothersSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::IntegerVector> >::type maternal_genotypes(maternal_genotypesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::Nullable<Rcpp::IntegerMatrix> >::type paternal_genotypes(paternal_genotypesSEXP);
+    rcpp_result_gen = Rcpp::wrap(simulate_colonies(number_of_replicates, offspring_per_mating, allele_frequencies, dropout_rate, mistyping_rate, probability_of_missing_data, number_of_offspring, number_of_sampled_mothers, maternal_genotypes, paternal_genotypes));
+    return rcpp_result_gen;
+END_RCPP
+}
 // sample_error_rates_given_paternity
-Rcpp::List sample_error_rates_given_paternity(arma::ucube phenotypes, arma::uvec paternity, const unsigned mother, const unsigned number_of_mcmc_samples, const unsigned global_genotyping_error_rates, const bool random_allele_frequencies, const bool add_unsampled_allele);
-RcppExport SEXP _sydneyPaternity_sample_error_rates_given_paternity(SEXP phenotypesSEXP, SEXP paternitySEXP, SEXP motherSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP random_allele_frequenciesSEXP, SEXP add_unsampled_alleleSEXP) {
+Rcpp::List sample_error_rates_given_paternity(arma::ucube phenotypes, arma::uvec paternity, const unsigned mother, const unsigned number_of_mcmc_samples, const unsigned global_genotyping_error_rates, const bool random_allele_frequencies, const bool add_unsampled_allele, const bool instrument, const bool profile_hardware, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_sample_error_rates_given_paternity(SEXP phenotypesSEXP, SEXP paternitySEXP, SEXP motherSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP random_allele_frequenciesSEXP, SEXP add_unsampled_alleleSEXP, SEXP instrumentSEXP, SEXP profile_hardwareSEXP, SEXP number_of_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -107,7 +156,10 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const unsigned >::type global_genotyping_error_rates(global_genotyping_error_ratesSEXP);
     Rcpp::traits::input_parameter< const bool >::type random_allele_frequencies(random_allele_frequenciesSEXP);
     Rcpp::traits::input_parameter< const bool >::type add_unsampled_allele(add_unsampled_alleleSEXP);
-    rcpp_result_gen = Rcpp::wrap(sample_error_rates_given_paternity(phenotypes, paternity, mother, number_of_mcmc_samples, global_genotyping_error_rates, random_allele_frequencies, add_unsampled_allele));
+    Rcpp::traits::input_parameter< const bool >::type instrument(instrumentSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile_hardware(profile_hardwareSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_error_rates_given_paternity(phenotypes, paternity, mother, number_of_mcmc_samples, global_genotyping_error_rates, random_allele_frequencies, add_unsampled_allele, instrument, profile_hardware, number_of_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -139,6 +191,24 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// optimize_error_rates_given_paternity
+Rcpp::List optimize_error_rates_given_paternity(arma::ucube phenotypes, arma::uvec paternity, const unsigned mother, const bool global_genotyping_error_rates, const double starting_dropout_rate, const double starting_mistyping_rate, const unsigned max_iterations, const double convergence_tolerance);
+RcppExport SEXP _sydneyPaternity_optimize_error_rates_given_paternity(SEXP phenotypesSEXP, SEXP paternitySEXP, SEXP motherSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP starting_dropout_rateSEXP, SEXP starting_mistyping_rateSEXP, SEXP max_iterationsSEXP, SEXP convergence_toleranceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::ucube >::type phenotypes(phenotypesSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type paternity(paternitySEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type mother(motherSEXP);
+    Rcpp::traits::input_parameter< const bool >::type global_genotyping_error_rates(global_genotyping_error_ratesSEXP);
+    Rcpp::traits::input_parameter< const double >::type starting_dropout_rate(starting_dropout_rateSEXP);
+    Rcpp::traits::input_parameter< const double >::type starting_mistyping_rate(starting_mistyping_rateSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type max_iterations(max_iterationsSEXP);
+    Rcpp::traits::input_parameter< const double >::type convergence_tolerance(convergence_toleranceSEXP);
+    rcpp_result_gen = Rcpp::wrap(optimize_error_rates_given_paternity(phenotypes, paternity, mother, global_genotyping_error_rates, starting_dropout_rate, starting_mistyping_rate, max_iterations, convergence_tolerance));
+    return rcpp_result_gen;
+END_RCPP
+}
 // collapse_alleles_and_generate_prior_wrapper
 Rcpp::List collapse_alleles_and_generate_prior_wrapper(arma::ucube phenotypes, const unsigned mother, const bool add_unsampled_allele);
 RcppExport SEXP _sydneyPaternity_collapse_alleles_and_generate_prior_wrapper(SEXP phenotypesSEXP, SEXP motherSEXP, SEXP add_unsampled_alleleSEXP) {
@@ -153,8 +223,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // sample_paternity_and_error_rates_from_joint_posterior
-Rcpp::List sample_paternity_and_error_rates_from_joint_posterior(arma::ucube phenotypes, const unsigned mother, const unsigned number_of_mcmc_samples, const bool global_genotyping_error_rates, const double concentration, const bool update_error_rates, const bool update_allele_frequencies, const bool add_unsampled_allele);
-RcppExport SEXP _sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior(SEXP phenotypesSEXP, SEXP motherSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP concentrationSEXP, SEXP update_error_ratesSEXP, SEXP update_allele_frequenciesSEXP, SEXP add_unsampled_alleleSEXP) {
+Rcpp::List sample_paternity_and_error_rates_from_joint_posterior(arma::ucube phenotypes, const unsigned mother, const unsigned number_of_mcmc_samples, const bool global_genotyping_error_rates, const double concentration, const bool update_error_rates, const bool update_allele_frequencies, const bool add_unsampled_allele, const bool instrument, const bool profile_hardware);
+RcppExport SEXP _sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior(SEXP phenotypesSEXP, SEXP motherSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP concentrationSEXP, SEXP update_error_ratesSEXP, SEXP update_allele_frequenciesSEXP, SEXP add_unsampled_alleleSEXP, SEXP instrumentSEXP, SEXP profile_hardwareSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -166,7 +236,49 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const bool >::type update_error_rates(update_error_ratesSEXP);
     Rcpp::traits::input_parameter< const bool >::type update_allele_frequencies(update_allele_frequenciesSEXP);
     Rcpp::traits::input_parameter< const bool >::type add_unsampled_allele(add_unsampled_alleleSEXP);
-    rcpp_result_gen = Rcpp::wrap(sample_paternity_and_error_rates_from_joint_posterior(phenotypes, mother, number_of_mcmc_samples, global_genotyping_error_rates, concentration, update_error_rates, update_allele_frequencies, add_unsampled_allele));
+    Rcpp::traits::input_parameter< const bool >::type instrument(instrumentSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile_hardware(profile_hardwareSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_paternity_and_error_rates_from_joint_posterior(phenotypes, mother, number_of_mcmc_samples, global_genotyping_error_rates, concentration, update_error_rates, update_allele_frequencies, add_unsampled_allele, instrument, profile_hardware));
+    return rcpp_result_gen;
+END_RCPP
+}
+// screen_paternity
+Rcpp::List screen_paternity(Rcpp::List colonies, const double dropout_rate, const double mistyping_rate, const unsigned mother, const double concentration, const unsigned max_number_of_fathers, const unsigned max_iterations, const double convergence_tolerance, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_screen_paternity(SEXP coloniesSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP, SEXP motherSEXP, SEXP concentrationSEXP, SEXP max_number_of_fathersSEXP, SEXP max_iterationsSEXP, SEXP convergence_toleranceSEXP, SEXP number_of_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type colonies(coloniesSEXP);
+    Rcpp::traits::input_parameter< const double >::type dropout_rate(dropout_rateSEXP);
+    Rcpp::traits::input_parameter< const double >::type mistyping_rate(mistyping_rateSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type mother(motherSEXP);
+    Rcpp::traits::input_parameter< const double >::type concentration(concentrationSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type max_number_of_fathers(max_number_of_fathersSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type max_iterations(max_iterationsSEXP);
+    Rcpp::traits::input_parameter< const double >::type convergence_tolerance(convergence_toleranceSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(screen_paternity(colonies, dropout_rate, mistyping_rate, mother, concentration, max_number_of_fathers, max_iterations, convergence_tolerance, number_of_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// power_analysis
+Rcpp::DataFrame power_analysis(arma::uvec seeds, arma::vec error_rates, arma::uvec number_of_fathers, std::vector<arma::vec> allele_frequencies, const unsigned number_of_offspring, const double probability_of_missing_data, const unsigned number_of_mcmc_samples, const unsigned burn_in, const bool global_genotyping_error_rates, const bool update_allele_frequencies, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_power_analysis(SEXP seedsSEXP, SEXP error_ratesSEXP, SEXP number_of_fathersSEXP, SEXP allele_frequenciesSEXP, SEXP number_of_offspringSEXP, SEXP probability_of_missing_dataSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP burn_inSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP update_allele_frequenciesSEXP, SEXP number_of_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::uvec >::type seeds(seedsSEXP);
+    Rcpp::traits::input_parameter< arma::vec >::type error_rates(error_ratesSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type number_of_fathers(number_of_fathersSEXP);
+    Rcpp::traits::input_parameter< std::vector<arma::vec> >::type allele_frequencies(allele_frequenciesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_offspring(number_of_offspringSEXP);
+    Rcpp::traits::input_parameter< const double >::type probability_of_missing_data(probability_of_missing_dataSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_mcmc_samples(number_of_mcmc_samplesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type burn_in(burn_inSEXP);
+    Rcpp::traits::input_parameter< const bool >::type global_genotyping_error_rates(global_genotyping_error_ratesSEXP);
+    Rcpp::traits::input_parameter< const bool >::type update_allele_frequencies(update_allele_frequenciesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(power_analysis(seeds, error_rates, number_of_fathers, allele_frequencies, number_of_offspring, probability_of_missing_data, number_of_mcmc_samples, burn_in, global_genotyping_error_rates, update_allele_frequencies, number_of_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -256,8 +368,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // sample_parentage_and_error_rates_from_joint_posterior
-Rcpp::List sample_parentage_and_error_rates_from_joint_posterior(arma::ucube phenotypes, arma::uvec mothers, arma::uvec fathers, arma::uvec holdouts, const unsigned number_of_mcmc_samples, const unsigned burn_in_samples, const unsigned thinning_interval, const bool global_genotyping_error_rates);
-RcppExport SEXP _sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior(SEXP phenotypesSEXP, SEXP mothersSEXP, SEXP fathersSEXP, SEXP holdoutsSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP burn_in_samplesSEXP, SEXP thinning_intervalSEXP, SEXP global_genotyping_error_ratesSEXP) {
+Rcpp::List sample_parentage_and_error_rates_from_joint_posterior(arma::ucube phenotypes, arma::uvec mothers, arma::uvec fathers, arma::uvec holdouts, const unsigned number_of_mcmc_samples, const unsigned burn_in_samples, const unsigned thinning_interval, const bool global_genotyping_error_rates, const unsigned number_of_threads, const unsigned mismatch_tolerance, const unsigned candidate_refresh_interval, const bool instrument, const bool profile_hardware);
+RcppExport SEXP _sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior(SEXP phenotypesSEXP, SEXP mothersSEXP, SEXP fathersSEXP, SEXP holdoutsSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP burn_in_samplesSEXP, SEXP thinning_intervalSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP number_of_threadsSEXP, SEXP mismatch_toleranceSEXP, SEXP candidate_refresh_intervalSEXP, SEXP instrumentSEXP, SEXP profile_hardwareSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -269,7 +381,31 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const unsigned >::type burn_in_samples(burn_in_samplesSEXP);
     Rcpp::traits::input_parameter< const unsigned >::type thinning_interval(thinning_intervalSEXP);
     Rcpp::traits::input_parameter< const bool >::type global_genotyping_error_rates(global_genotyping_error_ratesSEXP);
-    rcpp_result_gen = Rcpp::wrap(sample_parentage_and_error_rates_from_joint_posterior(phenotypes, mothers, fathers, holdouts, number_of_mcmc_samples, burn_in_samples, thinning_interval, global_genotyping_error_rates));
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type mismatch_tolerance(mismatch_toleranceSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type candidate_refresh_interval(candidate_refresh_intervalSEXP);
+    Rcpp::traits::input_parameter< const bool >::type instrument(instrumentSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile_hardware(profile_hardwareSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_parentage_and_error_rates_from_joint_posterior(phenotypes, mothers, fathers, holdouts, number_of_mcmc_samples, burn_in_samples, thinning_interval, global_genotyping_error_rates, number_of_threads, mismatch_tolerance, candidate_refresh_interval, instrument, profile_hardware));
+    return rcpp_result_gen;
+END_RCPP
+}
+// cross_validate_number_of_parents
+Rcpp::List cross_validate_number_of_parents(arma::ucube phenotypes, arma::uvec mothers, arma::uvec fathers, const unsigned number_of_folds, const unsigned number_of_mcmc_samples, const unsigned burn_in_samples, const unsigned thinning_interval, const bool global_genotyping_error_rates, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_cross_validate_number_of_parents(SEXP phenotypesSEXP, SEXP mothersSEXP, SEXP fathersSEXP, SEXP number_of_foldsSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP burn_in_samplesSEXP, SEXP thinning_intervalSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP number_of_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::ucube >::type phenotypes(phenotypesSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type mothers(mothersSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type fathers(fathersSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_folds(number_of_foldsSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_mcmc_samples(number_of_mcmc_samplesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type burn_in_samples(burn_in_samplesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type thinning_interval(thinning_intervalSEXP);
+    Rcpp::traits::input_parameter< const bool >::type global_genotyping_error_rates(global_genotyping_error_ratesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(cross_validate_number_of_parents(phenotypes, mothers, fathers, number_of_folds, number_of_mcmc_samples, burn_in_samples, thinning_interval, global_genotyping_error_rates, number_of_threads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -294,8 +430,8 @@ BEGIN_RCPP
 END_RCPP
 }
 // sample_parentage_and_error_rates
-Rcpp::List sample_parentage_and_error_rates(arma::ucube phenotypes, arma::uvec maternity, const unsigned mother, const unsigned burn_in, const unsigned thinning_interval, const unsigned number_of_mcmc_samples, const bool global_genotyping_error_rates, const bool update_error_rates, const bool update_allele_frequencies, const double concentration, const double lambda_mother, const double lambda_father, const double starting_dropout_rate, const double starting_mistyping_rate);
-RcppExport SEXP _sydneyPaternity_sample_parentage_and_error_rates(SEXP phenotypesSEXP, SEXP maternitySEXP, SEXP motherSEXP, SEXP burn_inSEXP, SEXP thinning_intervalSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP update_error_ratesSEXP, SEXP update_allele_frequenciesSEXP, SEXP concentrationSEXP, SEXP lambda_motherSEXP, SEXP lambda_fatherSEXP, SEXP starting_dropout_rateSEXP, SEXP starting_mistyping_rateSEXP) {
+Rcpp::List sample_parentage_and_error_rates(arma::ucube phenotypes, arma::uvec maternity, const unsigned mother, const unsigned burn_in, const unsigned thinning_interval, const unsigned number_of_mcmc_samples, const bool global_genotyping_error_rates, const bool update_error_rates, const bool update_allele_frequencies, const double concentration, const double lambda_mother, const double lambda_father, const double starting_dropout_rate, const double starting_mistyping_rate, const bool instrument, const bool profile_hardware, const std::string checkpoint_file, const unsigned checkpoint_interval, const bool compress_traces, const bool linear_space_likelihood, const bool single_precision_likelihood, const double genotype_pruning_threshold, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_sample_parentage_and_error_rates(SEXP phenotypesSEXP, SEXP maternitySEXP, SEXP motherSEXP, SEXP burn_inSEXP, SEXP thinning_intervalSEXP, SEXP number_of_mcmc_samplesSEXP, SEXP global_genotyping_error_ratesSEXP, SEXP update_error_ratesSEXP, SEXP update_allele_frequenciesSEXP, SEXP concentrationSEXP, SEXP lambda_motherSEXP, SEXP lambda_fatherSEXP, SEXP starting_dropout_rateSEXP, SEXP starting_mistyping_rateSEXP, SEXP instrumentSEXP, SEXP profile_hardwareSEXP, SEXP checkpoint_fileSEXP, SEXP checkpoint_intervalSEXP, SEXP compress_tracesSEXP, SEXP linear_space_likelihoodSEXP, SEXP single_precision_likelihoodSEXP, SEXP genotype_pruning_thresholdSEXP, SEXP number_of_threadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -313,7 +449,86 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< const double >::type lambda_father(lambda_fatherSEXP);
     Rcpp::traits::input_parameter< const double >::type starting_dropout_rate(starting_dropout_rateSEXP);
     Rcpp::traits::input_parameter< const double >::type starting_mistyping_rate(starting_mistyping_rateSEXP);
-    rcpp_result_gen = Rcpp::wrap(sample_parentage_and_error_rates(phenotypes, maternity, mother, burn_in, thinning_interval, number_of_mcmc_samples, global_genotyping_error_rates, update_error_rates, update_allele_frequencies, concentration, lambda_mother, lambda_father, starting_dropout_rate, starting_mistyping_rate));
+    Rcpp::traits::input_parameter< const bool >::type instrument(instrumentSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile_hardware(profile_hardwareSEXP);
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint_file(checkpoint_fileSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type checkpoint_interval(checkpoint_intervalSEXP);
+    Rcpp::traits::input_parameter< const bool >::type compress_traces(compress_tracesSEXP);
+    Rcpp::traits::input_parameter< const bool >::type linear_space_likelihood(linear_space_likelihoodSEXP);
+    Rcpp::traits::input_parameter< const bool >::type single_precision_likelihood(single_precision_likelihoodSEXP);
+    Rcpp::traits::input_parameter< const double >::type genotype_pruning_threshold(genotype_pruning_thresholdSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_parentage_and_error_rates(phenotypes, maternity, mother, burn_in, thinning_interval, number_of_mcmc_samples, global_genotyping_error_rates, update_error_rates, update_allele_frequencies, concentration, lambda_mother, lambda_father, starting_dropout_rate, starting_mistyping_rate, instrument, profile_hardware, checkpoint_file, checkpoint_interval, compress_traces, linear_space_likelihood, single_precision_likelihood, genotype_pruning_threshold, number_of_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// resume_parentage_and_error_rates
+Rcpp::List resume_parentage_and_error_rates(const std::string checkpoint_file, const unsigned checkpoint_interval, const bool instrument, const bool profile_hardware, const unsigned number_of_threads);
+RcppExport SEXP _sydneyPaternity_resume_parentage_and_error_rates(SEXP checkpoint_fileSEXP, SEXP checkpoint_intervalSEXP, SEXP instrumentSEXP, SEXP profile_hardwareSEXP, SEXP number_of_threadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const std::string >::type checkpoint_file(checkpoint_fileSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type checkpoint_interval(checkpoint_intervalSEXP);
+    Rcpp::traits::input_parameter< const bool >::type instrument(instrumentSEXP);
+    Rcpp::traits::input_parameter< const bool >::type profile_hardware(profile_hardwareSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_threads(number_of_threadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(resume_parentage_and_error_rates(checkpoint_file, checkpoint_interval, instrument, profile_hardware, number_of_threads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// encode_parentage_trace
+Rcpp::List encode_parentage_trace(Rcpp::IntegerMatrix labels, const unsigned mother, const unsigned keyframe_interval, const unsigned fixed_labels);
+RcppExport SEXP _sydneyPaternity_encode_parentage_trace(SEXP labelsSEXP, SEXP motherSEXP, SEXP keyframe_intervalSEXP, SEXP fixed_labelsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::IntegerMatrix >::type labels(labelsSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type mother(motherSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type keyframe_interval(keyframe_intervalSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type fixed_labels(fixed_labelsSEXP);
+    rcpp_result_gen = Rcpp::wrap(encode_parentage_trace(labels, mother, keyframe_interval, fixed_labels));
+    return rcpp_result_gen;
+END_RCPP
+}
+// decode_parentage_trace
+Rcpp::IntegerMatrix decode_parentage_trace(Rcpp::List trace);
+RcppExport SEXP _sydneyPaternity_decode_parentage_trace(SEXP traceSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< Rcpp::List >::type trace(traceSEXP);
+    rcpp_result_gen = Rcpp::wrap(decode_parentage_trace(trace));
+    return rcpp_result_gen;
+END_RCPP
+}
+// benchmark_likelihood_kernels
+Rcpp::List benchmark_likelihood_kernels(arma::ucube phenotypes, arma::uvec paternity, arma::uvec maternity, const unsigned mother, const unsigned number_of_repetitions, const double dropout_rate, const double mistyping_rate);
+RcppExport SEXP _sydneyPaternity_benchmark_likelihood_kernels(SEXP phenotypesSEXP, SEXP paternitySEXP, SEXP maternitySEXP, SEXP motherSEXP, SEXP number_of_repetitionsSEXP, SEXP dropout_rateSEXP, SEXP mistyping_rateSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< arma::ucube >::type phenotypes(phenotypesSEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type paternity(paternitySEXP);
+    Rcpp::traits::input_parameter< arma::uvec >::type maternity(maternitySEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type mother(motherSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_repetitions(number_of_repetitionsSEXP);
+    Rcpp::traits::input_parameter< const double >::type dropout_rate(dropout_rateSEXP);
+    Rcpp::traits::input_parameter< const double >::type mistyping_rate(mistyping_rateSEXP);
+    rcpp_result_gen = Rcpp::wrap(benchmark_likelihood_kernels(phenotypes, paternity, maternity, mother, number_of_repetitions, dropout_rate, mistyping_rate));
+    return rcpp_result_gen;
+END_RCPP
+}
+// benchmark_sampling_primitives
+Rcpp::List benchmark_sampling_primitives(const unsigned number_of_categories, const unsigned number_of_draws, const unsigned number_of_repetitions);
+RcppExport SEXP _sydneyPaternity_benchmark_sampling_primitives(SEXP number_of_categoriesSEXP, SEXP number_of_drawsSEXP, SEXP number_of_repetitionsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_categories(number_of_categoriesSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_draws(number_of_drawsSEXP);
+    Rcpp::traits::input_parameter< const unsigned >::type number_of_repetitions(number_of_repetitionsSEXP);
+    rcpp_result_gen = Rcpp::wrap(benchmark_sampling_primitives(number_of_categories, number_of_draws, number_of_repetitions));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -322,23 +537,35 @@ static const R_CallMethodDef CallEntries[] = {
     {"_sydneyPaternity_log_ascending_factorial", (DL_FUNC) &_sydneyPaternity_log_ascending_factorial, 2},
     {"_sydneyPaternity_log_descending_factorial", (DL_FUNC) &_sydneyPaternity_log_descending_factorial, 2},
     {"_sydneyPaternity_log_uniform_MFM_prior", (DL_FUNC) &_sydneyPaternity_log_uniform_MFM_prior, 4},
+    {"_sydneyPaternity_log_uniform_MFM_coefficients", (DL_FUNC) &_sydneyPaternity_log_uniform_MFM_coefficients, 3},
     {"_sydneyPaternity_genotyping_error_model", (DL_FUNC) &_sydneyPaternity_genotyping_error_model, 6},
     {"_sydneyPaternity_genotyping_error_model_class", (DL_FUNC) &_sydneyPaternity_genotyping_error_model_class, 3},
+    {"_sydneyPaternity_genotyping_error_model_derivatives", (DL_FUNC) &_sydneyPaternity_genotyping_error_model_derivatives, 6},
     {"_sydneyPaternity_simulate_genotyping_errors", (DL_FUNC) &_sydneyPaternity_simulate_genotyping_errors, 6},
-    {"_sydneyPaternity_sample_error_rates_given_paternity", (DL_FUNC) &_sydneyPaternity_sample_error_rates_given_paternity, 7},
+    {"_sydneyPaternity_simulate_colonies", (DL_FUNC) &_sydneyPaternity_simulate_colonies, 10},
+    {"_sydneyPaternity_sample_error_rates_given_paternity", (DL_FUNC) &_sydneyPaternity_sample_error_rates_given_paternity, 10},
     {"_sydneyPaternity_optimize_paternity_given_error_rates", (DL_FUNC) &_sydneyPaternity_optimize_paternity_given_error_rates, 4},
     {"_sydneyPaternity_loglikelihood_of_error_rates_given_paternity", (DL_FUNC) &_sydneyPaternity_loglikelihood_of_error_rates_given_paternity, 4},
+    {"_sydneyPaternity_optimize_error_rates_given_paternity", (DL_FUNC) &_sydneyPaternity_optimize_error_rates_given_paternity, 8},
     {"_sydneyPaternity_collapse_alleles_and_generate_prior_wrapper", (DL_FUNC) &_sydneyPaternity_collapse_alleles_and_generate_prior_wrapper, 3},
-    {"_sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior", (DL_FUNC) &_sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior, 8},
+    {"_sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior", (DL_FUNC) &_sydneyPaternity_sample_paternity_and_error_rates_from_joint_posterior, 10},
+    {"_sydneyPaternity_screen_paternity", (DL_FUNC) &_sydneyPaternity_screen_paternity, 9},
+    {"_sydneyPaternity_power_analysis", (DL_FUNC) &_sydneyPaternity_power_analysis, 11},
     {"_sydneyPaternity_sample_matrix", (DL_FUNC) &_sydneyPaternity_sample_matrix, 1},
     {"_sydneyPaternity_select_columns_from_cube", (DL_FUNC) &_sydneyPaternity_select_columns_from_cube, 2},
     {"_sydneyPaternity_phenotype_error_model", (DL_FUNC) &_sydneyPaternity_phenotype_error_model, 5},
     {"_sydneyPaternity_sample_phenotype_errors", (DL_FUNC) &_sydneyPaternity_sample_phenotype_errors, 5},
     {"_sydneyPaternity_mendelian_genotype_model", (DL_FUNC) &_sydneyPaternity_mendelian_genotype_model, 6},
     {"_sydneyPaternity_sample_mendelian_genotype", (DL_FUNC) &_sydneyPaternity_sample_mendelian_genotype, 6},
-    {"_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior", (DL_FUNC) &_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior, 8},
+    {"_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior", (DL_FUNC) &_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior, 13},
+    {"_sydneyPaternity_cross_validate_number_of_parents", (DL_FUNC) &_sydneyPaternity_cross_validate_number_of_parents, 9},
     {"_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior_alt", (DL_FUNC) &_sydneyPaternity_sample_parentage_and_error_rates_from_joint_posterior_alt, 10},
-    {"_sydneyPaternity_sample_parentage_and_error_rates", (DL_FUNC) &_sydneyPaternity_sample_parentage_and_error_rates, 14},
+    {"_sydneyPaternity_sample_parentage_and_error_rates", (DL_FUNC) &_sydneyPaternity_sample_parentage_and_error_rates, 23},
+    {"_sydneyPaternity_resume_parentage_and_error_rates", (DL_FUNC) &_sydneyPaternity_resume_parentage_and_error_rates, 5},
+    {"_sydneyPaternity_encode_parentage_trace", (DL_FUNC) &_sydneyPaternity_encode_parentage_trace, 4},
+    {"_sydneyPaternity_decode_parentage_trace", (DL_FUNC) &_sydneyPaternity_decode_parentage_trace, 1},
+    {"_sydneyPaternity_benchmark_likelihood_kernels", (DL_FUNC) &_sydneyPaternity_benchmark_likelihood_kernels, 7},
+    {"_sydneyPaternity_benchmark_sampling_primitives", (DL_FUNC) &_sydneyPaternity_benchmark_sampling_primitives, 3},
     {NULL, NULL, 0}
 };
 
@@ -2,10 +2,37 @@
 #include <RcppArmadilloExtensions/sample.h>
 #include <vector>
 #include <tuple>
+#include <chrono>
+#include <stdexcept>
+#include <exception>
+#include <string>
+#include "random.h"
+#include "profiling.h"
+#include <sydneyPaternity/parentage.h>
+#include <sydneyPaternity/genotype_counts.h>
+#include <sydneyPaternity/allele_buckets.h>
+#include <sydneyPaternity/exclusion.h>
+#include <sydneyPaternity/mendelian.h>
+#include <sydneyPaternity/sampling.h>
+#include <sydneyPaternity/mfm.h>
+#include <sydneyPaternity/variational.h>
+#include <sydneyPaternity/parallel.h>
 
 // [[Rcpp::plugins("cpp11")]]
 // [[Rcpp::depends("RcppArmadillo")]]
 
+using sydneyPaternity::recode_to_contiguous_integers;
+using sydneyPaternity::collapse_alleles_and_generate_genotype_prior;
+using sydneyPaternity::unique_alleles;
+using sydneyPaternity::simulate_genotyping_errors;
+using sydneyPaternity::parentage_loglikelihood_by_locus;
+using sydneyPaternity::paternity_loglikelihood_by_locus;
+using sydneyPaternity::parentage_loglikelihood_by_locus_scaled;
+using sydneyPaternity::parentage_loglikelihood_by_locus_single_precision;
+using sydneyPaternity::paternity_likelihood_kernel;
+using sydneyPaternity::select_paternity_likelihood_kernels;
+using sydneyPaternity::run_parallel_tasks;
+
 // [[Rcpp::export]]
 double log_ascending_factorial (const double x, const unsigned r)
 {
@@ -42,59 +69,20 @@ double log_uniform_MFM_prior (const unsigned n, const unsigned t, const double g
   return log(out) + running_maximum;
 }
 
-arma::umat recode_to_contiguous_integers (arma::umat input)
+// [[Rcpp::export]]
+arma::vec log_uniform_MFM_coefficients (const unsigned n, const double gamma, const unsigned max_number_of_components)
 {
-  arma::uvec uniq = arma::unique(input);
-  for(unsigned i=0; i<uniq.n_elem; ++i) input.replace(uniq.at(i), i);
-  return input;
+  // log_uniform_MFM_prior for t = 1..n, as tabulated for the samplers (which cache it for K = n)
+  if (n < 1) Rcpp::stop("need at least one observation");
+  if (gamma <= 0.) Rcpp::stop("MFM concentration must be positive");
+  if (max_number_of_components < 1) Rcpp::stop("need at least one component");
+  return sydneyPaternity::log_uniform_mfm_coefficients(n, gamma, max_number_of_components);
 }
 
 arma::uword sample (const arma::vec& pvec) 
 {
-  arma::uword K = pvec.n_elem;
-  arma::uvec opts = arma::linspace<arma::uvec>(0L, K - 1L, K);
-  return arma::conv_to<arma::uword>::from(
-      Rcpp::RcppArmadillo::sample(opts, 1L, true, pvec)
-  );
-}
-
-std::vector<arma::vec> collapse_alleles_and_generate_genotype_prior
- (arma::ucube& phenotypes, 
-  const bool add_unsampled_allele = false)
-{
-  // recode alleles into 1-based contiguous integers and return allele frequency prior
-  
-  const unsigned num_loci = phenotypes.n_slices;
-  std::vector<arma::vec> allele_frequencies;
-
-  for (unsigned locus=0; locus<num_loci; ++locus)
-  {
-    arma::uvec alleles = arma::unique(arma::nonzeros(phenotypes.slice(locus)));
-    for (int i=1; i<=alleles.n_elem; ++i)
-    {
-      phenotypes.slice(locus).replace(alleles.at(i-1), i);
-    }
-    unsigned number_of_alleles = alleles.n_elem + int(add_unsampled_allele);
-    arma::vec frequencies (number_of_alleles); 
-    frequencies.fill(1./double(number_of_alleles));
-    allele_frequencies.push_back(frequencies); 
-  }
-  return allele_frequencies;
-}
-
-std::vector<arma::uvec> unique_alleles
- (const arma::ucube& phenotypes, 
-  const bool add_unsampled_allele = false)
-{
-  const unsigned num_loci = phenotypes.n_slices;
-  std::vector<arma::uvec> allele_names;
-  for (unsigned locus=0; locus<num_loci; ++locus)
-  {
-    arma::uvec alleles = arma::unique(arma::nonzeros(phenotypes.slice(locus)));
-    if (add_unsampled_allele) alleles = arma::join_vert(alleles, arma::uvec({999}));
-    allele_names.push_back(alleles);
-  }
-  return allele_names;
+  R_random_number_generator rng;
+  return rng.categorical(pvec);
 }
 
 // [[Rcpp::export]]
@@ -106,44 +94,7 @@ double genotyping_error_model
   const double& dropout_rate, 
   const double& mistyping_rate)
 {
-  // from Eqs 1 & 2 in Wang 2004 Genetics
-  const double e1 = dropout_rate;
-  const double e2 = mistyping_rate/double(number_of_alleles-1);
-  const double E2 = mistyping_rate;
-
-  const arma::uvec genotype = {genotype0, genotype1};
-  const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
-  const bool genotype_is_homozygous = genotype[0] == genotype[1];
-
-  if (number_of_alleles == 1) return 1.; //monomorphic loci
-
-  if (genotype_is_homozygous) 
-  {
-    if (phenotype_is_homozygous && phenotype[0] == genotype[0])
-    {
-      return std::pow(1.-E2, 2);
-    } else if ((phenotype[0] == genotype[0] && phenotype[1] != genotype[0]) || 
-               (phenotype[0] != genotype[0] && phenotype[1] == genotype[0]) ){
-      return 2.*e2*(1-E2);
-    } else if (phenotype[0] != genotype[0] && phenotype[1] != genotype[0]) {
-      return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
-    }  
-  } else {
-    if ( (phenotype[0] == genotype[0] && phenotype[1] == genotype[1]) ||
-         (phenotype[1] == genotype[0] && phenotype[0] == genotype[1]) )
-    {
-      return std::pow(1.-E2, 2) + std::pow(e2, 2) - 2.*e1*std::pow(1.-E2-e2, 2);
-    } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
-      return e2*(1.-E2) + e1*std::pow(1.-E2-e2, 2);
-    } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
-               phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
-      return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
-    } else {
-      // Wang 2018 has (1-E2-e2) and Wang 2004 has (1-E2+e2), latter is correct
-      return e2*(1.-E2+e2);
-    }
-  }
-  return 0.;
+  return sydneyPaternity::genotyping_error_model(phenotype, genotype0, genotype1, number_of_alleles, dropout_rate, mistyping_rate);
 }
 
 // [[Rcpp::export]]
@@ -185,6 +136,121 @@ int genotyping_error_model_class
   return 0;
 }
 
+double genotyping_error_model_given_class
+ (const int error_class,
+  const bool phenotype_is_homozygous,
+  const unsigned number_of_alleles,
+  const double dropout_rate,
+  const double mistyping_rate)
+{
+  // genotyping_error_model, given the class of phenotype and genotype from genotyping_error_model_class; 
+  // class 0 is used for a missing phenotype, with probability 1
+  if (number_of_alleles == 1) return 1.; //monomorphic loci
+
+  const double e1 = dropout_rate;
+  const double e2 = mistyping_rate/double(number_of_alleles-1);
+  const double E2 = mistyping_rate;
+
+  switch (error_class)
+  {
+    case 1: return std::pow(1.-E2, 2);
+    case 2: return 2.*e2*(1-E2);
+    case 3: 
+    case 6: return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
+    case 4: return std::pow(1.-E2, 2) + std::pow(e2, 2) - 2.*e1*std::pow(1.-E2-e2, 2);
+    case 5: return e2*(1.-E2) + e1*std::pow(1.-E2-e2, 2);
+    case 7: return e2*(1.-E2+e2);
+  }
+  return 1.;
+}
+
+arma::cube genotyping_error_model_class_table
+ (const arma::uvec& number_of_alleles,
+  const arma::vec& dropout_rate,
+  const arma::vec& mistyping_rate)
+{
+  // genotyping_error_model_given_class by class (0-7), phenotype homozygosity, locus
+  arma::cube error_probability (8, 2, number_of_alleles.n_elem);
+  for (unsigned locus=0; locus<number_of_alleles.n_elem; ++locus)
+  {
+    for (unsigned homozygous=0; homozygous<2; ++homozygous)
+    {
+      for (unsigned error_class=0; error_class<8; ++error_class)
+      {
+        error_probability.at(error_class, homozygous, locus) = genotyping_error_model_given_class(error_class, 
+            homozygous, number_of_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+      }
+    }
+  }
+  return error_probability;
+}
+
+// [[Rcpp::export]]
+arma::vec genotyping_error_model_derivatives
+ (const arma::uvec& phenotype,
+  const unsigned& genotype0,
+  const unsigned& genotype1,
+  const unsigned& number_of_alleles,
+  const double& dropout_rate,
+  const double& mistyping_rate)
+{
+  // value and derivatives of genotyping_error_model with respect to (dropout_rate, mistyping_rate), as
+  // {f, df/de1, df/dE2, d2f/de1de1, d2f/de1dE2, d2f/dE2dE2}; each class is a polynomial in e1 and E2 = e2*(k-1)
+  arma::vec out (6, arma::fill::zeros);
+  if (number_of_alleles == 1) //monomorphic loci
+  {
+    out[0] = 1.;
+    return out;
+  }
+
+  const double e1 = dropout_rate;
+  const double k = 1./double(number_of_alleles-1); //de2/dE2
+  const double e2 = mistyping_rate*k;
+  const double E2 = mistyping_rate;
+  const double g = 1.-E2-e2; //dg/dE2 = -(1+k)
+  const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
+
+  switch (genotyping_error_model_class(phenotype, genotype0, genotype1))
+  {
+    case 1:
+      out[0] = std::pow(1.-E2, 2);
+      out[2] = -2.*(1.-E2);
+      out[5] = 2.;
+      break;
+    case 2:
+      out[0] = 2.*e2*(1.-E2);
+      out[2] = 2.*k*(1.-2.*E2);
+      out[5] = -4.*k;
+      break;
+    case 3:
+    case 6:
+      out[0] = (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
+      out[2] = (2.-int(phenotype_is_homozygous))*2.*k*e2;
+      out[5] = (2.-int(phenotype_is_homozygous))*2.*k*k;
+      break;
+    case 4:
+      out[0] = std::pow(1.-E2, 2) + std::pow(e2, 2) - 2.*e1*std::pow(g, 2);
+      out[1] = -2.*std::pow(g, 2);
+      out[2] = -2.*(1.-E2) + 2.*k*e2 + 4.*e1*(1.+k)*g;
+      out[4] = 4.*(1.+k)*g;
+      out[5] = 2. + 2.*k*k - 4.*e1*std::pow(1.+k, 2);
+      break;
+    case 5:
+      out[0] = e2*(1.-E2) + e1*std::pow(g, 2);
+      out[1] = std::pow(g, 2);
+      out[2] = k*(1.-2.*E2) - 2.*e1*(1.+k)*g;
+      out[4] = -2.*(1.+k)*g;
+      out[5] = -2.*k + 2.*e1*std::pow(1.+k, 2);
+      break;
+    case 7:
+      out[0] = e2*(1.-E2+e2);
+      out[2] = k*(1.-E2+e2) - e2*(1.-k);
+      out[5] = -2.*k*(1.-k);
+      break;
+  }
+  return out;
+}
+
 // [[Rcpp::export]]
 arma::uvec simulate_genotyping_errors
  (const arma::uvec& phenotype,
@@ -194,82 +260,256 @@ arma::uvec simulate_genotyping_errors
   const double& dropout_rate, 
   const double& mistyping_rate)
 {
-  const double e1 = dropout_rate;
-  const double e2 = mistyping_rate/double(number_of_alleles-1);
-  const double E2 = mistyping_rate;
+  R_random_number_generator rng;
+  return simulate_genotyping_errors(phenotype, genotype0, genotype1, number_of_alleles, dropout_rate, mistyping_rate, rng);
+}
 
-  const arma::uvec genotype = {genotype0, genotype1};
-  const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
-  const bool genotype_is_homozygous = genotype[0] == genotype[1];
+arma::uvec simulate_phenotype
+ (random_number_generator& rng,
+  arma::uvec genotype,
+  const unsigned number_of_alleles,
+  const double dropout_rate,
+  const double mistyping_rate,
+  arma::uvec& errors)
+{
+  // error process from Wang 2004 Genetics, as in the R simulators: dropout (heterozygotes only) then
+  // independent mistyping of each allele to one of the other alleles
+  if (genotype.n_elem == 2 && genotype[0] != genotype[1] && rng.uniform() < 2.*dropout_rate)
+  {
+    genotype.fill(genotype[rng.integer(2)]);
+    errors[0]++;
+  }
+  if (number_of_alleles > 1)
+  {
+    for (unsigned i=0; i<genotype.n_elem; ++i)
+    {
+      if (rng.uniform() < mistyping_rate)
+      {
+        unsigned allele = 1 + rng.integer(number_of_alleles - 1);
+        genotype[i] = allele >= genotype[i] ? allele + 1 : allele;
+        errors[1]++;
+      }
+    }
+  }
+  return genotype;
+}
 
-  if (number_of_alleles == 1) return arma::uvec({0,0}); //monomorphic loci
+struct simulated_colony
+{
+  arma::ucube phenotypes; //2 x (sampled mothers + offspring) x loci, 0 is missing
+  arma::ucube genotypes; //true genotypes, same layout as phenotypes
+  arma::ucube maternal_genotypes; //2 x mothers x loci
+  arma::umat paternal_genotypes; //fathers x loci
+  arma::umat paternal_phenotypes; //fathers x loci, 0 is missing
+  arma::uvec maternity; //1-based, for offspring
+  arma::uvec paternity; //1-based, for offspring
+  arma::uvec errors; //dropouts, mistypes in sampled mothers and offspring
+};
+
+simulated_colony simulate_colony
+ (random_number_generator& rng,
+  const arma::mat& offspring_per_mating,
+  const std::vector<arma::vec>& allele_frequencies,
+  const arma::vec& dropout_rate,
+  const arma::vec& mistyping_rate,
+  const double probability_of_missing_data,
+  const unsigned number_of_offspring,
+  const unsigned number_of_sampled_mothers,
+  const arma::ucube& fixed_maternal_genotypes = arma::ucube(),
+  const arma::umat& fixed_paternal_genotypes = arma::umat())
+{
+  // "offspring_per_mating" is fathers x mothers. If "number_of_offspring" is zero it contains the number of
+  // offspring from each mating, otherwise offspring are assigned to matings in proportion to its entries.
+  // Alleles are 1-based indices into "allele_frequencies". Parental genotypes are drawn under hwe unless 
+  // "fixed_maternal_genotypes" (2 x mothers x loci) or "fixed_paternal_genotypes" (fathers x loci) are given
+  const unsigned number_of_fathers = offspring_per_mating.n_rows;
+  const unsigned number_of_mothers = offspring_per_mating.n_cols;
+  const unsigned number_of_loci = allele_frequencies.size();
 
-  if (genotype_is_homozygous) 
+  // offspring per mating
+  arma::umat mating_counts (number_of_fathers, number_of_mothers, arma::fill::zeros);
+  if (number_of_offspring == 0)
   {
-    if (phenotype_is_homozygous && phenotype[0] == genotype[0])
-    {
-      return arma::uvec({0, 0});
-    } else if ((phenotype[0] == genotype[0] && phenotype[1] != genotype[0]) || 
-               (phenotype[0] != genotype[0] && phenotype[1] == genotype[0]) ){
-      return arma::uvec({0, 1});
-    } else if (phenotype[0] != genotype[0] && phenotype[1] != genotype[0]) {
-      return arma::uvec({0, 2});
-    }  
+    mating_counts = arma::conv_to<arma::umat>::from(arma::round(offspring_per_mating));
   } else {
-    if ( (phenotype[0] == genotype[0] && phenotype[1] == genotype[1]) ||
-         (phenotype[1] == genotype[0] && phenotype[0] == genotype[1]) )
+    const arma::vec proportions = arma::vectorise(offspring_per_mating);
+    for (unsigned sib=0; sib<number_of_offspring; ++sib)
     {
-      // either: no errors occurred OR 
-      //         there was no dropout error but two typing errors
-      //         there was a dropout error that got fixed by single typing error
-      // prop.table(c((1-2*e1)*(1-E2)^2, (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)))
-      // sum(c((1-2*e1)*(1-E2)^2, (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)))
-      // (1-E2)^2 + e2^2 - 2*e1*(1-E2-e2)^2
-      // [0,0] [0,2] [1,1]
-      const arma::vec probs = {(1-2*e1)*(1-E2)*(1-E2), (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)};
-      const arma::umat counts = {{0,0},{0,2},{1,1}};
-      return counts.row(sample(probs)).t();
-    } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
-      // one class 2 error OR there was a dropout error and no typing errors
-      // prop.table(c(e1*(1-E2)^2, (1-2*e1)*e2*(1-E2), e1*e2*e2))
-      // sum(c(e1*(1-E2)^2, (1-2*e1)*e2*(1-E2), e1*e2*e2))
-      // e2*(1-E2) + e1*(1-E2-e2)^2
-      // [0 1] [1 0] [1 2]
-      const arma::vec probs = {e1*(1-E2)*(1-E2), (1-2*e1)*e2*(1-E2), e1*e2*e2};
-      const arma::umat counts = {{1,0},{0,1},{1,2}};
-      return counts.row(sample(probs)).t();
-    } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
-               phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
-      // two class 2 errors occurred, regardless of whether class 1 error occurs
-      // prop.table(c( (1-2*e1)*e2*e2 , 2*e1*e2*e2 ))
-      // [0 2] [1 2]
-      const arma::vec probs = {(1-2*e1)*e2*e2, 2*e1*e2*e2};
-      const arma::umat counts = {{0,2},{1,2}};
-      return counts.row(sample(probs)).t();
+      mating_counts[rng.categorical(proportions)]++;
+    }
+  }
+  const unsigned total_offspring = arma::accu(mating_counts);
+
+  simulated_colony colony;
+  colony.maternity.set_size(total_offspring);
+  colony.paternity.set_size(total_offspring);
+  unsigned sib = 0;
+  for (unsigned mother=0; mother<number_of_mothers; ++mother)
+  {
+    for (unsigned father=0; father<number_of_fathers; ++father)
+    {
+      for (unsigned i=0; i<mating_counts.at(father,mother); ++i)
+      {
+        colony.maternity[sib] = mother + 1;
+        colony.paternity[sib] = father + 1;
+        sib++;
+      }
+    }
+  }
+
+  const unsigned number_of_samples = number_of_sampled_mothers + total_offspring;
+  colony.phenotypes.zeros(2, number_of_samples, number_of_loci);
+  colony.genotypes.zeros(2, number_of_samples, number_of_loci);
+  colony.maternal_genotypes.zeros(2, number_of_mothers, number_of_loci);
+  colony.paternal_genotypes.zeros(number_of_fathers, number_of_loci);
+  colony.paternal_phenotypes.zeros(number_of_fathers, number_of_loci);
+  colony.errors.zeros(2);
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    const unsigned number_of_alleles = allele_frequencies[locus].n_elem;
+
+    // parental genotypes under hwe, or fixed
+    if (fixed_maternal_genotypes.is_empty())
+    {
+      for (unsigned mother=0; mother<number_of_mothers; ++mother)
+      {
+        colony.maternal_genotypes.at(0,mother,locus) = 1 + rng.categorical(allele_frequencies[locus]);
+        colony.maternal_genotypes.at(1,mother,locus) = 1 + rng.categorical(allele_frequencies[locus]);
+      }
+    } else {
+      colony.maternal_genotypes.slice(locus) = fixed_maternal_genotypes.slice(locus);
+    }
+    if (fixed_paternal_genotypes.is_empty())
+    {
+      for (unsigned father=0; father<number_of_fathers; ++father)
+      {
+        colony.paternal_genotypes.at(father,locus) = 1 + rng.categorical(allele_frequencies[locus]);
+      }
     } else {
-      // "otherwise" ... there's one match but phenotype is heterozygous?
-      // 1. could have: sequencing error at one, no sequencing error at other
-      // 2. sequencing error gets fixed by second sequencing error
-      // dropout could happen in either case
-      // prop.table(c( (1-2*e1)*e2*(1-E2), (1-2*e1)*e2*e2, 2*e1*e2*(1-E2), 2*e1*e2*e2 ))
-      // [0 1] [0 2] [1 1] [1 2]
-      const arma::vec probs = {(1-2*e1)*e2*(1-E2), (1-2*e1)*e2*e2, 2*e1*e2*(1-E2), 2*e1*e2*e2};
-      const arma::umat counts = {{0,1},{0,2},{1,1},{1,2}};
-      return counts.row(sample(probs)).t();
-    }
-  }
-  return arma::uvec{{0,0}};
+      colony.paternal_genotypes.col(locus) = fixed_paternal_genotypes.col(locus);
+    }
+
+    // true genotypes of samples: sampled mothers, then offspring (maternal allele first)
+    for (unsigned mother=0; mother<number_of_sampled_mothers; ++mother)
+    {
+      colony.genotypes.slice(locus).col(mother) = colony.maternal_genotypes.slice(locus).col(mother);
+    }
+    for (sib=0; sib<total_offspring; ++sib)
+    {
+      colony.genotypes.at(0,number_of_sampled_mothers+sib,locus) =
+        colony.maternal_genotypes.at(rng.integer(2),colony.maternity[sib]-1,locus);
+      colony.genotypes.at(1,number_of_sampled_mothers+sib,locus) =
+        colony.paternal_genotypes.at(colony.paternity[sib]-1,locus);
+    }
+
+    // genotyping errors and missing data
+    for (unsigned individual=0; individual<number_of_samples; ++individual)
+    {
+      if (rng.uniform() < probability_of_missing_data) continue;
+      colony.phenotypes.slice(locus).col(individual) =
+        simulate_phenotype(rng, colony.genotypes.slice(locus).col(individual), number_of_alleles,
+            dropout_rate[locus], mistyping_rate[locus], colony.errors);
+    }
+    arma::uvec paternal_errors (2, arma::fill::zeros); //not counted, as fathers are not sampled
+    for (unsigned father=0; father<number_of_fathers; ++father)
+    {
+      if (rng.uniform() < probability_of_missing_data) continue;
+      colony.paternal_phenotypes.at(father,locus) = arma::as_scalar(
+        simulate_phenotype(rng, arma::uvec({colony.paternal_genotypes.at(father,locus)}), number_of_alleles,
+            dropout_rate[locus], mistyping_rate[locus], paternal_errors));
+    }
+  }
+  return colony;
+}
+
+// [[Rcpp::export]]
+Rcpp::List simulate_colonies
+ (const unsigned number_of_replicates,
+  arma::mat offspring_per_mating,
+  std::vector<arma::vec> allele_frequencies,
+  arma::vec dropout_rate,
+  arma::vec mistyping_rate,
+  const double probability_of_missing_data = 0.,
+  const unsigned number_of_offspring = 0,
+  const unsigned number_of_sampled_mothers = 1,
+  Rcpp::Nullable<Rcpp::IntegerVector> maternal_genotypes = R_NilValue,
+  Rcpp::Nullable<Rcpp::IntegerMatrix> paternal_genotypes = R_NilValue)
+{
+  // simulate replicate colonies directly into the phenotype layout used by the samplers; each replicate
+  // gets its own random number stream seeded from R. If given, "maternal_genotypes" (2 x mothers x loci)
+  // and "paternal_genotypes" (fathers x loci) fix the parental genotypes, as 1-based allele indices
+  const unsigned number_of_loci = allele_frequencies.size();
+
+  if (offspring_per_mating.n_rows < 1 || offspring_per_mating.n_cols < 1) Rcpp::stop("need at least one father and one mother");
+  if (arma::any(arma::vectorise(offspring_per_mating) < 0.)) Rcpp::stop("negative offspring per mating");
+  if (number_of_offspring == 0 && arma::accu(arma::round(offspring_per_mating)) < 1.) Rcpp::stop("need at least one offspring");
+  if (number_of_offspring > 0 && arma::accu(offspring_per_mating) <= 0.) Rcpp::stop("proportions of offspring per mating must sum to a positive value");
+  if (number_of_sampled_mothers > offspring_per_mating.n_cols) Rcpp::stop("more sampled mothers than mothers");
+  if (dropout_rate.n_elem != number_of_loci) Rcpp::stop("must have dropout rates for each locus");
+  if (mistyping_rate.n_elem != number_of_loci) Rcpp::stop("must have mistyping rates for each locus");
+  if (arma::any(dropout_rate < 0.) || arma::any(dropout_rate > 0.5)) Rcpp::stop("dropout rates must be in [0, 0.5]");
+  if (arma::any(mistyping_rate < 0.) || arma::any(mistyping_rate > 1.)) Rcpp::stop("mistyping rates must be in [0, 1]");
+  if (probability_of_missing_data < 0. || probability_of_missing_data > 1.) Rcpp::stop("probability of missing data must be in [0, 1]");
+  for (auto& frequencies : allele_frequencies)
+  {
+    if (frequencies.n_elem < 1 || arma::any(frequencies < 0.) || arma::accu(frequencies) <= 0.) Rcpp::stop("invalid allele frequencies");
+  }
+
+  arma::ucube fixed_maternal_genotypes;
+  arma::umat fixed_paternal_genotypes;
+  if (maternal_genotypes.isNotNull())
+  {
+    fixed_maternal_genotypes = Rcpp::as<arma::ucube>(maternal_genotypes.get());
+    if (fixed_maternal_genotypes.n_rows != 2 || fixed_maternal_genotypes.n_cols != offspring_per_mating.n_cols || 
+        fixed_maternal_genotypes.n_slices != number_of_loci) Rcpp::stop("maternal genotypes must be 2 x mothers x loci");
+  }
+  if (paternal_genotypes.isNotNull())
+  {
+    fixed_paternal_genotypes = Rcpp::as<arma::umat>(paternal_genotypes.get());
+    if (fixed_paternal_genotypes.n_rows != offspring_per_mating.n_rows || 
+        fixed_paternal_genotypes.n_cols != number_of_loci) Rcpp::stop("paternal genotypes must be fathers x loci");
+  }
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    const unsigned number_of_alleles = allele_frequencies[locus].n_elem;
+    if (!fixed_maternal_genotypes.is_empty() && (fixed_maternal_genotypes.slice(locus).min() < 1 || 
+          fixed_maternal_genotypes.slice(locus).max() > number_of_alleles)) Rcpp::stop("maternal allele out of range");
+    if (!fixed_paternal_genotypes.is_empty() && (fixed_paternal_genotypes.col(locus).min() < 1 || 
+          fixed_paternal_genotypes.col(locus).max() > number_of_alleles)) Rcpp::stop("paternal allele out of range");
+  }
+
+  Rcpp::List replicates (number_of_replicates);
+  for (unsigned replicate=0; replicate<number_of_replicates; ++replicate)
+  {
+    random_number_generator rng (random_seed_from_R());
+    simulated_colony colony = simulate_colony(rng, offspring_per_mating, allele_frequencies, dropout_rate, mistyping_rate,
+        probability_of_missing_data, number_of_offspring, number_of_sampled_mothers, fixed_maternal_genotypes, 
+        fixed_paternal_genotypes);
+    replicates[replicate] = Rcpp::List::create(
+        Rcpp::_["phenotypes"] = colony.phenotypes,
+        Rcpp::_["genotypes"] = colony.genotypes,
+        Rcpp::_["maternal_genotypes"] = colony.maternal_genotypes,
+        Rcpp::_["paternal_genotypes"] = colony.paternal_genotypes,
+        Rcpp::_["paternal_phenotypes"] = colony.paternal_phenotypes,
+        Rcpp::_["maternity"] = colony.maternity,
+        Rcpp::_["paternity"] = colony.paternity,
+        Rcpp::_["errors"] = colony.errors
+        );
+  }
+  return replicates;
 }
 
 // ---------------------------------------------------------------------------- //
 
+template <class RNG>
 std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paternity
  (const arma::uvec& paternity,
   const arma::umat& offspring_phenotypes, 
   const arma::uvec& maternal_phenotype, 
   const arma::vec& allele_frequencies, 
   const double& dropout_rate, 
-  const double& mistyping_rate)
+  const double& mistyping_rate,
+  RNG& rng)
 {
   // simulate from conditional posterior of error events given phenotypes and paternity
   
@@ -277,13 +517,13 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
   const arma::uvec fathers = arma::unique(paternity);
   const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
 
-  if (offspring_phenotypes.n_rows != 2) Rcpp::stop("offspring phenotypes must have 2 rows");
-  if (offspring_phenotypes.n_cols != paternity.n_elem) Rcpp::stop("offspring phenotypes must have column for each individual");
-  if (maternal_phenotype.n_elem != 2) Rcpp::stop("maternal phenotype must have 2 elements");
-  if (offspring_phenotypes.max() > number_of_alleles) Rcpp::stop("offspring allele out of range");
-  if (maternal_phenotype.max() > number_of_alleles) Rcpp::stop("maternal allele out of range");
-  if (arma::any(allele_frequencies_normalized < 0.)) Rcpp::stop("negative allele frequencies");
-  if (dropout_rate <= 0. || mistyping_rate <= 0.) Rcpp::stop("negative genotyping error rates");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
 
   // alternatively pass in as mutable argument
   arma::uvec maternal_genotype (2);
@@ -350,7 +590,7 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
   }
   maternal_genotype_posterior -= maternal_genotype_posterior.max();
   maternal_genotype = 
-    possible_maternal_genotypes.col(sample(arma::exp(maternal_genotype_posterior)));
+    possible_maternal_genotypes.col(rng.categorical(arma::exp(maternal_genotype_posterior)));
 
   // simulate paternal genotype; there are k possible genotypes
   // paternal genotypes are conditionally independent with fixed maternal genotype
@@ -379,7 +619,7 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
       possible_paternal_genotypes[u-1] = u;
     }
     paternal_genotype_posterior -= paternal_genotype_posterior.max();
-    paternal_genotypes.at(father) = possible_paternal_genotypes.at(sample(arma::exp(paternal_genotype_posterior)));
+    paternal_genotypes.at(father) = possible_paternal_genotypes.at(rng.categorical(arma::exp(paternal_genotype_posterior)));
   }
 
   // simulate offspring genotypes
@@ -401,7 +641,7 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
     }
     offspring_genotype_posterior -= offspring_genotype_posterior.max();
     offspring_genotypes.col(sib) = 
-      possible_offspring_genotypes.col(sample(arma::exp(offspring_genotype_posterior)));
+      possible_offspring_genotypes.col(rng.categorical(arma::exp(offspring_genotype_posterior)));
   }
 
   //simulate numbers of errors given genotypes and phenotypes
@@ -417,7 +657,7 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
     if (maternal_genotype[0] != maternal_genotype[1]) sampled_heterozygotes++;
     arma::uvec errors =
       simulate_genotyping_errors(maternal_phenotype, maternal_genotype[0], 
-          maternal_genotype[1], number_of_alleles, dropout_rate, mistyping_rate);
+          maternal_genotype[1], number_of_alleles, dropout_rate, mistyping_rate, rng);
     dropout_errors.at(0) = errors.at(0);
     mistype_errors.at(0) = errors.at(1);
     counts_of_errors += errors;
@@ -430,7 +670,7 @@ std::vector<arma::uvec> sample_genotyping_errors_and_allele_counts_given_paterni
       if (offspring_genotypes.at(0,sib) != offspring_genotypes.at(1,sib)) sampled_heterozygotes++;
       arma::uvec errors =
         simulate_genotyping_errors(offspring_phenotype, offspring_genotypes.at(0,sib), 
-          offspring_genotypes.at(1,sib), number_of_alleles, dropout_rate, mistyping_rate);
+          offspring_genotypes.at(1,sib), number_of_alleles, dropout_rate, mistyping_rate, rng);
       dropout_errors.at(sib+1) = errors.at(0);
       mistype_errors.at(sib+1) = errors.at(1);
       counts_of_errors += errors;
@@ -463,9 +703,15 @@ Rcpp::List sample_error_rates_given_paternity
   const unsigned number_of_mcmc_samples = 1000,
   const unsigned global_genotyping_error_rates = false,
   const bool random_allele_frequencies = true,
-  const bool add_unsampled_allele = true)
+  const bool add_unsampled_allele = true,
+  const bool instrument = false,
+  const bool profile_hardware = false,
+  const unsigned number_of_threads = 1)
 {
+  // loci are conditionally independent given paternity, so error events are sampled in parallel over loci
+  // with number_of_threads, each locus from its own stream; results do not depend on the number of threads
   if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
 
   const unsigned max_iter = number_of_mcmc_samples;
   const unsigned number_of_loci = phenotypes.n_slices;
@@ -490,31 +736,49 @@ Rcpp::List sample_error_rates_given_paternity
   arma::mat mistyping_rate_samples (number_of_loci, max_iter);
   arma::mat mistyping_errors (paternity.n_elem+1, number_of_loci, arma::fill::zeros);
   paternity = recode_to_contiguous_integers(paternity);
+  R_random_number_generator rng;
+  sampler_instrumentation instrumentation (instrument, profile_hardware);
   for (unsigned iter=0; iter<max_iter; ++iter)
   {
+    std::vector<std::vector<arma::uvec>> augmented (number_of_loci);
+    {
+      phase_timer timer (instrumentation, DATA_AUGMENTATION);
+      const uint64_t seed = sydneyPaternity::random_seed(rng);
+      run_parallel_tasks(number_of_loci, number_of_threads, [&] (const unsigned locus)
+      {
+        stream_random_number_generator locus_rng (seed, locus);
+        augmented[locus] = 
+          sample_genotyping_errors_and_allele_counts_given_paternity(paternity, offspring_phenotypes.slice(locus), 
+              maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus], locus_rng);
+      });
+    }
+
+    // counts are reduced in locus order
     arma::uvec global_dropout_counts (2, arma::fill::zeros);
     arma::uvec global_mistype_counts (2, arma::fill::zeros);
     for (unsigned locus=0; locus<number_of_loci; ++locus)
     {
-      std::vector<arma::uvec> error_counts =
-        sample_genotyping_errors_and_allele_counts_given_paternity(paternity, offspring_phenotypes.slice(locus), 
-            maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
-
-      // track number of errors
-      for (unsigned i=0; i<paternity.n_elem+1; ++i)
+      const std::vector<arma::uvec>& error_counts = augmented[locus];
       {
-        dropout_errors.at(i,locus) += double(error_counts[3][i]);
-        mistyping_errors.at(i,locus) += double(error_counts[4][i]);
-      }
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+
+        // track number of errors
+        for (unsigned i=0; i<paternity.n_elem+1; ++i)
+        {
+          dropout_errors.at(i,locus) += double(error_counts[3][i]);
+          mistyping_errors.at(i,locus) += double(error_counts[4][i]);
+        }
 
-      // update error rates
-      global_dropout_counts += error_counts[0]; global_mistype_counts += error_counts[1];
-      dropout_rate[locus] = 0.5 * R::rbeta(1. + error_counts[0][0], 1. + error_counts[0][1]);
-      mistyping_rate[locus] = R::rbeta(1. + error_counts[1][0], 1. + error_counts[1][1]);
+        // update error rates
+        global_dropout_counts += error_counts[0]; global_mistype_counts += error_counts[1];
+        dropout_rate[locus] = 0.5 * R::rbeta(1. + error_counts[0][0], 1. + error_counts[0][1]);
+        mistyping_rate[locus] = R::rbeta(1. + error_counts[1][0], 1. + error_counts[1][1]);
+      }
 
       // update allele frequencies
       if (random_allele_frequencies)
       {
+        phase_timer timer (instrumentation, ALLELE_FREQUENCY_UPDATE);
         for (unsigned allele=0; allele<allele_frequencies[locus].n_elem; ++allele)
         {
           allele_frequencies[locus][allele] = R::rgamma(1. + error_counts[2][allele], 1.);
@@ -525,12 +789,16 @@ Rcpp::List sample_error_rates_given_paternity
     if (global_genotyping_error_rates)
     {
       // overwrite per-locus rates with global rate
+      phase_timer timer (instrumentation, DATA_AUGMENTATION);
       dropout_rate.fill(0.5 * R::rbeta(1. + global_dropout_counts[0], 1. + global_dropout_counts[1]));
       mistyping_rate.fill(R::rbeta(1. + global_mistype_counts[0], 1. + global_mistype_counts[1]));
     }
     
-    dropout_rate_samples.col(iter) = dropout_rate;
-    mistyping_rate_samples.col(iter) = mistyping_rate;
+    {
+      phase_timer timer (instrumentation, STORAGE);
+      dropout_rate_samples.col(iter) = dropout_rate;
+      mistyping_rate_samples.col(iter) = mistyping_rate;
+    }
     if (iter % 100 == 0) Rcpp::Rcout << "[" << iter << "]" << std::endl;
   }
 
@@ -542,118 +810,188 @@ Rcpp::List sample_error_rates_given_paternity
   arma::rowvec maternal_mistyping_errors = mistyping_errors.row(0); 
   mistyping_errors.shed_row(0); mistyping_errors.insert_rows(mother-1, maternal_mistyping_errors);
 
-  return Rcpp::List::create(
+  Rcpp::List out = Rcpp::List::create(
       Rcpp::_["dropout_rate"] = dropout_rate_samples,
       Rcpp::_["mistyping_rate"] = mistyping_rate_samples,
       Rcpp::_["dropout_errors"] = arma::trans(dropout_errors),
       Rcpp::_["mistyping_errors"] = arma::trans(mistyping_errors)
       );
+  if (instrumentation.enabled) out.push_back(instrumentation_to_list(instrumentation), "timings");
+  return out;
+}
+
+double paternity_loglikelihood 
+ (arma::uvec paternity, 
+  arma::ucube offspring_phenotypes, 
+  arma::umat maternal_phenotype,
+  std::vector<arma::vec> allele_frequencies,
+  arma::vec dropout_rate,
+  arma::vec mistyping_rate,
+  const std::vector<paternity_likelihood_kernel>& kernels = std::vector<paternity_likelihood_kernel>())
+{
+  // "kernels" are per-locus specializations on number of alleles, from select_paternity_likelihood_kernels;
+  // if empty, the loop kernel paternity_loglikelihood_by_locus is used
+
+  // check number of loci match
+  const unsigned number_of_loci = allele_frequencies.size();
+  if (maternal_phenotype.n_cols != number_of_loci) throw std::invalid_argument("must have maternal phenotypes for each locus");
+  if (offspring_phenotypes.n_slices != number_of_loci) throw std::invalid_argument("must have offspring phenotypes for each locus");
+  if (dropout_rate.n_elem != number_of_loci) throw std::invalid_argument("must have dropout rates for each locus");
+  if (mistyping_rate.n_elem != number_of_loci) throw std::invalid_argument("must have mistyping rates for each locus");
+
+  double log_likelihood = 0.;
+  for (unsigned locus=0; locus<number_of_loci; ++locus)
+  {
+    paternity_likelihood_kernel kernel = kernels.empty() ? &paternity_loglikelihood_by_locus : kernels[locus];
+    log_likelihood += 
+      kernel(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
+  }
+  return log_likelihood;
+}
+
+void add_log_derivatives
+ (const arma::vec& derivatives,
+  double& log_value,
+  arma::vec2& gradient,
+  arma::mat22& hessian)
+{
+  // add log(f) and its gradient/hessian to a running total, given {f, df, d2f} from genotyping_error_model_derivatives
+  const double f = derivatives[0];
+  const double d_dropout = derivatives[1]/f;
+  const double d_mistyping = derivatives[2]/f;
+  log_value += log(f);
+  gradient[0] += d_dropout;
+  gradient[1] += d_mistyping;
+  hessian.at(0,0) += derivatives[3]/f - d_dropout*d_dropout;
+  hessian.at(0,1) += derivatives[4]/f - d_dropout*d_mistyping;
+  hessian.at(1,0) += derivatives[4]/f - d_dropout*d_mistyping;
+  hessian.at(1,1) += derivatives[5]/f - d_mistyping*d_mistyping;
 }
 
-double paternity_loglikelihood_by_locus 
+struct log_sum_exp_derivatives
+{
+  // running log(sum(exp(x_i))) with underflow protection as in the likelihood kernels, that also
+  // propagates the gradient and hessian of each x_i; uses d2(log S) = E_w[d2x + dx dx'] - E_w[dx] E_w[dx]'
+  double sum;
+  double running_maximum;
+  arma::vec2 gradient;
+  arma::mat22 second_moment;
+
+  log_sum_exp_derivatives (void) : sum(0.), running_maximum(-arma::datum::inf)
+  {
+    gradient.zeros();
+    second_moment.zeros();
+  }
+
+  void add (const double log_term, const arma::vec2& log_gradient, const arma::mat22& log_hessian)
+  {
+    if (log_term == -arma::datum::inf) return;
+    double weight = 1.;
+    if (log_term <= running_maximum) //underflow protection
+    {
+      weight = exp(log_term - running_maximum);
+    } else {
+      const double rescale = exp(running_maximum - log_term);
+      sum *= rescale;
+      gradient *= rescale;
+      second_moment *= rescale;
+      running_maximum = log_term;
+    }
+    sum += weight;
+    gradient += weight * log_gradient;
+    second_moment += weight * (log_hessian + log_gradient * log_gradient.t());
+  }
+
+  double log_value (void) const
+  {
+    return log(sum) + running_maximum;
+  }
+
+  arma::vec2 log_gradient (void) const
+  {
+    // all terms -inf: log value is -inf, and derivatives are taken as zero rather than 0/0
+    if (sum == 0.) return arma::vec2(arma::fill::zeros);
+    return gradient / sum;
+  }
+
+  arma::mat22 log_hessian (void) const
+  {
+    if (sum == 0.) return arma::mat22(arma::fill::zeros);
+    const arma::vec2 mean_gradient = gradient / sum;
+    return second_moment / sum - mean_gradient * mean_gradient.t();
+  }
+};
+
+std::tuple<double, arma::vec, arma::mat> paternity_loglikelihood_derivatives_by_locus
  (const arma::uvec& paternity,
-  const arma::umat& offspring_phenotypes, 
-  const arma::uvec& maternal_phenotype, 
-  const arma::vec& allele_frequencies, 
-  const double& dropout_rate, 
+  const arma::umat& offspring_phenotypes,
+  const arma::uvec& maternal_phenotype,
+  const arma::vec& allele_frequencies,
+  const double& dropout_rate,
   const double& mistyping_rate)
 {
-  // likelihood of offspring paternity given offspring phenotypes, maternal phenotype, haplodiploidy
-  // modified from Eqs 3 & 4 in Wang 2004 Genetics
+  // paternity_loglikelihood_by_locus along with its gradient and hessian with respect to (dropout_rate, mistyping_rate),
+  // obtained by pushing derivatives of the error model through the same marginalization over parental genotypes
   const unsigned number_of_alleles = allele_frequencies.n_elem;
-  const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
   const arma::uvec fathers = arma::unique(paternity);
   const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
 
-  if (offspring_phenotypes.n_rows != 2) Rcpp::stop("offspring phenotypes must have 2 rows");
-  if (offspring_phenotypes.n_cols != paternity.n_elem) Rcpp::stop("offspring phenotypes must have column for each individual");
-  if (maternal_phenotype.n_elem != 2) Rcpp::stop("maternal phenotype must have 2 elements");
-  if (offspring_phenotypes.max() > number_of_alleles) Rcpp::stop("offspring allele out of range");
-  if (maternal_phenotype.max() > number_of_alleles) Rcpp::stop("maternal allele out of range");
-  if (arma::any(allele_frequencies_normalized < 0.)) Rcpp::stop("negative allele frequencies");
-  if (dropout_rate <= 0. || mistyping_rate <= 0.) Rcpp::stop("negative genotyping error rates");
+  if (offspring_phenotypes.n_rows != 2) throw std::invalid_argument("offspring phenotypes must have 2 rows");
+  if (offspring_phenotypes.n_cols != paternity.n_elem) throw std::invalid_argument("offspring phenotypes must have column for each individual");
+  if (maternal_phenotype.n_elem != 2) throw std::invalid_argument("maternal phenotype must have 2 elements");
+  if (offspring_phenotypes.max() > number_of_alleles) throw std::invalid_argument("offspring allele out of range");
+  if (maternal_phenotype.max() > number_of_alleles) throw std::invalid_argument("maternal allele out of range");
+  if (arma::any(allele_frequencies_normalized < 0.)) throw std::invalid_argument("negative allele frequencies");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) throw std::invalid_argument("negative genotyping error rates");
 
-  double halfsib_likelihood = 0.;
-  double halfsib_running_maximum = -arma::datum::inf;
-  for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
-  { 
+  log_sum_exp_derivatives halfsib_likelihood;
+  for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele
+  {
     for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
     {
-      double maternal_genotype_probability = 
+      double maternal_genotype_probability =
         (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
-      double log_halfsib_likelihood = log(maternal_genotype_probability); 
+      double log_halfsib_likelihood = log(maternal_genotype_probability);
+      arma::vec2 halfsib_gradient (arma::fill::zeros);
+      arma::mat22 halfsib_hessian (arma::fill::zeros);
       if (arma::prod(maternal_phenotype))
       {
-        double maternal_phenotype_probability = 
-          genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
-        log_halfsib_likelihood += log(maternal_phenotype_probability);
+        add_log_derivatives(
+            genotyping_error_model_derivatives(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate),
+            log_halfsib_likelihood, halfsib_gradient, halfsib_hessian);
       }
       for (auto father : fathers)
       {
-        double fullsib_likelihood = 0.;
-        double fullsib_running_maximum = -arma::datum::inf;
+        log_sum_exp_derivatives fullsib_likelihood;
         arma::uvec offspring_from_father = arma::find(paternity == father);
         for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
         {
-          double paternal_genotype_probability = 
+          double paternal_genotype_probability =
             allele_frequencies_normalized[u-1]; //hwe prior
           double log_fullsib_likelihood = log(paternal_genotype_probability);
+          arma::vec2 fullsib_gradient (arma::fill::zeros);
+          arma::mat22 fullsib_hessian (arma::fill::zeros);
           for (auto offspring : offspring_from_father)
           {
             arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
-            if (arma::prod(offspring_phenotype)) { 
-              double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
-                0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
-                0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
-              log_fullsib_likelihood += log(offspring_phenotype_probability);
-            } 
-          }
-          if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
-          {
-            fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
-          } else {
-            fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
-            fullsib_likelihood += 1.;
-            fullsib_running_maximum = log_fullsib_likelihood;
+            if (arma::prod(offspring_phenotype)) {
+              arma::vec offspring_phenotype_derivatives = // Mendelian segregation probs * phenotype probabilities
+                0.5 * genotyping_error_model_derivatives(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) +
+                0.5 * genotyping_error_model_derivatives(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate);
+              add_log_derivatives(offspring_phenotype_derivatives, log_fullsib_likelihood, fullsib_gradient, fullsib_hessian);
+            }
           }
+          fullsib_likelihood.add(log_fullsib_likelihood, fullsib_gradient, fullsib_hessian);
         }
-        log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
-      }
-      if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
-      {
-        halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
-      } else {
-        halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
-        halfsib_likelihood += 1.;
-        halfsib_running_maximum = log_halfsib_likelihood;
+        log_halfsib_likelihood += fullsib_likelihood.log_value();
+        halfsib_gradient += fullsib_likelihood.log_gradient();
+        halfsib_hessian += fullsib_likelihood.log_hessian();
       }
+      halfsib_likelihood.add(log_halfsib_likelihood, halfsib_gradient, halfsib_hessian);
     }
   }
-  return log(halfsib_likelihood) + halfsib_running_maximum;
-}
-
-double paternity_loglikelihood 
- (arma::uvec paternity, 
-  arma::ucube offspring_phenotypes, 
-  arma::umat maternal_phenotype,
-  std::vector<arma::vec> allele_frequencies,
-  arma::vec dropout_rate,
-  arma::vec mistyping_rate)
-{
-  // check number of loci match
-  const unsigned number_of_loci = allele_frequencies.size();
-  if (maternal_phenotype.n_cols != number_of_loci) Rcpp::stop("must have maternal phenotypes for each locus");
-  if (offspring_phenotypes.n_slices != number_of_loci) Rcpp::stop("must have offspring phenotypes for each locus");
-  if (dropout_rate.n_elem != number_of_loci) Rcpp::stop("must have dropout rates for each locus");
-  if (mistyping_rate.n_elem != number_of_loci) Rcpp::stop("must have mistyping rates for each locus");
-
-  double log_likelihood = 0.;
-  for (unsigned locus=0; locus<number_of_loci; ++locus)
-  {
-    log_likelihood += 
-      paternity_loglikelihood_by_locus(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
-  }
-  return log_likelihood;
+  return std::make_tuple(halfsib_likelihood.log_value(),
+      arma::vec(halfsib_likelihood.log_gradient()), arma::mat(halfsib_likelihood.log_hessian()));
 }
 
 // [[Rcpp::export]]
@@ -675,6 +1013,8 @@ Rcpp::List optimize_paternity_given_error_rates
 
   const unsigned max_iter = 1000;
   const double convergence_tolerance = 1e-8;
+  const std::vector<paternity_likelihood_kernel> kernels = 
+    select_paternity_likelihood_kernels(allele_frequencies);
 
   unsigned iter;
   double current_loglik = -arma::datum::inf;
@@ -690,7 +1030,7 @@ Rcpp::List optimize_paternity_given_error_rates
       for (unsigned father=0; father<=current_number_of_fathers; ++father)
       {
         paternity[sib] = father;
-        log_likelihood[father] = paternity_loglikelihood(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, dropout_rate, mistyping_rate);
+        log_likelihood[father] = paternity_loglikelihood(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, dropout_rate, mistyping_rate, kernels);
       }
       paternity[sib] = log_likelihood.index_max();
       paternity = recode_to_contiguous_integers(paternity);
@@ -738,6 +1078,234 @@ arma::mat loglikelihood_of_error_rates_given_paternity
   return log_likelihood;
 }
 
+std::tuple<double, arma::vec, arma::mat> error_rates_log_posterior
+ (const arma::uvec& paternity,
+  const arma::ucube& offspring_phenotypes,
+  const arma::umat& maternal_phenotype,
+  const std::vector<arma::vec>& allele_frequencies,
+  const arma::uvec& loci,
+  const arma::vec& dropout_rate_prior,
+  const arma::vec& mistyping_rate_prior,
+  const double& dropout_rate,
+  const double& mistyping_rate,
+  const bool derivatives)
+{
+  // log posterior of error rates shared across "loci", and (optionally) its gradient and hessian with respect to
+  // (dropout_rate, mistyping_rate); priors are beta on 2*dropout_rate and mistyping_rate, as in the Gibbs samplers
+  double log_posterior =
+    (dropout_rate_prior[0] - 1.) * log(2.*dropout_rate) + (dropout_rate_prior[1] - 1.) * log(1. - 2.*dropout_rate) +
+    (mistyping_rate_prior[0] - 1.) * log(mistyping_rate) + (mistyping_rate_prior[1] - 1.) * log(1. - mistyping_rate);
+  arma::vec gradient (2, arma::fill::zeros);
+  arma::mat hessian (2, 2, arma::fill::zeros);
+  if (derivatives)
+  {
+    gradient[0] = (dropout_rate_prior[0] - 1.)/dropout_rate - 2.*(dropout_rate_prior[1] - 1.)/(1. - 2.*dropout_rate);
+    gradient[1] = (mistyping_rate_prior[0] - 1.)/mistyping_rate - (mistyping_rate_prior[1] - 1.)/(1. - mistyping_rate);
+    hessian.at(0,0) = -(dropout_rate_prior[0] - 1.)/pow(dropout_rate, 2) - 4.*(dropout_rate_prior[1] - 1.)/pow(1. - 2.*dropout_rate, 2);
+    hessian.at(1,1) = -(mistyping_rate_prior[0] - 1.)/pow(mistyping_rate, 2) - (mistyping_rate_prior[1] - 1.)/pow(1. - mistyping_rate, 2);
+  }
+  for (auto locus : loci)
+  {
+    if (derivatives)
+    {
+      double locus_loglikelihood;
+      arma::vec locus_gradient;
+      arma::mat locus_hessian;
+      std::tie(locus_loglikelihood, locus_gradient, locus_hessian) =
+        paternity_loglikelihood_derivatives_by_locus(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+            allele_frequencies[locus], dropout_rate, mistyping_rate);
+      log_posterior += locus_loglikelihood;
+      gradient += locus_gradient;
+      hessian += locus_hessian;
+    } else {
+      log_posterior +=
+        paternity_loglikelihood_by_locus(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+            allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+  }
+  return std::make_tuple(log_posterior, gradient, hessian);
+}
+
+// [[Rcpp::export]]
+Rcpp::List optimize_error_rates_given_paternity
+ (arma::ucube phenotypes,
+  arma::uvec paternity,
+  const unsigned mother = 1,
+  const bool global_genotyping_error_rates = false,
+  const double starting_dropout_rate = 0.05,
+  const double starting_mistyping_rate = 0.05,
+  const unsigned max_iterations = 100,
+  const double convergence_tolerance = 1e-8)
+{
+  // MAP estimates of error rates given paternity, via damped Newton iterations using analytic derivatives of the
+  // likelihood. Optimization is on the logit scale (dropout_rate = 0.5*logistic(x), mistyping_rate = logistic(y)),
+  // curvature is reported on the natural scale
+  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  if (paternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("paternity must have an element for each offspring");
+  if (starting_dropout_rate <= 0. || starting_dropout_rate >= 0.5) Rcpp::stop("starting dropout rate must be in (0, 0.5)");
+  if (starting_mistyping_rate <= 0. || starting_mistyping_rate >= 1.) Rcpp::stop("starting mistyping rate must be in (0, 1)");
+
+  const unsigned number_of_loci = phenotypes.n_slices;
+
+  // priors (hardcoded for now)
+  const arma::vec dropout_rate_prior = {{1.,1.}}; //beta(number of dropout homozygotes, number of heterozygotes)
+  const arma::vec mistyping_rate_prior = {{1.,1.}}; //beta(number of mistypes, number of correct calls)
+  std::vector<arma::vec> allele_frequencies =
+    collapse_alleles_and_generate_genotype_prior(phenotypes); //creates uniform frequency prior
+
+  // split maternal, offspring phenotypes
+  arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
+  arma::ucube offspring_phenotypes = phenotypes; offspring_phenotypes.shed_col(mother-1);
+  paternity = recode_to_contiguous_integers(paternity);
+
+  // either each locus separately, or all loci jointly
+  std::vector<arma::uvec> groups_of_loci;
+  if (global_genotyping_error_rates)
+  {
+    groups_of_loci.push_back(arma::regspace<arma::uvec>(0, number_of_loci-1));
+  } else {
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      groups_of_loci.push_back(arma::uvec({locus}));
+    }
+  }
+
+  arma::vec dropout_rate (number_of_loci);
+  arma::vec mistyping_rate (number_of_loci);
+  arma::vec log_posterior (number_of_loci);
+  arma::cube hessian (2, 2, number_of_loci);
+  arma::mat standard_errors (number_of_loci, 2);
+  arma::uvec iterations (number_of_loci);
+  arma::uvec evaluations (number_of_loci);
+  arma::uvec converged (number_of_loci);
+  for (auto loci : groups_of_loci)
+  {
+    double current_dropout_rate = starting_dropout_rate;
+    double current_mistyping_rate = starting_mistyping_rate;
+    arma::vec2 unconstrained = {{
+      log(2.*current_dropout_rate) - log(1. - 2.*current_dropout_rate),
+      log(current_mistyping_rate) - log(1. - current_mistyping_rate)
+    }};
+
+    double current_log_posterior;
+    arma::vec gradient;
+    arma::mat natural_hessian;
+    std::tie(current_log_posterior, gradient, natural_hessian) =
+      error_rates_log_posterior(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, loci,
+          dropout_rate_prior, mistyping_rate_prior, current_dropout_rate, current_mistyping_rate, true);
+
+    unsigned number_of_evaluations = 1;
+    bool has_converged = false;
+    unsigned iter;
+    for (iter=0; iter<max_iterations; ++iter)
+    {
+      // no Newton step from an impossible or non-finite point
+      if (!std::isfinite(current_log_posterior) || !gradient.is_finite() || !natural_hessian.is_finite()) break;
+
+      // chain rule to logit scale
+      const arma::vec2 jacobian = {{
+        current_dropout_rate * (1. - 2.*current_dropout_rate),
+        current_mistyping_rate * (1. - current_mistyping_rate)
+      }};
+      const arma::vec2 curvature = {{
+        jacobian[0] * (1. - 4.*current_dropout_rate),
+        jacobian[1] * (1. - 2.*current_mistyping_rate)
+      }};
+      const arma::vec unconstrained_gradient = jacobian % gradient;
+      const arma::mat unconstrained_hessian =
+        arma::diagmat(jacobian) * natural_hessian * arma::diagmat(jacobian) + arma::diagmat(curvature % gradient);
+
+      // Levenberg damping until the negative hessian is positive definite
+      arma::mat negative_hessian = -unconstrained_hessian;
+      arma::mat cholesky_factor;
+      double damping = 0.;
+      while (!arma::chol(cholesky_factor, negative_hessian + damping * arma::eye(2,2)))
+      {
+        damping = damping > 0. ? 10.*damping : 1e-4 * std::max(1., arma::abs(negative_hessian).max());
+      }
+      const arma::vec step = arma::solve(negative_hessian + damping * arma::eye(2,2), unconstrained_gradient);
+
+      // backtracking line search for sufficient increase (Armijo)
+      const double directional_derivative = arma::dot(unconstrained_gradient, step);
+      double step_size = 1.;
+      double proposed_log_posterior = -arma::datum::inf;
+      arma::vec2 proposed;
+      double proposed_dropout_rate, proposed_mistyping_rate;
+      for (unsigned halving=0; halving<30; ++halving)
+      {
+        proposed = unconstrained + step_size * step;
+        proposed_dropout_rate = 0.5/(1. + exp(-proposed[0]));
+        proposed_mistyping_rate = 1./(1. + exp(-proposed[1]));
+        if (proposed_dropout_rate > 0. && proposed_dropout_rate < 0.5 &&
+            proposed_mistyping_rate > 0. && proposed_mistyping_rate < 1.)
+        {
+          proposed_log_posterior = std::get<0>(
+              error_rates_log_posterior(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, loci,
+                dropout_rate_prior, mistyping_rate_prior, proposed_dropout_rate, proposed_mistyping_rate, false));
+          number_of_evaluations++;
+          if (proposed_log_posterior >= current_log_posterior + 1e-4 * step_size * directional_derivative) break;
+        }
+        step_size *= 0.5;
+      }
+      if (!(proposed_log_posterior >= current_log_posterior))
+      {
+        // no ascent along Newton direction, so we are at a (numerical) maximum
+        has_converged = arma::norm(unconstrained_gradient) < sqrt(convergence_tolerance);
+        break;
+      }
+
+      const double delta = proposed_log_posterior - current_log_posterior;
+      unconstrained = proposed;
+      current_dropout_rate = proposed_dropout_rate;
+      current_mistyping_rate = proposed_mistyping_rate;
+      std::tie(current_log_posterior, gradient, natural_hessian) =
+        error_rates_log_posterior(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, loci,
+            dropout_rate_prior, mistyping_rate_prior, current_dropout_rate, current_mistyping_rate, true);
+      number_of_evaluations++;
+
+      if (delta < convergence_tolerance)
+      {
+        has_converged = true;
+        ++iter;
+        break;
+      }
+    }
+
+    // standard errors from the observed information on the natural scale
+    arma::vec2 error_rate_standard_errors;
+    arma::mat covariance;
+    if (arma::inv_sympd(covariance, -natural_hessian))
+    {
+      error_rate_standard_errors = arma::sqrt(covariance.diag());
+    } else {
+      error_rate_standard_errors.fill(arma::datum::nan);
+    }
+
+    for (auto locus : loci)
+    {
+      dropout_rate[locus] = current_dropout_rate;
+      mistyping_rate[locus] = current_mistyping_rate;
+      log_posterior[locus] = current_log_posterior;
+      hessian.slice(locus) = natural_hessian;
+      standard_errors.row(locus) = error_rate_standard_errors.t();
+      iterations[locus] = iter;
+      evaluations[locus] = number_of_evaluations;
+      converged[locus] = has_converged;
+    }
+  }
+
+  return Rcpp::List::create(
+      Rcpp::_["dropout_rate"] = dropout_rate,
+      Rcpp::_["mistyping_rate"] = mistyping_rate,
+      Rcpp::_["log_posterior"] = log_posterior,
+      Rcpp::_["hessian"] = hessian,
+      Rcpp::_["standard_errors"] = standard_errors,
+      Rcpp::_["iterations"] = iterations,
+      Rcpp::_["evaluations"] = evaluations,
+      Rcpp::_["converged"] = converged
+      );
+}
+
 // [[Rcpp::export]]
 Rcpp::List collapse_alleles_and_generate_prior_wrapper 
  (arma::ucube phenotypes, 
@@ -754,21 +1322,34 @@ Rcpp::List collapse_alleles_and_generate_prior_wrapper
       Rcpp::_["maternal"] = maternal_phenotype);
 }
 
-// [[Rcpp::export]]
-Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
+struct paternity_posterior_samples
+{
+  arma::umat paternity;
+  arma::mat dropout_rate;
+  arma::mat mistyping_rate;
+  arma::uvec number_of_fathers;
+  arma::mat dropout_errors;
+  arma::mat mistyping_errors;
+  arma::vec deviance;
+};
+
+template <class RNG>
+paternity_posterior_samples sample_paternity_and_error_rates_from_joint_posterior
  (arma::ucube phenotypes, 
-  const unsigned mother = 1,
-  const unsigned number_of_mcmc_samples = 1000,
-  const bool global_genotyping_error_rates = true,
-  const double concentration = 1.,
-  const bool update_error_rates = true,
-  const bool update_allele_frequencies = false,
-  const bool add_unsampled_allele = true)
+  const unsigned mother,
+  const unsigned number_of_mcmc_samples,
+  const bool global_genotyping_error_rates,
+  const double concentration,
+  const bool update_error_rates,
+  const bool update_allele_frequencies,
+  const bool add_unsampled_allele,
+  RNG& rng,
+  sampler_instrumentation& instrumentation,
+  const bool verbose)
 {
   // samples from posterior distribution of full sib groups with Dirichlet process prior,
-  // using algorithm 8 from Neal 2000 JCGS with m = 1
-  
-  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  // using algorithm 8 from Neal 2000 JCGS with m = 1; inputs are checked by the caller
+  // so that this may run outside of the main thread with a thread-local RNG
 
   const unsigned max_iter = number_of_mcmc_samples;
   const unsigned num_loci = phenotypes.n_slices;
@@ -782,17 +1363,15 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
   const arma::vec mistyping_rate_prior = {{1.,1.}}; //beta(number of mistypes, number of correct calls)
   std::vector<arma::vec> allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, add_unsampled_allele);
 
-  // calculate coefficients needed for the MFM prior
-  const unsigned max_number_of_fathers = num_offspring;
+  // coefficients needed for the MFM prior (up to one father per offspring), shared with other colonies of the same size
   arma::vec log_mfm_prior (num_offspring, arma::fill::zeros);
   if (gamma > 0.)
   {
-    for (unsigned i=1; i<=num_offspring; ++i)
-    {
-      log_mfm_prior[i-1] = log_uniform_MFM_prior(num_offspring, i, gamma, max_number_of_fathers);
-    }
+    bool cache_hit = false;
+    log_mfm_prior = *sydneyPaternity::cached_log_uniform_mfm_coefficients(num_offspring, gamma, &cache_hit);
+    if (cache_hit) instrumentation.increment(CACHE_HITS);
   }
-  if (arma::any(log_mfm_prior > 0.)) Rcpp::stop("problem with prior, this should not have happened");
+  if (arma::any(log_mfm_prior > 0.)) throw std::invalid_argument("problem with prior, this should not have happened");
 
   // split maternal, offspring phenotypes
   arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
@@ -812,6 +1391,9 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
   arma::mat dropout_errors (num_offspring+1, num_loci, arma::fill::zeros);
   arma::mat mistyping_errors (num_offspring+1, num_loci, arma::fill::zeros);
 
+  const std::vector<paternity_likelihood_kernel> kernels = 
+    select_paternity_likelihood_kernels(allele_frequencies);
+
   double deviance = 0.;
   paternity = recode_to_contiguous_integers(paternity);
   for (unsigned iter=0; iter<max_iter; ++iter)
@@ -819,6 +1401,8 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
     // update paternity vector
     for (unsigned sib=0; sib<num_offspring; ++sib)
     {
+      phase_timer timer (instrumentation, PARENTAGE_UPDATE);
+
       // tally size of sib groups
       unsigned current_number_of_fathers = paternity.max() + 1;
       arma::uvec offspring_per_father (current_number_of_fathers + 1, arma::fill::zeros);
@@ -828,10 +1412,12 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
 
       // conditional paternity probabilities
       arma::vec log_likelihood (current_number_of_fathers + unsigned(sib_is_not_singleton));
+      instrumentation.increment(CANDIDATE_LABELS, log_likelihood.n_elem);
+      instrumentation.increment(LIKELIHOOD_EVALUATIONS, log_likelihood.n_elem * num_loci);
       for (unsigned father=0; father<log_likelihood.n_elem; ++father)
       {
         paternity[sib] = father;
-        log_likelihood[father] = paternity_loglikelihood(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, dropout_rate, mistyping_rate);
+        log_likelihood[father] = paternity_loglikelihood(paternity, offspring_phenotypes, maternal_phenotype, allele_frequencies, dropout_rate, mistyping_rate, kernels);
 
         // "restraunt process" prior
         double log_prior = 0.;
@@ -852,7 +1438,7 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
       }
 
       // sample new father
-      paternity[sib] = sample(arma::exp(log_likelihood - log_likelihood.max()));
+      paternity[sib] = rng.categorical(arma::exp(log_likelihood - log_likelihood.max()));
       deviance = -2 * log_likelihood[paternity[sib]];
       paternity = recode_to_contiguous_integers(paternity); 
       //why recode? indices will increase, if pre-existing singleton is moved to a father with a higher index
@@ -863,31 +1449,36 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
     arma::uvec global_mistype_counts (2, arma::fill::zeros);
     for (unsigned locus=0; locus<num_loci; ++locus)
     {
-      std::vector<arma::uvec> error_counts =
-        sample_genotyping_errors_and_allele_counts_given_paternity(paternity, offspring_phenotypes.slice(locus), 
-            maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
-
-      // track number of errors
-      for (unsigned i=0; i<paternity.n_elem+1; ++i)
+      std::vector<arma::uvec> error_counts;
       {
-        dropout_errors.at(i,locus) += double(error_counts[3][i]);
-        mistyping_errors.at(i,locus) += double(error_counts[4][i]);
-      }
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+        error_counts =
+          sample_genotyping_errors_and_allele_counts_given_paternity(paternity, offspring_phenotypes.slice(locus), 
+              maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus], rng);
 
-      // update error rates
-      if (update_error_rates)
-      {
-        global_dropout_counts += error_counts[0]; global_mistype_counts += error_counts[1];
-        dropout_rate[locus] = 0.5 * R::rbeta(1. + error_counts[0][0], 1. + error_counts[0][1]);
-        mistyping_rate[locus] = R::rbeta(1. + error_counts[1][0], 1. + error_counts[1][1]);
+        // track number of errors
+        for (unsigned i=0; i<paternity.n_elem+1; ++i)
+        {
+          dropout_errors.at(i,locus) += double(error_counts[3][i]);
+          mistyping_errors.at(i,locus) += double(error_counts[4][i]);
+        }
+
+        // update error rates
+        if (update_error_rates)
+        {
+          global_dropout_counts += error_counts[0]; global_mistype_counts += error_counts[1];
+          dropout_rate[locus] = 0.5 * rng.beta(1. + error_counts[0][0], 1. + error_counts[0][1]);
+          mistyping_rate[locus] = rng.beta(1. + error_counts[1][0], 1. + error_counts[1][1]);
+        }
       }
 
       // update allele frequencies
       if (update_allele_frequencies)
       {
+        phase_timer timer (instrumentation, ALLELE_FREQUENCY_UPDATE);
         for (unsigned allele=0; allele<allele_frequencies[locus].n_elem; ++allele)
         {
-          allele_frequencies[locus][allele] = R::rgamma(1. + error_counts[2][allele], 1.);
+          allele_frequencies[locus][allele] = rng.gamma(1. + error_counts[2][allele]);
         }
         allele_frequencies[locus] /= arma::accu(allele_frequencies[locus]);
       }
@@ -895,18 +1486,22 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
     if (update_error_rates && global_genotyping_error_rates)
     {
       // overwrite per-locus rates with global rate
-      dropout_rate.fill(0.5 * R::rbeta(1. + global_dropout_counts[0], 1. + global_dropout_counts[1]));
-      mistyping_rate.fill(R::rbeta(1. + global_mistype_counts[0], 1. + global_mistype_counts[1]));
+      phase_timer timer (instrumentation, DATA_AUGMENTATION);
+      dropout_rate.fill(0.5 * rng.beta(1. + global_dropout_counts[0], 1. + global_dropout_counts[1]));
+      mistyping_rate.fill(rng.beta(1. + global_mistype_counts[0], 1. + global_mistype_counts[1]));
     }
 
     // store state
-    paternity_samples.col(iter) = paternity;
-    dropout_rate_samples.col(iter) = dropout_rate;
-    mistyping_rate_samples.col(iter) = mistyping_rate;
-    deviance_samples.at(iter) = deviance;
-    number_of_fathers_samples.at(iter) = paternity.max() + 1;
+    {
+      phase_timer timer (instrumentation, STORAGE);
+      paternity_samples.col(iter) = paternity;
+      dropout_rate_samples.col(iter) = dropout_rate;
+      mistyping_rate_samples.col(iter) = mistyping_rate;
+      deviance_samples.at(iter) = deviance;
+      number_of_fathers_samples.at(iter) = paternity.max() + 1;
+    }
 
-    if (iter % 100 == 0) Rcpp::Rcout << "[" << iter << "] " << "deviance: " << deviance << std::endl; //print # fathers too
+    if (verbose && iter % 100 == 0) Rcpp::Rcout << "[" << iter << "] " << "deviance: " << deviance << std::endl; //print # fathers too
   }
 
   // posterior expectation of error counts & reorder matrices to mirror input
@@ -917,14 +1512,312 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
   arma::rowvec maternal_mistyping_errors = mistyping_errors.row(0); 
   mistyping_errors.shed_row(0); mistyping_errors.insert_rows(mother-1, maternal_mistyping_errors);
 
+  paternity_posterior_samples samples;
+  samples.paternity = paternity_samples;
+  samples.dropout_rate = dropout_rate_samples;
+  samples.mistyping_rate = mistyping_rate_samples;
+  samples.number_of_fathers = number_of_fathers_samples;
+  samples.dropout_errors = dropout_errors;
+  samples.mistyping_errors = mistyping_errors;
+  samples.deviance = deviance_samples;
+  return samples;
+}
+
+// [[Rcpp::export]]
+Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
+ (arma::ucube phenotypes, 
+  const unsigned mother = 1,
+  const unsigned number_of_mcmc_samples = 1000,
+  const bool global_genotyping_error_rates = true,
+  const double concentration = 1.,
+  const bool update_error_rates = true,
+  const bool update_allele_frequencies = false,
+  const bool add_unsampled_allele = true,
+  const bool instrument = false,
+  const bool profile_hardware = false)
+{
+  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+
+  R_random_number_generator rng;
+  sampler_instrumentation instrumentation (instrument, profile_hardware);
+  paternity_posterior_samples samples = 
+    sample_paternity_and_error_rates_from_joint_posterior(phenotypes, mother, number_of_mcmc_samples, global_genotyping_error_rates,
+        concentration, update_error_rates, update_allele_frequencies, add_unsampled_allele, rng, instrumentation, true);
+
+  Rcpp::List out = Rcpp::List::create(
+    Rcpp::_["paternity"] = samples.paternity,
+    Rcpp::_["dropout_rate"] = samples.dropout_rate,
+    Rcpp::_["mistyping_rate"] = samples.mistyping_rate,
+    Rcpp::_["number_of_fathers"] = samples.number_of_fathers,
+    Rcpp::_["dropout_errors"] = samples.dropout_errors,
+    Rcpp::_["mistyping_errors"] = samples.mistyping_errors,
+    Rcpp::_["deviance"] = samples.deviance);
+  if (instrumentation.enabled) out.push_back(instrumentation_to_list(instrumentation), "timings");
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::List screen_paternity
+ (Rcpp::List colonies,
+  const double dropout_rate = 0.01,
+  const double mistyping_rate = 0.01,
+  const unsigned mother = 1,
+  const double concentration = 1.,
+  const unsigned max_number_of_fathers = 0,
+  const unsigned max_iterations = 100,
+  const double convergence_tolerance = 1e-6,
+  const unsigned number_of_threads = 1)
+{
+  // deterministic triage of many colonies with the variational approximation in variational.h, in parallel
+  // over colonies, to decide which are ambiguous enough to need the samplers. Each element of "colonies" is 
+  // a phenotype array as for optimize_paternity_given_error_rates, with the mother in column "mother" and the
+  // same loci in every colony. Allele frequencies are pooled over colonies, with a pseudocount per allele
+  const unsigned number_of_colonies = colonies.size();
+  if (number_of_colonies < 1) Rcpp::stop("need at least one colony");
+  if (dropout_rate <= 0. || mistyping_rate <= 0.) Rcpp::stop("negative genotyping error rates");
+  if (concentration <= 0.) Rcpp::stop("concentration must be positive");
+  if (max_iterations < 1) Rcpp::stop("need at least one iteration");
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+
+  std::vector<arma::ucube> phenotypes;
+  for (unsigned colony=0; colony<number_of_colonies; ++colony)
+  {
+    phenotypes.push_back(Rcpp::as<arma::ucube>(colonies[colony]));
+  }
+  const unsigned number_of_loci = phenotypes[0].n_slices;
+  if (number_of_loci < 1) Rcpp::stop("need at least one locus");
+  for (auto& colony : phenotypes)
+  {
+    if (colony.n_rows != 2) Rcpp::stop("phenotypes must have 2 rows");
+    if (colony.n_slices != number_of_loci) Rcpp::stop("colonies must have the same loci");
+    if (mother > colony.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+    if (colony.n_cols < 2) Rcpp::stop("need at least one offspring in each colony");
+  }
+
+  // pool allele counts on the original labels, then recode each colony and look up its alleles
+  std::vector<std::map<unsigned, double>> allele_counts (number_of_loci);
+  for (auto& colony : phenotypes)
+  {
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      const arma::uvec typed = arma::nonzeros(colony.slice(locus));
+      for (auto allele : typed) allele_counts[locus][allele] += 1.;
+    }
+  }
+  std::vector<std::vector<arma::vec>> allele_frequencies (number_of_colonies);
+  std::vector<arma::umat> maternal_phenotypes (number_of_colonies);
+  std::vector<arma::ucube> offspring_phenotypes (number_of_colonies);
+  for (unsigned colony=0; colony<number_of_colonies; ++colony)
+  {
+    const std::vector<arma::uvec> alleles = unique_alleles(phenotypes[colony]);
+    collapse_alleles_and_generate_genotype_prior(phenotypes[colony]); //recodes
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      arma::vec frequencies (std::max(alleles[locus].n_elem, arma::uword(1)), arma::fill::ones); //placeholder if untyped
+      for (unsigned i=0; i<alleles[locus].n_elem; ++i) frequencies[i] += allele_counts[locus][alleles[locus][i]];
+      allele_frequencies[colony].push_back(frequencies);
+    }
+    maternal_phenotypes[colony] = phenotypes[colony].tube(arma::span::all, arma::span(mother-1));
+    offspring_phenotypes[colony] = phenotypes[colony];
+    offspring_phenotypes[colony].shed_col(mother-1);
+  }
+
+  const arma::vec dropout_rates = dropout_rate * arma::ones<arma::vec>(number_of_loci);
+  const arma::vec mistyping_rates = mistyping_rate * arma::ones<arma::vec>(number_of_loci);
+  std::vector<sydneyPaternity::paternity_variational_fit> fits (number_of_colonies);
+  std::vector<std::string> colony_errors (number_of_colonies);
+
+  // colonies may run off the main thread, where R's API is off limits: errors are stored per colony
+  // and raised once the loop is done
+  run_parallel_tasks(number_of_colonies, number_of_threads, [&] (const unsigned colony)
+  {
+    try
+    {
+      fits[colony] = sydneyPaternity::fit_paternity_variational(offspring_phenotypes[colony], maternal_phenotypes[colony], 
+          allele_frequencies[colony], dropout_rates, mistyping_rates, concentration, max_number_of_fathers, 
+          max_iterations, convergence_tolerance);
+    }
+    catch (const std::exception& error)
+    {
+      colony_errors[colony] = error.what();
+    }
+  });
+  for (unsigned colony=0; colony<number_of_colonies; ++colony)
+  {
+    if (!colony_errors[colony].empty()) Rcpp::stop("colony " + std::to_string(colony+1) + ": " + colony_errors[colony]);
+  }
+
+  // one row per colony; soft assignments are offspring x fathers, with fathers in decreasing order of size
+  std::vector<int> colony_column, offspring_column, fathers_column, iterations_column;
+  std::vector<double> expected_fathers_column, minimum_probability_column, elbo_column;
+  std::vector<bool> converged_column, elbo_decreased_column;
+  Rcpp::List assignment (number_of_colonies), paternity (number_of_colonies), elbo (number_of_colonies);
+  for (unsigned colony=0; colony<number_of_colonies; ++colony)
+  {
+    const sydneyPaternity::paternity_variational_fit& fit = fits[colony];
+    colony_column.push_back(colony + 1);
+    offspring_column.push_back(fit.assignment.n_rows);
+    fathers_column.push_back(arma::uvec(arma::unique(fit.paternity)).n_elem);
+    expected_fathers_column.push_back(fit.expected_number_of_fathers);
+    minimum_probability_column.push_back(arma::min(arma::max(fit.assignment, 1)));
+    elbo_column.push_back(fit.elbo[fit.elbo.n_elem-1]);
+    iterations_column.push_back(fit.iterations);
+    converged_column.push_back(fit.converged);
+    elbo_decreased_column.push_back(fit.elbo_decreased);
+    if (fit.elbo_decreased) Rcpp::warning("ELBO decreased while fitting colony " + std::to_string(colony + 1));
+    assignment[colony] = fit.assignment;
+    paternity[colony] = fit.paternity;
+    elbo[colony] = fit.elbo;
+  }
+  if (colonies.hasAttribute("names"))
+  {
+    assignment.names() = colonies.names();
+    paternity.names() = colonies.names();
+    elbo.names() = colonies.names();
+  }
+
   return Rcpp::List::create(
-    Rcpp::_["paternity"] = paternity_samples,
-    Rcpp::_["dropout_rate"] = dropout_rate_samples,
-    Rcpp::_["mistyping_rate"] = mistyping_rate_samples,
-    Rcpp::_["number_of_fathers"] = number_of_fathers_samples,
-    Rcpp::_["dropout_errors"] = dropout_errors,
-    Rcpp::_["mistyping_errors"] = mistyping_errors,
-    Rcpp::_["deviance"] = deviance_samples);
+      Rcpp::_["summary"] = Rcpp::DataFrame::create(
+        Rcpp::_["colony"] = colony_column,
+        Rcpp::_["offspring"] = offspring_column,
+        Rcpp::_["expected_number_of_fathers"] = expected_fathers_column,
+        Rcpp::_["number_of_fathers"] = fathers_column,
+        Rcpp::_["minimum_assignment_probability"] = minimum_probability_column,
+        Rcpp::_["elbo"] = elbo_column,
+        Rcpp::_["iterations"] = iterations_column,
+        Rcpp::_["converged"] = converged_column,
+        Rcpp::_["elbo_decreased"] = elbo_decreased_column),
+      Rcpp::_["assignment"] = assignment,
+      Rcpp::_["paternity"] = paternity,
+      Rcpp::_["elbo"] = elbo
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::DataFrame power_analysis
+ (arma::uvec seeds,
+  arma::vec error_rates,
+  arma::uvec number_of_fathers,
+  std::vector<arma::vec> allele_frequencies,
+  const unsigned number_of_offspring = 20,
+  const double probability_of_missing_data = 0.,
+  const unsigned number_of_mcmc_samples = 1100,
+  const unsigned burn_in = 100,
+  const bool global_genotyping_error_rates = true,
+  const bool update_allele_frequencies = false,
+  const unsigned number_of_threads = 1)
+{
+  // simulate -> fit -> score for each combination of seed, error rate (used for both dropout and
+  // mistyping) and number of fathers. Colonies have a single sampled mother; one father sires all
+  // but (number_of_fathers - 1) offspring, the rest sire one offspring each. Each replicate has its
+  // own random number stream derived from its seed and design, so results do not depend on the
+  // number of threads
+  const unsigned number_of_loci = allele_frequencies.size();
+  const unsigned number_of_replicates = seeds.n_elem * error_rates.n_elem * number_of_fathers.n_elem;
+
+  if (number_of_loci < 1) Rcpp::stop("need at least one locus");
+  if (number_of_offspring < 1) Rcpp::stop("need at least one offspring");
+  if (arma::any(number_of_fathers < 1) || arma::any(number_of_fathers > number_of_offspring)) Rcpp::stop("number of fathers must be between 1 and number of offspring");
+  if (arma::any(error_rates <= 0.) || arma::any(error_rates > 0.5)) Rcpp::stop("error rates must be in (0, 0.5]");
+  if (probability_of_missing_data < 0. || probability_of_missing_data >= 1.) Rcpp::stop("probability of missing data must be in [0, 1)");
+  if (burn_in >= number_of_mcmc_samples) Rcpp::stop("burn in must be less than number of mcmc samples");
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+  for (auto& frequencies : allele_frequencies)
+  {
+    if (frequencies.n_elem < 1 || arma::any(frequencies < 0.) || arma::accu(frequencies) <= 0.) Rcpp::stop("invalid allele frequencies");
+  }
+
+  // design, with seed varying slowest
+  arma::umat design (3, number_of_replicates);
+  unsigned replicate = 0;
+  for (unsigned i=0; i<seeds.n_elem; ++i)
+  {
+    for (unsigned j=0; j<error_rates.n_elem; ++j)
+    {
+      for (unsigned k=0; k<number_of_fathers.n_elem; ++k)
+      {
+        design.col(replicate++) = arma::uvec({i, j, k});
+      }
+    }
+  }
+
+  arma::mat posterior_number_of_fathers (number_of_offspring, number_of_replicates, arma::fill::zeros);
+  arma::vec posterior_dropout_rate (number_of_replicates);
+  arma::vec posterior_mistyping_rate (number_of_replicates);
+  std::vector<std::string> replicate_errors (number_of_replicates);
+
+  // replicates may run off the main thread, where R's API is off limits: errors are stored per replicate
+  // and raised once the loop is done
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(number_of_threads)
+  #endif
+  for (int i=0; i<int(number_of_replicates); ++i)
+  {
+    try
+    {
+      const uint64_t seed = seeds[design.at(0,i)];
+      const double error_rate = error_rates[design.at(1,i)];
+      const unsigned fathers = number_of_fathers[design.at(2,i)];
+      random_number_generator rng (
+          splitmix64(splitmix64(splitmix64(seed) ^ design.at(1,i)) ^ fathers));
+
+      arma::mat offspring_per_mating (fathers, 1, arma::fill::ones);
+      offspring_per_mating.at(0,0) = number_of_offspring - (fathers - 1);
+      arma::vec error_rate_per_locus (number_of_loci); error_rate_per_locus.fill(error_rate);
+      simulated_colony colony = simulate_colony(rng, offspring_per_mating, allele_frequencies,
+          error_rate_per_locus, error_rate_per_locus, probability_of_missing_data, 0, 1);
+
+      sampler_instrumentation instrumentation (false);
+      paternity_posterior_samples samples =
+        sample_paternity_and_error_rates_from_joint_posterior(colony.phenotypes, 1, number_of_mcmc_samples,
+            global_genotyping_error_rates, 1., true, update_allele_frequencies, true, rng, instrumentation, false);
+
+      for (unsigned iter=burn_in; iter<number_of_mcmc_samples; ++iter)
+      {
+        posterior_number_of_fathers.at(samples.number_of_fathers[iter]-1, i) += 1.;
+      }
+      posterior_number_of_fathers.col(i) /= double(number_of_mcmc_samples - burn_in);
+      posterior_dropout_rate[i] = arma::mean(samples.dropout_rate.row(0).cols(burn_in, number_of_mcmc_samples-1));
+      posterior_mistyping_rate[i] = arma::mean(samples.mistyping_rate.row(0).cols(burn_in, number_of_mcmc_samples-1));
+    }
+    catch (const std::exception& error)
+    {
+      replicate_errors[i] = error.what();
+    }
+  }
+  for (unsigned i=0; i<number_of_replicates; ++i)
+  {
+    if (!replicate_errors[i].empty()) Rcpp::stop("replicate " + std::to_string(i+1) + ": " + replicate_errors[i]);
+  }
+
+  // one row per replicate and possible number of fathers
+  std::vector<double> seed_column, mistyping_column, dropout_column, post_prob_column, post_dropout_column, post_mistyping_column;
+  std::vector<int> truth_column, n_father_column;
+  for (unsigned i=0; i<number_of_replicates; ++i)
+  {
+    for (unsigned n=1; n<=number_of_offspring; ++n)
+    {
+      seed_column.push_back(double(seeds[design.at(0,i)]));
+      mistyping_column.push_back(error_rates[design.at(1,i)]);
+      dropout_column.push_back(error_rates[design.at(1,i)]);
+      truth_column.push_back(number_of_fathers[design.at(2,i)]);
+      n_father_column.push_back(n);
+      post_prob_column.push_back(posterior_number_of_fathers.at(n-1,i));
+      post_dropout_column.push_back(posterior_dropout_rate[i]);
+      post_mistyping_column.push_back(posterior_mistyping_rate[i]);
+    }
+  }
+
+  return Rcpp::DataFrame::create(
+      Rcpp::_["seed"] = seed_column,
+      Rcpp::_["mistyping"] = mistyping_column,
+      Rcpp::_["dropout"] = dropout_column,
+      Rcpp::_["truth"] = truth_column,
+      Rcpp::_["n_father"] = n_father_column,
+      Rcpp::_["post_prob"] = post_prob_column,
+      Rcpp::_["post_dropout"] = post_dropout_column,
+      Rcpp::_["post_mistyping"] = post_mistyping_column
+      );
 }
 
 // ------------------------- alternative implementation without DP ------------------------ //
@@ -932,18 +1825,14 @@ Rcpp::List sample_paternity_and_error_rates_from_joint_posterior
 // [[Rcpp::export]]
 arma::uvec sample_matrix (arma::mat probabilities)
 {
-  arma::uvec draw (2);
-  probabilities /= arma::accu(probabilities);
-  arma::vec row_sums = arma::sum(probabilities, 1);
-  draw[0] = sample(row_sums);
-  draw[1] = sample(arma::trans(probabilities.row(draw[0])));
-  return draw;
+  R_random_number_generator rng;
+  return sydneyPaternity::sample_matrix(probabilities, rng);
 }
 
 // [[Rcpp::export]]
 arma::ucube select_columns_from_cube (arma::ucube input, arma::uvec which)
 {
-  if (which.max() >= input.n_cols) Rcpp::stop("Out of column range");
+  if (which.max() >= input.n_cols) throw std::invalid_argument("Out of column range");
   arma::ucube output = input;
   arma::uvec drop = arma::regspace<arma::uvec>(0, input.n_cols-1);
   drop.shed_rows(which);
@@ -961,67 +1850,30 @@ double phenotype_error_model
 {
   // from Eqs 1 & 2 in Wang 2004 Genetics
 
-  if (phenotype.n_elem != genotype.n_elem) Rcpp::stop("Genotype and phenotype are different lengths");
-  if (phenotype.n_elem > 2) Rcpp::stop("Ploidy cannot be greater than two");
-  if (number_of_alleles == 1) return 1.; //monomorphic loci
-
-  const double e1 = dropout_rate;
-  const double e2 = mistyping_rate/double(number_of_alleles-1);
-  const double E2 = mistyping_rate;
-
-  const bool genotype_is_diploid = phenotype.n_elem == 2;
+  // the hot loops in the samplers call the primitives in mendelian.h directly
+  if (phenotype.n_elem != genotype.n_elem) throw std::invalid_argument("Genotype and phenotype are different lengths");
+  if (phenotype.n_elem > 2) throw std::invalid_argument("Ploidy cannot be greater than two");
 
-  if (genotype_is_diploid)
+  const sydneyPaternity::genotyping_error_rates rate (number_of_alleles, dropout_rate, mistyping_rate);
+  if (phenotype.n_elem == 2)
   {
-    const bool phenotype_is_homozygous = phenotype[0] == phenotype[1];
-    const bool genotype_is_homozygous = genotype[0] == genotype[1];
-    if (genotype_is_homozygous) 
-    {
-      if (phenotype_is_homozygous && phenotype[0] == genotype[0])
-      {
-        return std::pow(1.-E2, 2);
-      } else if ((phenotype[0] == genotype[0] && phenotype[1] != genotype[0]) || 
-          (phenotype[0] != genotype[0] && phenotype[1] == genotype[0]) ){
-        return 2.*e2*(1-E2);
-      } else if (phenotype[0] != genotype[0] && phenotype[1] != genotype[0]) {
-        return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
-      }  
-    } else {
-      if ( (phenotype[0] == genotype[0] && phenotype[1] == genotype[1]) ||
-          (phenotype[1] == genotype[0] && phenotype[0] == genotype[1]) )
-      {
-        return std::pow(1.-E2, 2) + std::pow(e2, 2) - 2.*e1*std::pow(1.-E2-e2, 2);
-      } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
-        return e2*(1.-E2) + e1*std::pow(1.-E2-e2, 2);
-      } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
-          phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
-        return (2.-int(phenotype_is_homozygous))*std::pow(e2, 2);
-      } else {
-        // Wang 2018 has (1-E2-e2) and Wang 2004 has (1-E2+e2), latter is correct
-        return e2*(1.-E2+e2);
-      }
-    }
+    return sydneyPaternity::diploid_phenotype_probability(phenotype[0], phenotype[1], genotype[0], genotype[1], rate);
   } else { // haploid, only mistyping errors
-    if (phenotype[0] == genotype[0])
-    {
-      return 1.-E2; // 1 - Pr(other allele) - Pr(other other allele) - ... = 1 - e2 - e2 - .... = 1 - prob of error
-    } else {
-      return e2; // Pr(other allele) = e2
-    }
+    return sydneyPaternity::haploid_phenotype_probability(phenotype[0], genotype[0], rate);
   }
-  return 0.;
 }
 
-// [[Rcpp::export]]
+template <class RNG>
 arma::uvec sample_phenotype_errors
  (const arma::uvec& phenotype,
   const arma::uvec& genotype,
   const unsigned& number_of_alleles,
   const double& dropout_rate, 
-  const double& mistyping_rate)
+  const double& mistyping_rate,
+  RNG& rng)
 {
-  if (phenotype.n_elem != genotype.n_elem) Rcpp::stop("Genotype and phenotype are different lengths");
-  if (phenotype.n_elem > 2) Rcpp::stop("Ploidy cannot be greater than two");
+  if (phenotype.n_elem != genotype.n_elem) throw std::invalid_argument("Genotype and phenotype are different lengths");
+  if (phenotype.n_elem > 2) throw std::invalid_argument("Ploidy cannot be greater than two");
   if (number_of_alleles == 1) return arma::zeros<arma::uvec>(phenotype.n_elem); // monomorphic loci
 
   const double e1 = dropout_rate;
@@ -1058,7 +1910,7 @@ arma::uvec sample_phenotype_errors
         // [0,0] [0,2] [1,1]
         const arma::vec probs = {(1-2*e1)*(1-E2)*(1-E2), (1-2*e1)*e2*e2, 4*e1*e2*(1-E2)};
         const arma::umat counts = {{0,0},{0,2},{1,1}};
-        return counts.row(sample(probs)).t();
+        return counts.row(rng.categorical(probs)).t();
       } else if (phenotype_is_homozygous && (phenotype[0] == genotype[0] || phenotype[0] == genotype[1])) {
         // one class 2 error OR there was a dropout error and no typing errors
         // prop.table(c(e1*(1-E2)^2, (1-2*e1)*e2*(1-E2), e1*e2*e2))
@@ -1067,7 +1919,7 @@ arma::uvec sample_phenotype_errors
         // [0 1] [1 0] [1 2]
         const arma::vec probs = {e1*(1-E2)*(1-E2), (1-2*e1)*e2*(1-E2), e1*e2*e2};
         const arma::umat counts = {{1,0},{0,1},{1,2}};
-        return counts.row(sample(probs)).t();
+        return counts.row(rng.categorical(probs)).t();
       } else if (phenotype[0] != genotype[0] && phenotype[0] != genotype[1] && 
           phenotype[1] != genotype[0] && phenotype[1] != genotype[1] ){
         // two class 2 errors occurred, regardless of whether class 1 error occurs
@@ -1075,7 +1927,7 @@ arma::uvec sample_phenotype_errors
         // [0 2] [1 2]
         const arma::vec probs = {(1-2*e1)*e2*e2, 2*e1*e2*e2};
         const arma::umat counts = {{0,2},{1,2}};
-        return counts.row(sample(probs)).t();
+        return counts.row(rng.categorical(probs)).t();
       } else {
         // "otherwise" ... there's one match but phenotype is heterozygous?
         // 1. could have: sequencing error at one, no sequencing error at other
@@ -1085,7 +1937,7 @@ arma::uvec sample_phenotype_errors
         // [0 1] [0 2] [1 1] [1 2]
         const arma::vec probs = {(1-2*e1)*e2*(1-E2), (1-2*e1)*e2*e2, 2*e1*e2*(1-E2), 2*e1*e2*e2};
         const arma::umat counts = {{0,1},{0,2},{1,1},{1,2}};
-        return counts.row(sample(probs)).t();
+        return counts.row(rng.categorical(probs)).t();
       }
     }
   } else {
@@ -1100,30 +1952,42 @@ arma::uvec sample_phenotype_errors
 }
 
 // [[Rcpp::export]]
-double mendelian_genotype_model
- (const arma::uvec& offspring_phenotype,
-  const arma::uvec& maternal_genotype,
-  const arma::uvec& paternal_genotype,
+arma::uvec sample_phenotype_errors
+ (const arma::uvec& phenotype,
+  const arma::uvec& genotype,
+  const unsigned& number_of_alleles,
+  const double& dropout_rate, 
+  const double& mistyping_rate)
+{
+  R_random_number_generator rng;
+  return sample_phenotype_errors(phenotype, genotype, number_of_alleles, dropout_rate, mistyping_rate, rng);
+}
+
+// [[Rcpp::export]]
+double mendelian_genotype_model
+ (const arma::uvec& offspring_phenotype,
+  const arma::uvec& maternal_genotype,
+  const arma::uvec& paternal_genotype,
   const unsigned& number_of_alleles,
   const double& dropout_rate, 
   const double& mistyping_rate)
 {
+  if (offspring_phenotype.n_elem > 2) throw std::invalid_argument("Ploidy cannot be greater than two");
   const bool offspring_is_haploid = offspring_phenotype.n_elem == 1;
-  arma::uvec offspring_genotype (offspring_phenotype.n_elem);
+  const sydneyPaternity::genotyping_error_rates rate (number_of_alleles, dropout_rate, mistyping_rate);
   double likelihood = 0.;
   unsigned number_of_possible_genotypes = 0;
   for (auto maternal_allele : maternal_genotype)
   {
-    offspring_genotype[0] = maternal_allele;
     if (offspring_is_haploid)
     {
-      likelihood += phenotype_error_model(offspring_phenotype, offspring_genotype, number_of_alleles, dropout_rate, mistyping_rate);
+      likelihood += sydneyPaternity::haploid_phenotype_probability(offspring_phenotype[0], maternal_allele, rate);
       number_of_possible_genotypes++;
     } else {
       for (auto paternal_allele : paternal_genotype)
       {
-        offspring_genotype[1] = paternal_allele;
-        likelihood += phenotype_error_model(offspring_phenotype, offspring_genotype, number_of_alleles, dropout_rate, mistyping_rate);
+        likelihood += sydneyPaternity::diploid_phenotype_probability(offspring_phenotype[0], offspring_phenotype[1], 
+            maternal_allele, paternal_allele, rate);
         number_of_possible_genotypes++;
       }
     }
@@ -1132,38 +1996,50 @@ double mendelian_genotype_model
   return likelihood;
 }
 
-// [[Rcpp::export]]
+template <class RNG>
 arma::uvec sample_mendelian_genotype
  (const arma::uvec& offspring_phenotype,
   const arma::uvec& maternal_genotype,
   const arma::uvec& paternal_genotype,
   const unsigned& number_of_alleles,
   const double& dropout_rate, 
-  const double& mistyping_rate)
+  const double& mistyping_rate,
+  RNG& rng)
 {
-  // this is poorly written, clean it up
+  // diploid mothers with haploid fathers (or haploid offspring) use the primitives in mendelian.h
+  if (offspring_phenotype.n_elem > 2) throw std::invalid_argument("Ploidy cannot be greater than two");
   const bool offspring_is_haploid = offspring_phenotype.n_elem == 1;
-  arma::uvec offspring_genotype (offspring_phenotype.n_elem);
+  const sydneyPaternity::genotyping_error_rates rate (number_of_alleles, dropout_rate, mistyping_rate);
+  if (maternal_genotype.n_elem == 2 && offspring_is_haploid)
+  {
+    return arma::uvec({sydneyPaternity::sample_haploid_mendelian_genotype(offspring_phenotype[0], 
+          maternal_genotype[0], maternal_genotype[1], rate, rng)});
+  }
+  if (maternal_genotype.n_elem == 2 && paternal_genotype.n_elem == 1)
+  {
+    const std::array<unsigned, 2> genotype = sydneyPaternity::sample_diploid_mendelian_genotype(offspring_phenotype[0], 
+        offspring_phenotype[1], maternal_genotype[0], maternal_genotype[1], paternal_genotype[0], rate, rng);
+    return arma::uvec({genotype[0], genotype[1]});
+  }
   arma::mat likelihood = offspring_is_haploid ? 
     arma::zeros(maternal_genotype.n_elem, 1) : 
     arma::zeros(maternal_genotype.n_elem, paternal_genotype.n_elem);
   for (unsigned maternal_allele=0; maternal_allele<maternal_genotype.n_elem; ++maternal_allele)
   {
-    offspring_genotype[0] = maternal_genotype[maternal_allele];
     if (offspring_is_haploid)
     {
-      likelihood.at(maternal_allele, 1) = 
-        phenotype_error_model(offspring_phenotype, offspring_genotype, number_of_alleles, dropout_rate, mistyping_rate);
+      likelihood.at(maternal_allele, 0) = 
+        sydneyPaternity::haploid_phenotype_probability(offspring_phenotype[0], maternal_genotype[maternal_allele], rate);
     } else {
       for (unsigned paternal_allele=0; paternal_allele<paternal_genotype.n_elem; ++paternal_allele)
       {
-        offspring_genotype[1] = paternal_genotype[paternal_allele];
         likelihood.at(maternal_allele, paternal_allele) =
-          phenotype_error_model(offspring_phenotype, offspring_genotype, number_of_alleles, dropout_rate, mistyping_rate);
+          sydneyPaternity::diploid_phenotype_probability(offspring_phenotype[0], offspring_phenotype[1], 
+              maternal_genotype[maternal_allele], paternal_genotype[paternal_allele], rate);
       }
     }
   }
-  arma::uvec new_phenotype = sample_matrix(likelihood).head(offspring_genotype.n_elem);
+  arma::uvec new_phenotype = sydneyPaternity::sample_matrix(likelihood, rng).head(offspring_phenotype.n_elem);
   new_phenotype[0] = maternal_genotype[new_phenotype[0]];
   if (!offspring_is_haploid)
   {
@@ -1173,34 +2049,61 @@ arma::uvec sample_mendelian_genotype
 }
 
 // [[Rcpp::export]]
-Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
- (arma::ucube phenotypes, 
-  arma::uvec mothers,
-  arma::uvec fathers,
-  arma::uvec holdouts,
-  const unsigned number_of_mcmc_samples = 1000,
-  const unsigned burn_in_samples = 100,
-  const unsigned thinning_interval = 1,
-  const bool global_genotyping_error_rates = true)
+arma::uvec sample_mendelian_genotype
+ (const arma::uvec& offspring_phenotype,
+  const arma::uvec& maternal_genotype,
+  const arma::uvec& paternal_genotype,
+  const unsigned& number_of_alleles,
+  const double& dropout_rate, 
+  const double& mistyping_rate)
 {
-  if (mothers.n_elem == 0 || fathers.n_elem == 0) Rcpp::stop("Must have at least one potential father and mother");
-  if (mothers.max() > phenotypes.n_cols || mothers.min() < 1) Rcpp::stop("1-based index of mothers out of range");
-  if (fathers.max() > phenotypes.n_cols || fathers.min() < 1) Rcpp::stop("1-based index of fathers out of range");
-  if (holdouts.max() > phenotypes.n_cols || holdouts.min() < 1) Rcpp::stop("1-based index of holdouts out of range");
-
-  //this way of specifying parental phenotypes could allow monoiecious mating systems in the future
-  mothers = arma::unique(mothers);
-  fathers = arma::unique(fathers);
-  holdouts = arma::unique(holdouts);
-  arma::uvec parents_and_holdouts = arma::unique(arma::join_vert(arma::join_vert(mothers, fathers), holdouts));
-  arma::uvec offspring = arma::regspace<arma::uvec>(1, phenotypes.n_cols);
-  offspring.shed_rows(parents_and_holdouts-1);
-  if (parents_and_holdouts.n_elem != holdouts.n_elem + mothers.n_elem + fathers.n_elem) Rcpp::stop("Overlap in mother/father/holdouts");
-  if (phenotypes.n_cols != offspring.n_elem + parents_and_holdouts.n_elem) Rcpp::stop("Splitting issues?");
+  R_random_number_generator rng;
+  return sample_mendelian_genotype(offspring_phenotype, maternal_genotype, paternal_genotype, 
+      number_of_alleles, dropout_rate, mistyping_rate, rng);
+}
 
-  // recode alleles to integers, split parental and offspring phenotypes
-  std::vector<arma::vec> allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, false);
-  mothers -= 1; fathers -= 1; holdouts -= 1; parents_and_holdouts -= 1; offspring -= 1; // convert to 0-based indices
+struct joint_posterior_samples
+{
+  arma::imat paternity;
+  arma::imat maternity;
+  arma::mat dropout_rate;
+  arma::mat mistyping_rate;
+  arma::mat dropout_errors;
+  arma::mat mistyping_errors;
+  std::vector<sydneyPaternity::genotype_counts> genotypes; //per locus, visits over the chain
+  std::vector<arma::mat> allele_frequencies;
+  arma::mat holdout_deviance;
+  arma::mat deviance;
+};
+
+template <class RNG>
+joint_posterior_samples sample_parentage_and_error_rates_from_joint_posterior
+ (const arma::ucube& phenotypes, 
+  std::vector<arma::vec> allele_frequencies,
+  const arma::uvec& mothers,
+  const arma::uvec& fathers,
+  const arma::uvec& holdouts,
+  const arma::uvec& offspring,
+  const unsigned number_of_mcmc_samples,
+  const unsigned burn_in_samples,
+  const unsigned thinning_interval,
+  const bool global_genotyping_error_rates,
+  RNG& rng,
+  sampler_instrumentation& instrumentation,
+  const bool verbose,
+  const unsigned number_of_threads = 1,
+  const unsigned mismatch_tolerance = 0,
+  const unsigned candidate_refresh_interval = 0)
+{
+  // "phenotypes" have alleles recoded by collapse_alleles_and_generate_genotype_prior, which
+  // also gives "allele_frequencies"; mothers, fathers, holdouts, offspring are sorted 0-based indices
+  // partitioning the columns. Inputs are checked by the caller, so that this may run outside of the
+  // main thread with a thread-local RNG. Parentage likelihoods are computed with "number_of_threads". If
+  // "candidate_refresh_interval" > 0, each offspring is scored only against pairs of parents with at most 
+  // "mismatch_tolerance" loci incompatible with its phenotype (see exclusion.h), refreshed every that many sweeps;
+  // an offspring with no such pairs is scored against all of them
+
+  // split parental and offspring phenotypes
   arma::ucube maternal_phenotypes = select_columns_from_cube(phenotypes, mothers); 
   arma::ucube paternal_phenotypes = select_columns_from_cube(phenotypes, fathers); 
   arma::ucube holdout_phenotypes = select_columns_from_cube(phenotypes, holdouts); 
@@ -1244,11 +2147,31 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
   for (unsigned locus=0; locus<num_loci; ++locus) allele_frequencies_samples.push_back(arma::zeros<arma::mat>(num_alleles[locus], max_iter));
   arma::mat dropout_error_expectation (num_samples, num_loci, arma::fill::zeros);
   arma::mat mistyping_error_expectation (num_samples, num_loci, arma::fill::zeros);
-  std::vector<arma::cube> genotypes_expectation;
+  std::vector<sydneyPaternity::genotype_counts> genotypes_expectation; //sparse, rather than alleles x alleles x samples
   for (unsigned locus=0; locus<num_loci; ++locus) 
   {
-    genotypes_expectation.push_back(arma::zeros<arma::cube>(num_alleles[locus], num_alleles[locus], num_samples));
+    genotypes_expectation.emplace_back(num_alleles[locus], num_samples);
+  }
+
+  // holdout phenotypes given each pair of parents: the class (genotyping_error_model_class) of each phenotype 
+  // given the genotypes (maternal allele, paternal allele) that the pair can transmit, for row 
+  // father + num_fathers * (mother + num_mothers * holdout). Classes depend only on parental genotypes, 
+  // so they are refreshed for parents whose genotypes changed since the last evaluation
+  const unsigned num_pairs = num_fathers * num_mothers;
+  arma::ucube holdout_error_class (num_pairs * num_holdouts, num_loci, 2, arma::fill::zeros);
+  arma::umat holdout_homozygous (num_holdouts, num_loci, arma::fill::zeros);
+  for (unsigned extra=0; extra<num_holdouts; ++extra)
+  {
+    for (unsigned locus=0; locus<num_loci; ++locus)
+    {
+      holdout_homozygous.at(extra, locus) = holdout_phenotypes.at(0, extra, locus) == holdout_phenotypes.at(1, extra, locus);
+    }
   }
+  arma::ucube cached_maternal_genotypes, cached_paternal_genotypes; //empty until first evaluation
+
+  // candidate pairs of parents for each offspring (father + num_fathers * mother), empty if all pairs are scored
+  std::vector<arma::uvec> candidate_pairs (num_offspring);
+  unsigned sweep = 0;
 
   // Gibbs sampler
   int start = -int(burn_in_samples);
@@ -1269,21 +2192,44 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
       arma::vec deviance (num_offspring, arma::fill::zeros);
       arma::vec holdout_deviance (num_holdouts, arma::fill::zeros);
 
-      // ------ sample maternal genotypes ------
-      for (unsigned mother=0; mother<num_mothers; ++mother)
+      // ------ sample parental genotypes ------
+      // given parentage, maternal genotypes are conditionally independent across mothers and loci given paternal
+      // genotypes, paternal genotypes given maternal ones, and offspring genotypes given parents; so each block is
+      // updated in parallel over (individual, locus), with a stream per task keyed by a seed drawn from "rng" once 
+      // per block, and draws do not depend on the number of threads
       {
-        arma::uvec children = arma::find(maternity == mother);
-        for (unsigned locus=0; locus<num_loci; ++locus)
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+        std::vector<arma::uvec> maternal_children (num_mothers), paternal_children (num_fathers);
+        for (unsigned mother=0; mother<num_mothers; ++mother) maternal_children[mother] = arma::find(maternity == mother);
+        for (unsigned father=0; father<num_fathers; ++father) paternal_children[father] = arma::find(paternity == father);
+
+        auto maternal_genotype_logprobabilities = [&] (const unsigned mother, const unsigned locus) -> arma::mat
         {
-          arma::mat maternal_genotype_probabilities(num_alleles[locus], num_alleles[locus]);
+          // phenotype probabilities of children given each maternal allele (and their father's allele) are 
+          // tabulated once, so that a maternal genotype (w, v) needs the average of two entries per child
+          const unsigned number_of_alleles = num_alleles[locus];
+          const sydneyPaternity::genotyping_error_rates rate (number_of_alleles, dropout_rate[locus], mistyping_rate[locus]);
+          const arma::uvec& children = maternal_children[mother];
+          arma::mat transmission (number_of_alleles, children.n_elem);
+          unsigned phenotyped_children = 0;
+          for (auto sib : children)
+          {
+            if (offspring_phenotypes.at(0, sib, locus))
+            {
+              sydneyPaternity::diploid_transmission_column(offspring_phenotypes.at(0, sib, locus), offspring_phenotypes.at(1, sib, locus),
+                  paternal_genotypes.at(0, paternity[sib], locus), number_of_alleles, rate, transmission.colptr(phenotyped_children++));
+            }
+          }
+
+          arma::mat maternal_genotype_probabilities(number_of_alleles, number_of_alleles);
           maternal_genotype_probabilities.fill(-arma::datum::inf);
-          for (unsigned first_allele=0; first_allele<num_alleles[locus]; first_allele++)
+          for (unsigned first_allele=0; first_allele<number_of_alleles; first_allele++)
           {
-            for (unsigned second_allele=first_allele; second_allele<num_alleles[locus]; second_allele++)
+            for (unsigned second_allele=first_allele; second_allele<number_of_alleles; second_allele++)
             {
               // hardy-weinberg prior
-              arma::uvec maternal_genotype ({first_allele+1, second_allele+1}); // 1-based allele indexing
-              maternal_genotype_probabilities.at(first_allele, second_allele) = 
+              double& log_probability = maternal_genotype_probabilities.at(first_allele, second_allele);
+              log_probability = 
                 log(2. - int(first_allele == second_allele)) +
                 log(allele_frequencies[locus].at(first_allele)) + 
                 log(allele_frequencies[locus].at(second_allele)); 
@@ -1291,213 +2237,379 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
               // phenotype likelihoods
               if (maternal_phenotypes.at(0, mother, locus))
               {
-                maternal_genotype_probabilities.at(first_allele, second_allele) += 
-                  log(phenotype_error_model(maternal_phenotypes.slice(locus).col(mother), maternal_genotype,
-                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                log_probability += log(sydneyPaternity::diploid_phenotype_probability(maternal_phenotypes.at(0, mother, locus), 
+                      maternal_phenotypes.at(1, mother, locus), first_allele+1, second_allele+1, rate)); // 1-based allele indexing
               }
-              for (auto sib : children)
+              for (unsigned child=0; child<phenotyped_children; ++child)
               {
-                if (offspring_phenotypes.at(0, sib, locus))
-                {
-                  maternal_genotype_probabilities.at(first_allele, second_allele) += 
-                    log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), maternal_genotype,
-                          paternal_genotypes.slice(locus).col(paternity[sib]), 
-                          num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
-                }
+                log_probability += log(0.5 * transmission.at(first_allele, child) + 0.5 * transmission.at(second_allele, child));
               }
             }
           }
-          arma::uvec new_alleles = sample_matrix(arma::exp(maternal_genotype_probabilities - maternal_genotype_probabilities.max()));
-          for (unsigned i=0; i<2; ++i)
-          {
-            allele_counts[locus].at(new_alleles[i])++;
-            maternal_genotypes.at(i, mother, locus) = new_alleles[i] + 1; //1-based allele indexing
-          }
-        }
-      }
+          return maternal_genotype_probabilities - maternal_genotype_probabilities.max();
+        };
 
-      // ------ sample paternal genotypes ------ 
-      for (unsigned father=0; father<num_fathers; ++father)
-      {
-        arma::uvec children = arma::find(paternity == father);
-        for (unsigned locus=0; locus<num_loci; ++locus)
+        auto paternal_genotype_logprobabilities = [&] (const unsigned father, const unsigned locus) -> arma::vec
         {
+          const sydneyPaternity::genotyping_error_rates rate (num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
           arma::vec paternal_genotype_probabilities(num_alleles[locus]);
           paternal_genotype_probabilities.fill(-arma::datum::inf);
           for (unsigned first_allele=0; first_allele<num_alleles[locus]; first_allele++)
           {
             // hardy-weinberg prior
-            arma::uvec paternal_genotype ({first_allele + 1}); // 1-based allele indexing
             paternal_genotype_probabilities.at(first_allele) = log(allele_frequencies[locus].at(first_allele)); 
 
             // phenotype likelihoods
             if (paternal_phenotypes.at(0, father, locus))
             {
               paternal_genotype_probabilities.at(first_allele) += 
-                log(phenotype_error_model(paternal_phenotypes.slice(locus).col(father), paternal_genotype,
-                      num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                log(sydneyPaternity::haploid_phenotype_probability(paternal_phenotypes.at(0, father, locus), 
+                      first_allele+1, rate)); // 1-based allele indexing
             }
-            for (auto sib : children)
+            for (auto sib : paternal_children[father])
             {
               if (offspring_phenotypes.at(0, sib, locus))
               {
                 paternal_genotype_probabilities.at(first_allele) += 
-                  log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), 
-                        maternal_genotypes.slice(locus).col(maternity[sib]), paternal_genotype,
-                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                  log(sydneyPaternity::diploid_mendelian_probability(offspring_phenotypes.at(0, sib, locus), 
+                        offspring_phenotypes.at(1, sib, locus), maternal_genotypes.at(0, maternity[sib], locus), 
+                        maternal_genotypes.at(1, maternity[sib], locus), first_allele+1, rate));
               }
             }
           }
-          unsigned new_allele = sample(arma::exp(paternal_genotype_probabilities - paternal_genotype_probabilities.max()));
-          allele_counts[locus].at(new_allele)++;
+          return paternal_genotype_probabilities - paternal_genotype_probabilities.max();
+        };
+
+        const uint64_t maternal_seed = sydneyPaternity::random_seed(rng);
+        run_parallel_tasks(num_mothers*num_loci, number_of_threads, [&] (const unsigned task)
+        {
+          const unsigned mother = task % num_mothers, locus = task / num_mothers;
+          stream_random_number_generator task_rng (maternal_seed, task);
+          arma::uvec new_alleles = sydneyPaternity::sample_matrix(
+              arma::exp(maternal_genotype_logprobabilities(mother, locus)), task_rng);
+          for (unsigned i=0; i<2; ++i) maternal_genotypes.at(i, mother, locus) = new_alleles[i] + 1; //1-based allele indexing
+        });
+        const uint64_t paternal_seed = sydneyPaternity::random_seed(rng);
+        run_parallel_tasks(num_fathers*num_loci, number_of_threads, [&] (const unsigned task)
+        {
+          const unsigned father = task % num_fathers, locus = task / num_fathers;
+          stream_random_number_generator task_rng (paternal_seed, task);
+          unsigned new_allele = sydneyPaternity::sample_log_categorical(paternal_genotype_logprobabilities(father, locus), task_rng);
           paternal_genotypes.at(0, father, locus) = new_allele + 1; // 1-based allele indexing
+        });
+
+        // allele counts are tallied after the parental blocks, so that tasks don't share counters
+        for (unsigned locus=0; locus<num_loci; ++locus)
+        {
+          for (unsigned mother=0; mother<num_mothers; ++mother)
+          {
+            for (unsigned i=0; i<2; ++i) allele_counts[locus].at(maternal_genotypes.at(i, mother, locus) - 1)++;
+          }
+          for (unsigned father=0; father<num_fathers; ++father)
+          {
+            allele_counts[locus].at(paternal_genotypes.at(0, father, locus) - 1)++;
+          }
         }
       }
 
       // ------ sample allele frequencies ------
-      for (unsigned locus=0; locus<num_loci; ++locus)
       {
-        for (unsigned allele=0; allele<num_alleles[locus]; ++allele)
+        phase_timer timer (instrumentation, ALLELE_FREQUENCY_UPDATE);
+        for (unsigned locus=0; locus<num_loci; ++locus)
         {
-          allele_frequencies[locus][allele] = R::rgamma(1. + allele_counts[locus][allele], 1.);
+          for (unsigned allele=0; allele<num_alleles[locus]; ++allele)
+          {
+            allele_frequencies[locus][allele] = 1. + allele_counts[locus][allele];
+          }
+          sydneyPaternity::sample_dirichlet(allele_frequencies[locus].memptr(), num_alleles[locus], 
+              allele_frequencies[locus].memptr(), rng); //in place
         }
-        allele_frequencies[locus] /= arma::accu(allele_frequencies[locus]);
       }
 
       // ------ sample offspring genotypes ------
-      for (unsigned sib=0; sib<num_offspring; ++sib)
       {
+        phase_timer timer (instrumentation, DATA_AUGMENTATION);
+        const uint64_t offspring_seed = sydneyPaternity::random_seed(rng);
+        run_parallel_tasks(num_offspring*num_loci, number_of_threads, [&] (const unsigned task)
+        {
+          const unsigned sib = task % num_offspring, locus = task / num_offspring;
+          stream_random_number_generator task_rng (offspring_seed, task);
+          const sydneyPaternity::genotyping_error_rates rate (num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+          const unsigned mother = maternity[sib], father = paternity[sib];
+          const std::array<unsigned, 2> genotype = 
+            sydneyPaternity::sample_diploid_mendelian_genotype(offspring_phenotypes.at(0, sib, locus), offspring_phenotypes.at(1, sib, locus),
+                maternal_genotypes.at(0, mother, locus), maternal_genotypes.at(1, mother, locus), 
+                paternal_genotypes.at(0, father, locus), rate, task_rng);
+          offspring_genotypes.at(0, sib, locus) = genotype[0];
+          offspring_genotypes.at(1, sib, locus) = genotype[1];
+        });
+
+        // ------ sample errors and error rates ------ 
         for (unsigned locus=0; locus<num_loci; ++locus)
         {
-          offspring_genotypes.slice(locus).col(sib) = 
-            sample_mendelian_genotype(offspring_phenotypes.slice(locus).col(sib), 
-                maternal_genotypes.slice(locus).col(maternity[sib]), 
-                paternal_genotypes.slice(locus).col(paternity[sib]), 
-                num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+          // maternal phenotyping errors
+          for (unsigned mother=0; mother<num_mothers; ++mother)
+          {
+            if (maternal_phenotypes.at(0,mother,locus))
+            {
+              num_phenotyped_alleles.at(locus) += 2;
+              num_heterozygotes.at(locus) += int(maternal_genotypes.at(0,mother,locus) != maternal_genotypes.at(1,mother,locus));
+              arma::uvec phenotyping_errors = 
+                sample_phenotype_errors(maternal_phenotypes.slice(locus).col(mother),
+                                        maternal_genotypes.slice(locus).col(mother),
+                                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus], rng);
+              maternal_dropout_errors.at(mother, locus) += phenotyping_errors[0];
+              maternal_mistyping_errors.at(mother, locus) += phenotyping_errors[1];
+            }
+          }
+
+          // paternal phenotyping errors
+          for (unsigned father=0; father<num_fathers; ++father)
+          {
+            if (paternal_phenotypes.at(0,father,locus))
+            {
+              num_phenotyped_alleles.at(locus) += 1;
+              arma::uvec phenotyping_errors = 
+                sample_phenotype_errors(paternal_phenotypes.slice(locus).col(father),
+                                        paternal_genotypes.slice(locus).col(father),
+                                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus], rng);
+              paternal_dropout_errors.at(father, locus) += phenotyping_errors[0];
+              paternal_mistyping_errors.at(father, locus) += phenotyping_errors[1];
+            }
+          }
+
+          // offspring phenotyping errors
+          for (unsigned sib=0; sib<num_offspring; ++sib)
+          {
+            if (offspring_phenotypes.at(0,sib,locus))
+            {
+              num_phenotyped_alleles.at(locus) += 2;
+              num_heterozygotes.at(locus) += int(offspring_genotypes.at(0,sib,locus) != offspring_genotypes.at(1,sib,locus));
+              arma::uvec phenotyping_errors = 
+                sample_phenotype_errors(offspring_phenotypes.slice(locus).col(sib),
+                                        offspring_genotypes.slice(locus).col(sib),
+                                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus], rng);
+              offspring_dropout_errors.at(sib, locus) += phenotyping_errors[0];
+              offspring_mistyping_errors.at(sib, locus) += phenotyping_errors[1];
+            }
+          }
+
+          // update error rates
+          unsigned dropout_errors = arma::accu(offspring_dropout_errors.col(locus)) +
+            arma::accu(maternal_dropout_errors.col(locus)) + arma::accu(paternal_dropout_errors.col(locus));
+          unsigned mistyping_errors = arma::accu(offspring_mistyping_errors.col(locus)) +
+            arma::accu(maternal_mistyping_errors.col(locus)) + arma::accu(paternal_mistyping_errors.col(locus));
+          dropout_rate[locus] = 0.5 * rng.beta(1. + dropout_errors, 1. + num_heterozygotes[locus] - dropout_errors);
+          mistyping_rate[locus] = rng.beta(1. + mistyping_errors, 1. + num_phenotyped_alleles[locus] - mistyping_errors);
+        }
+        if (global_genotyping_error_rates) // overwrite per-locus rates with global rate
+        {
+          unsigned dropout_errors = arma::accu(offspring_dropout_errors) +
+            arma::accu(maternal_dropout_errors) + arma::accu(paternal_dropout_errors);
+          unsigned mistyping_errors = arma::accu(offspring_mistyping_errors) +
+            arma::accu(maternal_mistyping_errors) + arma::accu(paternal_mistyping_errors);
+          dropout_rate.fill(0.5 * rng.beta(1. + dropout_errors, 1. + arma::accu(num_heterozygotes) - dropout_errors));
+          mistyping_rate.fill(rng.beta(1. + mistyping_errors, 1. + arma::accu(num_phenotyped_alleles) - mistyping_errors));
         }
       }
 
-      // ------ sample errors and error rates ------ 
-      for (unsigned locus=0; locus<num_loci; ++locus)
+      // ------ sample parentage ------
+      // the log likelihood of an offspring given a pair of parents is a sum over loci of entries in a table of 
+      // log P(phenotype | maternal genotype, paternal allele), over the distinct genotypes that candidate parents 
+      // currently have; so there are at most (distinct maternal genotypes x alleles) logs per offspring and locus,
+      // however many candidate fathers. Likelihoods for offspring are computed in parallel, then sampled in order
       {
-        // maternal phenotyping errors
-        for (unsigned mother=0; mother<num_mothers; ++mother)
+        phase_timer timer (instrumentation, PARENTAGE_UPDATE);
+        const arma::cube error_probability = genotyping_error_model_class_table(num_alleles, dropout_rate, mistyping_rate);
+        arma::umat maternal_genotype_index (num_mothers, num_loci);
+        arma::umat paternal_genotype_index (num_fathers, num_loci);
+        std::vector<arma::umat> distinct_maternal_genotypes (num_loci); //2 x distinct, first <= second
+        std::vector<arma::uvec> distinct_paternal_alleles (num_loci);
+        for (unsigned locus=0; locus<num_loci; ++locus)
         {
-          if (maternal_phenotypes.at(0,mother,locus))
+          const unsigned unseen = num_mothers + num_fathers;
+          arma::umat genotype_to_index (num_alleles[locus]+1, num_alleles[locus]+1); genotype_to_index.fill(unseen);
+          std::vector<arma::uword> first_alleles, second_alleles;
+          for (unsigned mother=0; mother<num_mothers; ++mother)
           {
-            num_phenotyped_alleles.at(locus) += 2;
-            num_heterozygotes.at(locus) += int(maternal_genotypes.at(0,mother,locus) != maternal_genotypes.at(1,mother,locus));
-            arma::uvec phenotyping_errors = 
-              sample_phenotype_errors(maternal_phenotypes.slice(locus).col(mother),
-                                      maternal_genotypes.slice(locus).col(mother),
-                                      num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
-            maternal_dropout_errors.at(mother, locus) += phenotyping_errors[0];
-            maternal_mistyping_errors.at(mother, locus) += phenotyping_errors[1];
+            const arma::uword first = std::min(maternal_genotypes.at(0, mother, locus), maternal_genotypes.at(1, mother, locus));
+            const arma::uword second = std::max(maternal_genotypes.at(0, mother, locus), maternal_genotypes.at(1, mother, locus));
+            if (genotype_to_index.at(first, second) == unseen)
+            {
+              genotype_to_index.at(first, second) = first_alleles.size();
+              first_alleles.push_back(first);
+              second_alleles.push_back(second);
+            }
+            maternal_genotype_index.at(mother, locus) = genotype_to_index.at(first, second);
+          }
+          distinct_maternal_genotypes[locus] = arma::join_vert(arma::urowvec(first_alleles), arma::urowvec(second_alleles));
+
+          arma::uvec allele_to_index (num_alleles[locus]+1); allele_to_index.fill(unseen);
+          std::vector<arma::uword> alleles;
+          for (unsigned father=0; father<num_fathers; ++father)
+          {
+            const arma::uword allele = paternal_genotypes.at(0, father, locus);
+            if (allele_to_index[allele] == unseen)
+            {
+              allele_to_index[allele] = alleles.size();
+              alleles.push_back(allele);
+            }
+            paternal_genotype_index.at(father, locus) = allele_to_index[allele];
           }
+          distinct_paternal_alleles[locus] = arma::uvec(alleles);
         }
 
-        // paternal phenotyping errors
-        for (unsigned father=0; father<num_fathers; ++father)
+        auto transmission_table = [&] (const unsigned sib, const unsigned locus, arma::mat& transmission)
         {
-          if (paternal_phenotypes.at(0,father,locus))
+          // log P(phenotype | distinct maternal genotype, distinct paternal allele), into a caller-owned buffer
+          const arma::uvec offspring_phenotype = offspring_phenotypes.slice(locus).col(sib);
+          const unsigned homozygous = offspring_phenotype[0] == offspring_phenotype[1];
+          const arma::umat& maternal = distinct_maternal_genotypes[locus];
+          const arma::uvec& paternal = distinct_paternal_alleles[locus];
+          transmission.set_size(maternal.n_cols, paternal.n_elem);
+          for (unsigned j=0; j<paternal.n_elem; ++j)
           {
-            num_phenotyped_alleles.at(locus) += 1;
-            arma::uvec phenotyping_errors = 
-              sample_phenotype_errors(paternal_phenotypes.slice(locus).col(father),
-                                      paternal_genotypes.slice(locus).col(father),
-                                      num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
-            paternal_dropout_errors.at(father, locus) += phenotyping_errors[0];
-            paternal_mistyping_errors.at(father, locus) += phenotyping_errors[1];
+            for (unsigned i=0; i<maternal.n_cols; ++i)
+            {
+              transmission.at(i, j) = log( // Mendelian segregation probs * phenotype probabilities
+                  0.5 * error_probability.at(genotyping_error_model_class(offspring_phenotype, maternal.at(0, i), paternal[j]), homozygous, locus) +
+                  0.5 * error_probability.at(genotyping_error_model_class(offspring_phenotype, maternal.at(1, i), paternal[j]), homozygous, locus));
+            }
           }
-        }
+        };
 
-        // offspring phenotyping errors
-        for (unsigned sib=0; sib<num_offspring; ++sib)
+        // with exclusion, offspring are scored only against pairs with few Mendelian mismatches,
+        // given parental genotypes when the candidate lists were last refreshed
+        if (candidate_refresh_interval > 0 && sweep % candidate_refresh_interval == 0)
         {
-          if (offspring_phenotypes.at(0,sib,locus))
+          const sydneyPaternity::parent_exclusion_index exclusion (maternal_genotypes, paternal_genotypes, num_alleles);
+          for (unsigned sib=0; sib<num_offspring; ++sib)
           {
-            num_phenotyped_alleles.at(locus) += 2;
-            num_heterozygotes.at(locus) += int(offspring_genotypes.at(0,sib,locus) != offspring_genotypes.at(1,sib,locus));
-            arma::uvec phenotyping_errors = 
-              sample_phenotype_errors(offspring_phenotypes.slice(locus).col(sib),
-                                      offspring_genotypes.slice(locus).col(sib),
-                                      num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
-            offspring_dropout_errors.at(sib, locus) += phenotyping_errors[0];
-            offspring_mistyping_errors.at(sib, locus) += phenotyping_errors[1];
+            const arma::umat offspring_phenotype = offspring_phenotypes.tube(arma::span::all, arma::span(sib));
+            candidate_pairs[sib] = exclusion.candidates(offspring_phenotype, mismatch_tolerance);
           }
         }
+        sweep++;
 
-        // update error rates
-        unsigned dropout_errors = arma::accu(offspring_dropout_errors.col(locus)) +
-          arma::accu(maternal_dropout_errors.col(locus)) + arma::accu(paternal_dropout_errors.col(locus));
-        unsigned mistyping_errors = arma::accu(offspring_mistyping_errors.col(locus)) +
-          arma::accu(maternal_mistyping_errors.col(locus)) + arma::accu(paternal_mistyping_errors.col(locus));
-        dropout_rate[locus] = 0.5 * R::rbeta(1. + dropout_errors, 1. + num_heterozygotes[locus] - dropout_errors);
-        mistyping_rate[locus] = R::rbeta(1. + mistyping_errors, 1. + num_phenotyped_alleles[locus] - mistyping_errors);
-      }
-      if (global_genotyping_error_rates) // overwrite per-locus rates with global rate
-      {
-        unsigned dropout_errors = arma::accu(offspring_dropout_errors) +
-          arma::accu(maternal_dropout_errors) + arma::accu(paternal_dropout_errors);
-        unsigned mistyping_errors = arma::accu(offspring_mistyping_errors) +
-          arma::accu(maternal_mistyping_errors) + arma::accu(paternal_mistyping_errors);
-        dropout_rate.fill(0.5 * R::rbeta(1. + dropout_errors, 1. + arma::accu(num_heterozygotes) - dropout_errors));
-        mistyping_rate.fill(R::rbeta(1. + mistyping_errors, 1. + arma::accu(num_phenotyped_alleles) - mistyping_errors));
-      }
-
-      // ------ sample parentage ------
-      for (unsigned sib=0; sib<num_offspring; ++sib)
-      {
-        arma::mat log_likelihood (num_fathers, num_mothers, arma::fill::zeros);
-        for (unsigned father=0; father<num_fathers; ++father)
+        // offspring are scored in parallel a block at a time and then sampled in order, so that only one block
+        // of likelihoods (fathers x mothers, or candidate pairs, per offspring) is held at once
+        const unsigned block_size = std::min(4 * number_of_threads, num_offspring);
+        std::vector<arma::mat> parentage_log_likelihood (block_size);
+        for (unsigned first=0; first<num_offspring; first+=block_size)
         {
-          for (unsigned mother=0; mother<num_mothers; ++mother)
+          const unsigned last = std::min(first + block_size, num_offspring);
+          run_parallel_tasks(last - first, number_of_threads, [&] (const unsigned task)
           {
+            const unsigned sib = first + task;
+            const arma::uvec& pairs = candidate_pairs[sib];
+            arma::mat& log_likelihood = parentage_log_likelihood[task];
+            if (pairs.n_elem) log_likelihood.zeros(pairs.n_elem, 1); else log_likelihood.zeros(num_fathers, num_mothers);
+            arma::mat transmission;
             for (unsigned locus=0; locus<num_loci; ++locus)
             {
-              if (offspring_phenotypes.at(0, sib, locus))
+              if (!offspring_phenotypes.at(0, sib, locus)) continue;
+              transmission_table(sib, locus, transmission);
+              if (pairs.n_elem)
               {
-                log_likelihood.at(father, mother) += 
-                      log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), 
-                                                   maternal_genotypes.slice(locus).col(mother),
-                                                   paternal_genotypes.slice(locus).col(father),
-                                                   num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                for (unsigned k=0; k<pairs.n_elem; ++k)
+                {
+                  log_likelihood.at(k) += transmission.at(maternal_genotype_index.at(pairs[k] / num_fathers, locus), 
+                      paternal_genotype_index.at(pairs[k] % num_fathers, locus));
+                }
+              } else {
+                for (unsigned mother=0; mother<num_mothers; ++mother)
+                {
+                  const unsigned i = maternal_genotype_index.at(mother, locus);
+                  for (unsigned father=0; father<num_fathers; ++father)
+                  {
+                    log_likelihood.at(father, mother) += transmission.at(i, paternal_genotype_index.at(father, locus));
+                  }
+                }
               }
             }
+          });
+          for (unsigned sib=first; sib<last; ++sib)
+          {
+            const arma::mat& log_likelihood = parentage_log_likelihood[sib - first];
+            instrumentation.increment(CANDIDATE_LABELS, log_likelihood.n_elem);
+            instrumentation.increment(LIKELIHOOD_EVALUATIONS, log_likelihood.n_elem * num_loci);
+            if (candidate_pairs[sib].n_elem)
+            {
+              const unsigned k = sydneyPaternity::sample_log_categorical(log_likelihood.memptr(), log_likelihood.n_elem, rng);
+              paternity[sib] = candidate_pairs[sib][k] % num_fathers;
+              maternity[sib] = candidate_pairs[sib][k] / num_fathers;
+              deviance.at(sib) = log_likelihood.at(k);
+            } else {
+              arma::uvec new_parentage = sydneyPaternity::sample_matrix(arma::exp(log_likelihood - log_likelihood.max()), rng);
+              paternity[sib] = new_parentage[0];
+              maternity[sib] = new_parentage[1];
+              deviance.at(sib) = log_likelihood.at(paternity[sib], maternity[sib]);
+            }
           }
         }
-        arma::uvec new_parentage = sample_matrix(arma::exp(log_likelihood - log_likelihood.max()));
-        paternity[sib] = new_parentage[0];
-        maternity[sib] = new_parentage[1];
-        deviance.at(sib) = log_likelihood.at(paternity[sib], maternity[sib]);
       }
 
       if (thin == 0 && iter >= 0)
       {
+        phase_timer timer (instrumentation, STORAGE);
         // calculate posterior predictive on holdout set
-        for (unsigned extra=0; extra<num_holdouts; ++extra)
+        if (num_holdouts > 0)
         {
-          arma::mat posterior_predictive (num_fathers, num_mothers, arma::fill::zeros);
-          for (unsigned father=0; father<num_fathers; ++father)
+          const bool refresh_all = cached_maternal_genotypes.is_empty();
+          for (unsigned locus=0; locus<num_loci; ++locus)
           {
             for (unsigned mother=0; mother<num_mothers; ++mother)
             {
-              for (unsigned locus=0; locus<num_loci; ++locus)
+              const bool mother_changed = refresh_all ||
+                maternal_genotypes.at(0, mother, locus) != cached_maternal_genotypes.at(0, mother, locus) ||
+                maternal_genotypes.at(1, mother, locus) != cached_maternal_genotypes.at(1, mother, locus);
+              for (unsigned father=0; father<num_fathers; ++father)
               {
-                if (holdout_phenotypes.at(0, extra, locus))
+                const bool father_changed = refresh_all ||
+                  paternal_genotypes.at(0, father, locus) != cached_paternal_genotypes.at(0, father, locus);
+                if (!mother_changed && !father_changed)
                 {
-                  posterior_predictive.at(father, mother) += 
-                    log(mendelian_genotype_model(holdout_phenotypes.slice(locus).col(extra), 
-                          maternal_genotypes.slice(locus).col(mother),
-                          paternal_genotypes.slice(locus).col(father),
-                          num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                  instrumentation.increment(CACHE_HITS, num_holdouts);
+                  continue;
+                }
+                for (unsigned extra=0; extra<num_holdouts; ++extra)
+                {
+                  if (!holdout_phenotypes.at(0, extra, locus)) continue; //class 0, missing
+                  const unsigned row = father + num_fathers * (mother + num_mothers * extra);
+                  const arma::uvec holdout_phenotype = holdout_phenotypes.slice(locus).col(extra);
+                  for (unsigned i=0; i<2; ++i)
+                  {
+                    holdout_error_class.at(row, locus, i) = genotyping_error_model_class(holdout_phenotype, 
+                        maternal_genotypes.at(i, mother, locus), paternal_genotypes.at(0, father, locus));
+                  }
                 }
               }
             }
           }
-          holdout_deviance.at(extra) = 
-            log(arma::accu(arma::exp(posterior_predictive - posterior_predictive.max()))) + 
-            posterior_predictive.max() - log(posterior_predictive.n_elem);
+          cached_maternal_genotypes = maternal_genotypes;
+          cached_paternal_genotypes = paternal_genotypes;
+
+          // phenotype probabilities by class, phenotype homozygosity, locus, at the current error rates
+          const arma::cube error_probability = genotyping_error_model_class_table(num_alleles, dropout_rate, mistyping_rate);
+          arma::mat holdout_log_emission (num_pairs * num_holdouts, num_loci);
+          for (unsigned locus=0; locus<num_loci; ++locus)
+          {
+            for (unsigned row=0; row<holdout_log_emission.n_rows; ++row)
+            {
+              const unsigned homozygous = holdout_homozygous.at(row / num_pairs, locus);
+              holdout_log_emission.at(row, locus) = log( // Mendelian segregation probs * phenotype probabilities
+                  0.5 * error_probability.at(holdout_error_class.at(row, locus, 0), homozygous, locus) +
+                  0.5 * error_probability.at(holdout_error_class.at(row, locus, 1), homozygous, locus));
+            }
+          }
+          const arma::vec posterior_predictive = arma::sum(holdout_log_emission, 1); //over loci
+          for (unsigned extra=0; extra<num_holdouts; ++extra)
+          {
+            const arma::vec pair_predictive = posterior_predictive.subvec(num_pairs*extra, num_pairs*(extra+1)-1);
+            holdout_deviance.at(extra) = 
+              log(arma::accu(arma::exp(pair_predictive - pair_predictive.max()))) + 
+              pair_predictive.max() - log(pair_predictive.n_elem);
+          }
         }
 
         // store state, mapping samples back to original indicies
@@ -1510,22 +2622,22 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
           {
             dropout_error_expectation.at(mothers[mother], locus) += maternal_dropout_errors.at(mother, locus)/double(max_iter);
             mistyping_error_expectation.at(mothers[mother], locus) += maternal_mistyping_errors.at(mother, locus)/double(max_iter);
-            genotypes_expectation[locus].at(maternal_genotypes.at(0, mother, locus)-1, 
-                maternal_genotypes.at(1, mother, locus)-1, mothers[mother]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(mothers[mother], maternal_genotypes.at(0, mother, locus), 
+                maternal_genotypes.at(1, mother, locus));
           }
           for (unsigned father=0; father<num_fathers; ++father)
           {
             dropout_error_expectation.at(fathers[father], locus) += paternal_dropout_errors.at(father, locus)/double(max_iter);
             mistyping_error_expectation.at(fathers[father], locus) += paternal_mistyping_errors.at(father, locus)/double(max_iter);
-            genotypes_expectation[locus].at(paternal_genotypes.at(0, father, locus)-1, 
-                paternal_genotypes.at(0, father, locus)-1, fathers[father]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(fathers[father], paternal_genotypes.at(0, father, locus), 
+                paternal_genotypes.at(0, father, locus));
           }
           for (unsigned sib=0; sib<num_offspring; ++sib)
           {
             dropout_error_expectation.at(offspring[sib], locus) += offspring_dropout_errors.at(sib, locus)/double(max_iter);
             mistyping_error_expectation.at(offspring[sib], locus) += offspring_mistyping_errors.at(sib, locus)/double(max_iter);
-            genotypes_expectation[locus].at(offspring_genotypes.at(0, sib, locus)-1, 
-                offspring_genotypes.at(1, sib, locus)-1, offspring[sib]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(offspring[sib], offspring_genotypes.at(0, sib, locus), 
+                offspring_genotypes.at(1, sib, locus));
           }
         }
         for (unsigned sib=0; sib<num_offspring; ++sib)
@@ -1540,40 +2652,213 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
         }
 
         // progress
-        if (iter % 100 == 0) Rcpp::Rcout << "[" << iter << "] " << "deviance: " << arma::accu(deviance) << std::endl;
+        if (verbose && iter % 100 == 0) Rcpp::Rcout << "[" << iter << "] " << "deviance: " << arma::accu(deviance) << std::endl;
       }
     }
   }
 
-  // Rcpp collapses dimensions for elements in std::vector, so copy these over to Rcpp::List
-  Rcpp::List genotypes_expectation_wrapped = Rcpp::List::create();
-  Rcpp::List allele_frequencies_samples_wrapped = Rcpp::List::create();
-  for (unsigned locus=0; locus<num_loci; ++locus) {
-    genotypes_expectation_wrapped.push_back(genotypes_expectation[locus]);
-    allele_frequencies_samples_wrapped.push_back(allele_frequencies_samples[locus]);
-  }
-
-  return Rcpp::List::create(
-    Rcpp::_["paternity"] = paternity_samples,
-    Rcpp::_["maternity"] = maternity_samples,
-    Rcpp::_["dropout_rate"] = dropout_rate_samples,
-    Rcpp::_["mistyping_rate"] = mistyping_rate_samples,
-    Rcpp::_["dropout_errors"] = dropout_error_expectation,
-    Rcpp::_["mistyping_errors"] = mistyping_error_expectation,
-    Rcpp::_["genotypes"] = genotypes_expectation_wrapped,
-    Rcpp::_["allele_frequencies"] = allele_frequencies_samples_wrapped,
-    Rcpp::_["holdout_deviance"] = holdout_deviance_samples,
-    Rcpp::_["deviance"] = deviance_samples);
+  joint_posterior_samples samples;
+  samples.paternity = paternity_samples;
+  samples.maternity = maternity_samples;
+  samples.dropout_rate = dropout_rate_samples;
+  samples.mistyping_rate = mistyping_rate_samples;
+  samples.dropout_errors = dropout_error_expectation;
+  samples.mistyping_errors = mistyping_error_expectation;
+  samples.genotypes = genotypes_expectation;
+  samples.allele_frequencies = allele_frequencies_samples;
+  samples.holdout_deviance = holdout_deviance_samples;
+  samples.deviance = deviance_samples;
+  return samples;
 }
 
-// ----------- stupid attempt to use DP prior (still gets stuck/doesnt converge) ------------- //
-
 // [[Rcpp::export]]
-Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
+Rcpp::List sample_parentage_and_error_rates_from_joint_posterior
  (arma::ucube phenotypes, 
   arma::uvec mothers,
   arma::uvec fathers,
-  const double concentration = 1.,
+  arma::uvec holdouts,
+  const unsigned number_of_mcmc_samples = 1000,
+  const unsigned burn_in_samples = 100,
+  const unsigned thinning_interval = 1,
+  const bool global_genotyping_error_rates = true,
+  const unsigned number_of_threads = 1,
+  const unsigned mismatch_tolerance = 0,
+  const unsigned candidate_refresh_interval = 0,
+  const bool instrument = false,
+  const bool profile_hardware = false)
+{
+  // if candidate_refresh_interval > 0, offspring are scored only against pairs of parents with at most
+  // mismatch_tolerance loci incompatible with their phenotype, given genotypes at the last refresh;
+  // if instrument, time spent per phase of each sweep is returned as "timings"
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+  if (mothers.n_elem == 0 || fathers.n_elem == 0) Rcpp::stop("Must have at least one potential father and mother");
+  if (mothers.max() > phenotypes.n_cols || mothers.min() < 1) Rcpp::stop("1-based index of mothers out of range");
+  if (fathers.max() > phenotypes.n_cols || fathers.min() < 1) Rcpp::stop("1-based index of fathers out of range");
+  if (holdouts.max() > phenotypes.n_cols || holdouts.min() < 1) Rcpp::stop("1-based index of holdouts out of range");
+
+  //this way of specifying parental phenotypes could allow monoiecious mating systems in the future
+  mothers = arma::unique(mothers);
+  fathers = arma::unique(fathers);
+  holdouts = arma::unique(holdouts);
+  arma::uvec parents_and_holdouts = arma::unique(arma::join_vert(arma::join_vert(mothers, fathers), holdouts));
+  arma::uvec offspring = arma::regspace<arma::uvec>(1, phenotypes.n_cols);
+  offspring.shed_rows(parents_and_holdouts-1);
+  if (parents_and_holdouts.n_elem != holdouts.n_elem + mothers.n_elem + fathers.n_elem) Rcpp::stop("Overlap in mother/father/holdouts");
+  if (phenotypes.n_cols != offspring.n_elem + parents_and_holdouts.n_elem) Rcpp::stop("Splitting issues?");
+
+  // recode alleles to integers
+  std::vector<arma::vec> allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, false);
+  mothers -= 1; fathers -= 1; holdouts -= 1; parents_and_holdouts -= 1; offspring -= 1; // convert to 0-based indices
+
+  R_random_number_generator rng;
+  sampler_instrumentation instrumentation (instrument, profile_hardware);
+  joint_posterior_samples samples = 
+    sample_parentage_and_error_rates_from_joint_posterior(phenotypes, allele_frequencies, mothers, fathers, holdouts, offspring,
+        number_of_mcmc_samples, burn_in_samples, thinning_interval, global_genotyping_error_rates, rng, instrumentation, true, 
+        number_of_threads, mismatch_tolerance, candidate_refresh_interval);
+
+  // Rcpp collapses dimensions for elements in std::vector, so copy these over to Rcpp::List
+  Rcpp::List genotypes_expectation_wrapped = Rcpp::List::create();
+  Rcpp::List allele_frequencies_samples_wrapped = Rcpp::List::create();
+  for (unsigned locus=0; locus<phenotypes.n_slices; ++locus) {
+    genotypes_expectation_wrapped.push_back(samples.genotypes[locus].triplets(1./double(number_of_mcmc_samples)));
+    allele_frequencies_samples_wrapped.push_back(samples.allele_frequencies[locus]);
+  }
+
+  Rcpp::List out = Rcpp::List::create(
+    Rcpp::_["paternity"] = samples.paternity,
+    Rcpp::_["maternity"] = samples.maternity,
+    Rcpp::_["dropout_rate"] = samples.dropout_rate,
+    Rcpp::_["mistyping_rate"] = samples.mistyping_rate,
+    Rcpp::_["dropout_errors"] = samples.dropout_errors,
+    Rcpp::_["mistyping_errors"] = samples.mistyping_errors,
+    Rcpp::_["genotypes"] = genotypes_expectation_wrapped,
+    Rcpp::_["allele_frequencies"] = allele_frequencies_samples_wrapped,
+    Rcpp::_["holdout_deviance"] = samples.holdout_deviance,
+    Rcpp::_["deviance"] = samples.deviance);
+  if (instrumentation.enabled) out.push_back(instrumentation_to_list(instrumentation), "timings");
+  return out;
+}
+
+// [[Rcpp::export]]
+Rcpp::List cross_validate_number_of_parents
+ (arma::ucube phenotypes, 
+  arma::uvec mothers,
+  arma::uvec fathers,
+  const unsigned number_of_folds = 5,
+  const unsigned number_of_mcmc_samples = 500,
+  const unsigned burn_in_samples = 500,
+  const unsigned thinning_interval = 20,
+  const bool global_genotyping_error_rates = true,
+  const unsigned number_of_threads = 1)
+{
+  // K-fold cross-validation of sample_parentage_and_error_rates_from_joint_posterior: offspring (columns other
+  // than "mothers" and "fathers") are split at random into balanced folds, and a chain is run for each fold
+  // with that fold held out. Alleles are recoded once and shared across folds. Each fold has its own random
+  // number stream, seeded from R's RNG, so results do not depend on the number of threads
+  if (mothers.n_elem == 0 || fathers.n_elem == 0) Rcpp::stop("Must have at least one potential father and mother");
+  if (mothers.max() > phenotypes.n_cols || mothers.min() < 1) Rcpp::stop("1-based index of mothers out of range");
+  if (fathers.max() > phenotypes.n_cols || fathers.min() < 1) Rcpp::stop("1-based index of fathers out of range");
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+
+  mothers = arma::unique(mothers);
+  fathers = arma::unique(fathers);
+  arma::uvec parents = arma::unique(arma::join_vert(mothers, fathers));
+  arma::uvec offspring = arma::regspace<arma::uvec>(1, phenotypes.n_cols);
+  offspring.shed_rows(parents-1);
+  if (parents.n_elem != mothers.n_elem + fathers.n_elem) Rcpp::stop("Overlap in mother/father");
+  if (number_of_folds < 2 || number_of_folds > offspring.n_elem) Rcpp::stop("number of folds must be between 2 and number of offspring");
+
+  // recode alleles to integers, once for all folds
+  std::vector<arma::vec> allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, false);
+  mothers -= 1; fathers -= 1; offspring -= 1; // convert to 0-based indices
+
+  // balanced folds in random order (Fisher-Yates), and a seed per fold
+  R_random_number_generator R_rng;
+  arma::uvec fold (offspring.n_elem);
+  for (unsigned sib=0; sib<offspring.n_elem; ++sib) fold[sib] = sib % number_of_folds;
+  for (unsigned sib=offspring.n_elem-1; sib>0; --sib) std::swap(fold[sib], fold[R_rng.integer(sib+1)]);
+  std::vector<uint64_t> seeds;
+  std::vector<arma::uvec> holdouts_in_fold, offspring_in_fold;
+  for (unsigned k=0; k<number_of_folds; ++k)
+  {
+    seeds.push_back(random_seed_from_R());
+    holdouts_in_fold.push_back(offspring.elem(arma::find(fold == k)));
+    offspring_in_fold.push_back(offspring.elem(arma::find(fold != k)));
+  }
+
+  // folds may run off the main thread, where R's API is off limits: chains are silent, and errors are
+  // stored per fold and raised once the loop is done
+  std::vector<joint_posterior_samples> fits (number_of_folds);
+  std::vector<std::string> fold_errors (number_of_folds);
+  #ifdef _OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(number_of_threads)
+  #endif
+  for (int k=0; k<int(number_of_folds); ++k)
+  {
+    try
+    {
+      random_number_generator rng (splitmix64(seeds[k]));
+      sampler_instrumentation instrumentation (false);
+      const bool verbose = false;
+      fits[k] = sample_parentage_and_error_rates_from_joint_posterior(phenotypes, allele_frequencies, mothers, fathers, 
+          holdouts_in_fold[k], offspring_in_fold[k], number_of_mcmc_samples, burn_in_samples, thinning_interval, 
+          global_genotyping_error_rates, rng, instrumentation, verbose); //folds are already in parallel
+    }
+    catch (const std::exception& error)
+    {
+      fold_errors[k] = error.what();
+    }
+  }
+  for (unsigned k=0; k<number_of_folds; ++k)
+  {
+    if (!fold_errors[k].empty()) Rcpp::stop("fold " + std::to_string(k+1) + ": " + fold_errors[k]);
+  }
+
+  // holdout deviance of each offspring from the fold that held it out, and per-fold summaries
+  arma::mat holdout_deviance (phenotypes.n_cols, number_of_mcmc_samples); holdout_deviance.fill(arma::datum::nan);
+  Rcpp::IntegerVector fold_of_sample (phenotypes.n_cols, NA_INTEGER);
+  std::vector<int> sample_column, fold_column, size_column;
+  std::vector<double> elpd_column, mean_column, sd_column;
+  for (unsigned k=0; k<number_of_folds; ++k)
+  {
+    arma::rowvec fold_deviance (number_of_mcmc_samples, arma::fill::zeros);
+    for (auto sib : holdouts_in_fold[k])
+    {
+      holdout_deviance.row(sib) = fits[k].holdout_deviance.row(sib);
+      fold_deviance += fits[k].holdout_deviance.row(sib);
+      fold_of_sample[sib] = k + 1;
+      sample_column.push_back(sib + 1);
+      fold_column.push_back(k + 1);
+      elpd_column.push_back(arma::mean(fits[k].holdout_deviance.row(sib)));
+    }
+    size_column.push_back(holdouts_in_fold[k].n_elem);
+    mean_column.push_back(arma::mean(fold_deviance));
+    sd_column.push_back(number_of_mcmc_samples > 1 ? arma::stddev(fold_deviance) : 0.);
+  }
+
+  return Rcpp::List::create(
+    Rcpp::_["scores"] = Rcpp::DataFrame::create(
+      Rcpp::_["elpd"] = elpd_column,
+      Rcpp::_["sample"] = sample_column,
+      Rcpp::_["fold"] = fold_column),
+    Rcpp::_["folds"] = Rcpp::DataFrame::create(
+      Rcpp::_["fold"] = arma::conv_to<std::vector<int>>::from(arma::regspace<arma::uvec>(1, number_of_folds)),
+      Rcpp::_["holdouts"] = size_column,
+      Rcpp::_["mean_holdout_deviance"] = mean_column,
+      Rcpp::_["sd_holdout_deviance"] = sd_column),
+    Rcpp::_["fold"] = fold_of_sample,
+    Rcpp::_["holdout_deviance"] = holdout_deviance);
+}
+
+// ----------- stupid attempt to use DP prior (still gets stuck/doesnt converge) ------------- //
+
+// [[Rcpp::export]]
+Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
+ (arma::ucube phenotypes, 
+  arma::uvec mothers,
+  arma::uvec fathers,
+  const double concentration = 1.,
   const unsigned number_of_mcmc_samples = 1000,
   const unsigned burn_in_samples = 100,
   const unsigned thinning_interval = 1,
@@ -1640,6 +2925,7 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
   arma::ucube paternal_genotypes = paternal_phenotypes; paternal_genotypes.replace(0, 1);
   arma::ucube offspring_genotypes = offspring_phenotypes; offspring_genotypes.replace(0, 1);
   // sample missing (0) from HWE prior TODO use MAP estimate for reproducible
+  R_random_number_generator rng;
 
   // storage
   arma::imat paternity_samples (num_samples, max_iter); paternity_samples.fill(arma::datum::nan);
@@ -1652,10 +2938,10 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
   for (unsigned locus=0; locus<num_loci; ++locus) allele_frequencies_samples.push_back(arma::zeros<arma::mat>(num_alleles[locus], max_iter));
   arma::mat dropout_error_expectation (num_samples, num_loci, arma::fill::zeros);
   arma::mat mistyping_error_expectation (num_samples, num_loci, arma::fill::zeros);
-  std::vector<arma::cube> genotypes_expectation;
+  std::vector<sydneyPaternity::genotype_counts> genotypes_expectation; //sparse, rather than alleles x alleles x samples
   for (unsigned locus=0; locus<num_loci; ++locus) 
   {
-    genotypes_expectation.push_back(arma::zeros<arma::cube>(num_alleles[locus], num_alleles[locus], num_samples));
+    genotypes_expectation.emplace_back(num_alleles[locus], num_samples);
   }
 
   // Gibbs sampler
@@ -1682,6 +2968,17 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
         arma::uvec children = arma::find(maternity == mother);
         for (unsigned locus=0; locus<num_loci; ++locus)
         {
+          const sydneyPaternity::genotyping_error_rates rate (num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+          arma::mat transmission (num_alleles[locus], children.n_elem); //P(phenotype | maternal allele, father's allele)
+          unsigned phenotyped_children = 0;
+          for (auto sib : children)
+          {
+            if (offspring_phenotypes.at(0, sib, locus))
+            {
+              sydneyPaternity::diploid_transmission_column(offspring_phenotypes.at(0, sib, locus), offspring_phenotypes.at(1, sib, locus),
+                  paternal_genotypes.at(0, paternity[sib], locus), num_alleles[locus], rate, transmission.colptr(phenotyped_children++));
+            }
+          }
           arma::mat maternal_genotype_probabilities(num_alleles[locus], num_alleles[locus]);
           maternal_genotype_probabilities.fill(-arma::datum::inf);
           for (unsigned first_allele=0; first_allele<num_alleles[locus]; first_allele++)
@@ -1689,7 +2986,6 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
             for (unsigned second_allele=first_allele; second_allele<num_alleles[locus]; second_allele++)
             {
               // hardy-weinberg prior
-              arma::uvec maternal_genotype ({first_allele+1, second_allele+1}); // 1-based allele indexing
               maternal_genotype_probabilities.at(first_allele, second_allele) = 
                 log(2. - int(first_allele == second_allele)) +
                 log(allele_frequencies[locus].at(first_allele)) + 
@@ -1699,18 +2995,13 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
               if (maternal_phenotypes.at(0, mother, locus))
               {
                 maternal_genotype_probabilities.at(first_allele, second_allele) += 
-                  log(phenotype_error_model(maternal_phenotypes.slice(locus).col(mother), maternal_genotype,
-                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                  log(sydneyPaternity::diploid_phenotype_probability(maternal_phenotypes.at(0, mother, locus), 
+                        maternal_phenotypes.at(1, mother, locus), first_allele+1, second_allele+1, rate)); // 1-based allele indexing
               }
-              for (auto sib : children)
+              for (unsigned child=0; child<phenotyped_children; ++child)
               {
-                if (offspring_phenotypes.at(0, sib, locus))
-                {
-                  maternal_genotype_probabilities.at(first_allele, second_allele) += 
-                    log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), maternal_genotype,
-                          paternal_genotypes.slice(locus).col(paternity[sib]), 
-                          num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
-                }
+                maternal_genotype_probabilities.at(first_allele, second_allele) += 
+                  log(0.5 * transmission.at(first_allele, child) + 0.5 * transmission.at(second_allele, child));
               }
             }
           }
@@ -1729,29 +3020,29 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
         arma::uvec children = arma::find(paternity == father);
         for (unsigned locus=0; locus<num_loci; ++locus)
         {
+          const sydneyPaternity::genotyping_error_rates rate (num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
           arma::vec paternal_genotype_probabilities(num_alleles[locus]);
           paternal_genotype_probabilities.fill(-arma::datum::inf);
           for (unsigned first_allele=0; first_allele<num_alleles[locus]; first_allele++)
           {
             // hardy-weinberg prior
-            arma::uvec paternal_genotype ({first_allele + 1}); // 1-based allele indexing
             paternal_genotype_probabilities.at(first_allele) = log(allele_frequencies[locus].at(first_allele)); 
 
             // phenotype likelihoods
             if (paternal_phenotypes.at(0, father, locus))
             {
               paternal_genotype_probabilities.at(first_allele) += 
-                log(phenotype_error_model(paternal_phenotypes.slice(locus).col(father), paternal_genotype,
-                      num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                log(sydneyPaternity::haploid_phenotype_probability(paternal_phenotypes.at(0, father, locus), 
+                      first_allele+1, rate)); // 1-based allele indexing
             }
             for (auto sib : children)
             {
               if (offspring_phenotypes.at(0, sib, locus))
               {
                 paternal_genotype_probabilities.at(first_allele) += 
-                  log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), 
-                        maternal_genotypes.slice(locus).col(maternity[sib]), paternal_genotype,
-                        num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                  log(sydneyPaternity::diploid_mendelian_probability(offspring_phenotypes.at(0, sib, locus), 
+                        offspring_phenotypes.at(1, sib, locus), maternal_genotypes.at(0, maternity[sib], locus), 
+                        maternal_genotypes.at(1, maternity[sib], locus), first_allele+1, rate));
               }
             }
           }
@@ -1776,11 +3067,13 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
       {
         for (unsigned locus=0; locus<num_loci; ++locus)
         {
-          offspring_genotypes.slice(locus).col(sib) = 
-            sample_mendelian_genotype(offspring_phenotypes.slice(locus).col(sib), 
-                maternal_genotypes.slice(locus).col(maternity[sib]), 
-                paternal_genotypes.slice(locus).col(paternity[sib]), 
-                num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+          const sydneyPaternity::genotyping_error_rates rate (num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
+          const std::array<unsigned, 2> genotype = sydneyPaternity::sample_diploid_mendelian_genotype(
+              offspring_phenotypes.at(0, sib, locus), offspring_phenotypes.at(1, sib, locus),
+              maternal_genotypes.at(0, maternity[sib], locus), maternal_genotypes.at(1, maternity[sib], locus), 
+              paternal_genotypes.at(0, paternity[sib], locus), rate, rng);
+          offspring_genotypes.at(0, sib, locus) = genotype[0];
+          offspring_genotypes.at(1, sib, locus) = genotype[1];
         }
       }
 
@@ -1853,6 +3146,8 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
       }
 
       // ------ sample parentage ------
+      std::vector<sydneyPaternity::genotyping_error_rates> rates;
+      for (unsigned locus=0; locus<num_loci; ++locus) rates.emplace_back(num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]);
       arma::uvec paternity_counts(num_fathers, arma::fill::zeros);
       arma::uvec maternity_counts(num_mothers, arma::fill::zeros);
       for (unsigned sib=0; sib<num_offspring; ++sib)
@@ -1877,10 +3172,10 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
               if (offspring_phenotypes.at(0, sib, locus))
               {
                 log_likelihood.at(father, mother) += 
-                      log(mendelian_genotype_model(offspring_phenotypes.slice(locus).col(sib), 
-                                                   maternal_genotypes.slice(locus).col(mother),
-                                                   paternal_genotypes.slice(locus).col(father),
-                                                   num_alleles[locus], dropout_rate[locus], mistyping_rate[locus]));
+                      log(sydneyPaternity::diploid_mendelian_probability(offspring_phenotypes.at(0, sib, locus), 
+                                                   offspring_phenotypes.at(1, sib, locus),
+                                                   maternal_genotypes.at(0, mother, locus), maternal_genotypes.at(1, mother, locus),
+                                                   paternal_genotypes.at(0, father, locus), rates[locus]));
               }
             }
             log_prior.at(father, mother) += paternity_counts[father] > 0 ? 
@@ -1910,22 +3205,22 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
           {
             dropout_error_expectation.at(mothers[mother], locus) += maternal_dropout_errors.at(mother, locus)/double(max_iter);
             mistyping_error_expectation.at(mothers[mother], locus) += maternal_mistyping_errors.at(mother, locus)/double(max_iter);
-            genotypes_expectation[locus].at(maternal_genotypes.at(0, mother, locus)-1, 
-                maternal_genotypes.at(1, mother, locus)-1, mothers[mother]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(mothers[mother], maternal_genotypes.at(0, mother, locus), 
+                maternal_genotypes.at(1, mother, locus));
           }
           for (unsigned father=0; father<num_fathers; ++father)
           {
             dropout_error_expectation.at(fathers[father], locus) += paternal_dropout_errors.at(father, locus)/double(max_iter);
             mistyping_error_expectation.at(fathers[father], locus) += paternal_mistyping_errors.at(father, locus)/double(max_iter);
-            genotypes_expectation[locus].at(paternal_genotypes.at(0, father, locus)-1, 
-                paternal_genotypes.at(0, father, locus)-1, fathers[father]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(fathers[father], paternal_genotypes.at(0, father, locus), 
+                paternal_genotypes.at(0, father, locus));
           }
           for (unsigned sib=0; sib<num_offspring; ++sib)
           {
             dropout_error_expectation.at(offspring[sib], locus) += offspring_dropout_errors.at(sib, locus)/double(max_iter);
             mistyping_error_expectation.at(offspring[sib], locus) += offspring_mistyping_errors.at(sib, locus)/double(max_iter);
-            genotypes_expectation[locus].at(offspring_genotypes.at(0, sib, locus)-1, 
-                offspring_genotypes.at(1, sib, locus)-1, offspring[sib]) += 1./double(max_iter);
+            genotypes_expectation[locus].add(offspring[sib], offspring_genotypes.at(0, sib, locus), 
+                offspring_genotypes.at(1, sib, locus));
           }
         }
         for (unsigned sib=0; sib<num_offspring; ++sib)
@@ -1945,7 +3240,7 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
   Rcpp::List genotypes_expectation_wrapped = Rcpp::List::create();
   Rcpp::List allele_frequencies_samples_wrapped = Rcpp::List::create();
   for (unsigned locus=0; locus<num_loci; ++locus) {
-    genotypes_expectation_wrapped.push_back(genotypes_expectation[locus]);
+    genotypes_expectation_wrapped.push_back(genotypes_expectation[locus].triplets(1./double(max_iter)));
     allele_frequencies_samples_wrapped.push_back(allele_frequencies_samples[locus]);
   }
 
@@ -1965,334 +3260,96 @@ Rcpp::List sample_parentage_and_error_rates_from_joint_posterior_alt
 
 // --------- yet another attempt, now allowing the number of mothers to vary -------- //
 
-std::tuple<arma::umat, arma::uvec, arma::uvec, arma::uvec, arma::uvec, arma::uvec> 
-sample_genotypes_given_parentage
- (const arma::uvec& paternity,
-  const arma::uvec& maternity,
-  const arma::umat& offspring_phenotypes, 
-  const arma::uvec& maternal_phenotype, 
-  const arma::vec& allele_frequencies, 
-  const double& dropout_rate, 
-  const double& mistyping_rate)
+Rcpp::List parentage_trace_to_list
+ (const sydneyPaternity::parentage_trace& trace,
+  const unsigned mother)
 {
-  // assumes a single "known" maternal phenotype; index 0 in "maternity" refers to the associated mother
-  
-  const unsigned number_of_alleles = allele_frequencies.n_elem;
-  const arma::uvec fathers = arma::unique(paternity);
-  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
-  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
-
-  if (offspring_phenotypes.n_rows != 2) Rcpp::stop("offspring phenotypes must have 2 rows");
-  if (offspring_phenotypes.n_cols != paternity.n_elem) Rcpp::stop("offspring phenotypes must have column for each individual");
-  if (paternity.n_elem != maternity.n_elem) Rcpp::stop("maternity/paternity vectors must be the same length");
-  if (maternal_phenotype.n_elem != 2) Rcpp::stop("maternal phenotype must have 2 elements");
-  if (offspring_phenotypes.max() > number_of_alleles) Rcpp::stop("offspring allele out of range");
-  if (maternal_phenotype.max() > number_of_alleles) Rcpp::stop("maternal allele out of range");
-  if (arma::any(allele_frequencies_normalized < 0.)) Rcpp::stop("negative allele frequencies");
-  if (dropout_rate <= 0. || mistyping_rate <= 0.) Rcpp::stop("negative genotyping error rates");
-
-  // alternatively pass in as mutable argument
-  arma::umat maternal_genotypes (2, mothers.n_elem);
-  arma::umat offspring_genotypes (2, paternity.n_elem);
-  arma::uvec paternal_genotypes (fathers.n_elem);
-  maternal_genotypes.fill(arma::datum::nan);
-  offspring_genotypes.fill(arma::datum::nan);
-  paternal_genotypes.fill(arma::datum::nan);
-
-  // tabulate sib groups
-  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
-  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
-  {
-    offspring_counts.at(paternity[sib],maternity[sib])++;
-  }
-
-  // simulate maternal genotype; there are choose(k,2)+k possible genotypes
-  // marginalize over paternal & offspring genotypes to calculate posterior genotype probabilities
-  unsigned number_of_genotypes = number_of_alleles*(number_of_alleles + 1)/2;
-  for (auto mother : mothers)
-  {
-    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
-    arma::vec maternal_genotype_posterior (number_of_genotypes);
-    arma::umat possible_maternal_genotypes (2, number_of_genotypes);
-    unsigned genotype = 0;
-    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
-    { 
-      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
-      {
-        double maternal_genotype_probability = 
-          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
-        double log_halfsib_likelihood = log(maternal_genotype_probability); 
-        if (mother == 0 && arma::prod(maternal_phenotype)) //index 0 is "phenotyped" mother
-        {
-          double maternal_phenotype_probability = 
-            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
-          log_halfsib_likelihood += log(maternal_phenotype_probability);
-        }
-        for (auto father : mated_fathers)
-        {
-          double fullsib_likelihood = 0.;
-          double running_maximum = -arma::datum::inf;
-          arma::uvec offspring_from_father = arma::find(paternity == father);
-          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
-          {
-            double paternal_genotype_probability = 
-              allele_frequencies_normalized[u-1]; //hwe prior
-            double log_fullsib_likelihood = log(paternal_genotype_probability);
-            for (auto offspring : offspring_from_father)
-            {
-              arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
-              if (arma::prod(offspring_phenotype)) { 
-                double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
-                  0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
-                  0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
-                log_fullsib_likelihood += log(offspring_phenotype_probability);
-              }
-            }
-            if (log_fullsib_likelihood <= running_maximum) //underflow protection
-            {
-              fullsib_likelihood += exp(log_fullsib_likelihood - running_maximum);
-            } else {
-              fullsib_likelihood *= exp(running_maximum - log_fullsib_likelihood);
-              fullsib_likelihood += 1.;
-              running_maximum = log_fullsib_likelihood;
-            }
-          }
-          log_halfsib_likelihood += log(fullsib_likelihood) + running_maximum;
-        }
-        maternal_genotype_posterior.at(genotype) = log_halfsib_likelihood;
-        possible_maternal_genotypes.col(genotype) = arma::uvec({w, v});
-        genotype++;
-      }
-    }
-    maternal_genotype_posterior -= maternal_genotype_posterior.max();
-    maternal_genotypes.col(mother) = 
-      possible_maternal_genotypes.col(sample(arma::exp(maternal_genotype_posterior)));
-  }
-
-  // simulate paternal genotype; there are k possible genotypes
-  // paternal genotypes are conditionally independent with fixed maternal genotype
-  // calculate posterior genotype probabilities by marginalizing over offspring genotypes
-  for (auto father : fathers)
-  {
-    arma::vec paternal_genotype_posterior (number_of_alleles);
-    arma::uvec possible_paternal_genotypes (number_of_alleles);
-    arma::uvec offspring_from_father = arma::find(paternity == father);
-    for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
-    {
-      double paternal_genotype_probability = 
-          allele_frequencies_normalized[u-1]; //hwe prior
-      double log_fullsib_likelihood = log(paternal_genotype_probability);
-      for (auto offspring : offspring_from_father)
-      {
-        arma::uvec maternal_genotype = maternal_genotypes.col(maternity[offspring]);
-        arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
-        if (arma::prod(offspring_phenotype)) { 
-          double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
-            0.5 * genotyping_error_model(offspring_phenotype, maternal_genotype[0], u, number_of_alleles, dropout_rate, mistyping_rate) + 
-            0.5 * genotyping_error_model(offspring_phenotype, maternal_genotype[1], u, number_of_alleles, dropout_rate, mistyping_rate); 
-          log_fullsib_likelihood += log(offspring_phenotype_probability);
-        }
-      }
-      paternal_genotype_posterior[u-1] = log_fullsib_likelihood;
-      possible_paternal_genotypes[u-1] = u;
-    }
-    paternal_genotype_posterior -= paternal_genotype_posterior.max();
-    paternal_genotypes.at(father) = possible_paternal_genotypes.at(sample(arma::exp(paternal_genotype_posterior)));
-  }
+  // compressed history of parent labels; see decode_parentage_trace
+  Rcpp::List out = Rcpp::List::create(
+    Rcpp::_["number_of_labels"] = trace.labels(),
+    Rcpp::_["keyframe_interval"] = trace.interval(),
+    Rcpp::_["fixed_labels"] = trace.fixed(),
+    Rcpp::_["mother"] = mother,
+    Rcpp::_["keyframes"] = Rcpp::IntegerVector(trace.keyframe_labels().begin(), trace.keyframe_labels().end()),
+    Rcpp::_["offsets"] = Rcpp::IntegerVector(trace.offsets().begin(), trace.offsets().end()),
+    Rcpp::_["indices"] = Rcpp::IntegerVector(trace.change_indices().begin(), trace.change_indices().end()),
+    Rcpp::_["labels"] = Rcpp::IntegerVector(trace.change_labels().begin(), trace.change_labels().end()));
+  out.attr("class") = "parentage_trace";
+  return out;
+}
 
-  // simulate offspring genotypes
-  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+// [[Rcpp::export]]
+Rcpp::List encode_parentage_trace
+ (Rcpp::IntegerMatrix labels,
+  const unsigned mother = 1,
+  const unsigned keyframe_interval = 100,
+  const unsigned fixed_labels = 0)
+{
+  // inverse of decode_parentage_trace: individuals by MCMC samples, with NA in the mother's row;
+  // labels are stored in canonical order (labels below fixed_labels are kept, others are renumbered
+  // by first appearance)
+  if (labels.nrow() < 1) Rcpp::stop("need at least one individual");
+  if (mother < 1 || mother > unsigned(labels.nrow())) Rcpp::stop("1-based index of mother out of range");
+  if (keyframe_interval < 1) Rcpp::stop("keyframe interval must be positive");
+  sydneyPaternity::parentage_trace trace (labels.nrow() - 1, keyframe_interval, fixed_labels);
+  for (int iter=0; iter<labels.ncol(); ++iter)
   {
-    arma::uvec maternal_genotype = maternal_genotypes.col(maternity[sib]);
-    arma::uvec offspring_phenotype = offspring_phenotypes.col(sib);
-    arma::vec offspring_genotype_posterior (2);
-    arma::umat possible_offspring_genotypes (2, 2);
-    for (unsigned i=0; i<2; ++i)
+    arma::uvec column (labels.nrow() - 1);
+    for (int i=0, j=0; i<labels.nrow(); ++i)
     {
-      offspring_genotype_posterior[i] = log(0.5); //Mendelian segregation
-      if (arma::prod(offspring_phenotype)) { 
-        offspring_genotype_posterior[i] += 
-          log(genotyping_error_model(offspring_phenotype, maternal_genotype[i], 
-                paternal_genotypes.at(paternity.at(sib)), number_of_alleles, dropout_rate, mistyping_rate));
-      }
-      possible_offspring_genotypes.col(i) = 
-        arma::uvec({maternal_genotype[i], paternal_genotypes.at(paternity.at(sib))});
+      if (i == int(mother) - 1) continue;
+      if (labels(i, iter) == NA_INTEGER || labels(i, iter) < 0) Rcpp::stop("labels must be non-negative integers");
+      column[j++] = labels(i, iter);
     }
-    offspring_genotype_posterior -= offspring_genotype_posterior.max();
-    offspring_genotypes.col(sib) = 
-      possible_offspring_genotypes.col(sample(arma::exp(offspring_genotype_posterior)));
-  }
-
-  //simulate numbers of errors given genotypes and phenotypes
-  //0-index is the mother, remaining indices are offspring
-  arma::uvec dropouts (paternity.n_elem+1, arma::fill::zeros);
-  arma::uvec mistypes (paternity.n_elem+1, arma::fill::zeros);
-  arma::uvec heterozygous (paternity.n_elem+1, arma::fill::zeros);
-  arma::uvec nonmissing (paternity.n_elem+1, arma::fill::zeros);
-  if (arma::prod(maternal_phenotype))
-  {
-    arma::uvec maternal_genotype = maternal_genotypes.col(0); //genotype of phenotyped mother
-    arma::uvec errors =
-      simulate_genotyping_errors(maternal_phenotype, maternal_genotype[0], 
-          maternal_genotype[1], number_of_alleles, dropout_rate, mistyping_rate);
-    dropouts.at(0) = errors.at(0);
-    mistypes.at(0) = errors.at(1);
-    nonmissing.at(0) += 2;
-    if (maternal_genotype[0] != maternal_genotype[1]) heterozygous.at(0) += 1;
+    trace.push(column);
   }
-  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
-  {
-    arma::uvec offspring_phenotype = offspring_phenotypes.col(sib);
-    if (arma::prod(offspring_phenotype)) { 
-      arma::uvec errors =
-        simulate_genotyping_errors(offspring_phenotype, offspring_genotypes.at(0,sib), 
-          offspring_genotypes.at(1,sib), number_of_alleles, dropout_rate, mistyping_rate);
-      dropouts.at(sib+1) = errors.at(0);
-      mistypes.at(sib+1) = errors.at(1);
-      nonmissing.at(sib+1) += 2;
-      if (offspring_genotypes.at(0,sib) != offspring_genotypes.at(1,sib)) heterozygous.at(sib+1) += 1;
-    }
-  }
-
-  // tally maternal/paternal alleles
-  arma::uvec allele_counts (number_of_alleles, arma::fill::zeros);
-  for (unsigned mother=0; mother<mothers.n_elem; ++mother)
-  {
-    allele_counts[maternal_genotypes.at(0,mother)-1]++;
-    allele_counts[maternal_genotypes.at(1,mother)-1]++;
-  }
-  for (unsigned father=0; father<fathers.n_elem; ++father)
-  {
-    allele_counts[paternal_genotypes[father]-1]++;
-  }
-
-  // output
-  arma::umat genotypes = arma::join_horiz(maternal_genotypes.col(0), offspring_genotypes);
-  return std::make_tuple(genotypes, allele_counts, dropouts, heterozygous, mistypes, nonmissing);
+  return parentage_trace_to_list(trace, mother);
 }
 
-double parentage_loglikelihood_by_locus 
- (const arma::uvec& paternity,
-  const arma::uvec& maternity,
-  const arma::umat& offspring_phenotypes, 
-  const arma::uvec& maternal_phenotype, 
-  const arma::vec& allele_frequencies, 
-  const double& dropout_rate, 
-  const double& mistyping_rate)
+// [[Rcpp::export]]
+Rcpp::IntegerMatrix decode_parentage_trace (Rcpp::List trace)
 {
-  // likelihood of offspring paternity given offspring phenotypes, maternal phenotype, haplodiploidy
-  // modified from Eqs 3 & 4 in Wang 2004 Genetics
-  const unsigned number_of_alleles = allele_frequencies.n_elem;
-  const unsigned number_of_genotypes = number_of_alleles*(number_of_alleles+1)/2;
-  const arma::uvec fathers = arma::unique(paternity);
-  const arma::uvec mothers = arma::unique(arma::join_vert(arma::uvec({0}), maternity)); //always include 0'th index, corresponding to maternal phenotype
-  const arma::vec allele_frequencies_normalized = allele_frequencies / arma::accu(allele_frequencies);
-
-  if (paternity.n_elem != maternity.n_elem) Rcpp::stop("maternity/paternity vectors must be the same length");
-  if (offspring_phenotypes.n_rows != 2) Rcpp::stop("offspring phenotypes must have 2 rows");
-  if (offspring_phenotypes.n_cols != paternity.n_elem) Rcpp::stop("offspring phenotypes must have column for each individual");
-  if (maternal_phenotype.n_elem != 2) Rcpp::stop("maternal phenotype must have 2 elements");
-  if (offspring_phenotypes.max() > number_of_alleles) Rcpp::stop("offspring allele out of range");
-  if (maternal_phenotype.max() > number_of_alleles) Rcpp::stop("maternal allele out of range");
-  if (arma::any(allele_frequencies_normalized < 0.)) Rcpp::stop("negative allele frequencies");
-  if (dropout_rate <= 0. || mistyping_rate <= 0.) Rcpp::stop("negative genotyping error rates");
-
-  // tabulate sib groups
-  arma::umat offspring_counts (fathers.max()+1, mothers.max()+1, arma::fill::zeros);
-  for (unsigned sib=0; sib<paternity.n_elem; ++sib)
+  // dense individuals by MCMC samples, as returned by sample_parentage_and_error_rates 
+  // without compression (the mother's row is NA), but with labels in the trace's canonical order,
+  // so exchangeable groups may be numbered differently from the uncompressed output
+  const unsigned mother = Rcpp::as<unsigned>(trace["mother"]);
+  const sydneyPaternity::parentage_trace decoded = sydneyPaternity::parentage_trace::from_components(
+      Rcpp::as<unsigned>(trace["number_of_labels"]),
+      Rcpp::as<unsigned>(trace["keyframe_interval"]),
+      Rcpp::as<unsigned>(trace["fixed_labels"]),
+      Rcpp::as<std::vector<int32_t>>(trace["keyframes"]),
+      Rcpp::as<std::vector<uint32_t>>(trace["offsets"]),
+      Rcpp::as<std::vector<uint32_t>>(trace["indices"]),
+      Rcpp::as<std::vector<int32_t>>(trace["labels"]));
+  const arma::imat dense = decoded.decode();
+
+  if (mother < 1 || mother > dense.n_rows + 1) Rcpp::stop("1-based index of mother out of range");
+  Rcpp::IntegerMatrix out (dense.n_rows + 1, dense.n_cols);
+  for (unsigned iter=0; iter<dense.n_cols; ++iter)
   {
-    offspring_counts.at(paternity[sib],maternity[sib])++;
-  }
-
-  double log_likelihood = 0;
-  for (auto mother : mothers)
-  {
-    arma::uvec mated_fathers = arma::find(offspring_counts.col(mother) > 0);
-    double halfsib_likelihood = 0.;
-    double halfsib_running_maximum = -arma::datum::inf;
-    for (unsigned w=1; w<=number_of_alleles; ++w) // first maternal allele 
-    { 
-      for (unsigned v=w; v<=number_of_alleles; ++v) // second maternal allele
-      {
-        double maternal_genotype_probability = 
-          (2.-int(w==v)) * allele_frequencies_normalized[w-1] * allele_frequencies_normalized[v-1]; //hwe prior
-        double log_halfsib_likelihood = log(maternal_genotype_probability); 
-        if (mother == 0 && arma::prod(maternal_phenotype)) //0'th mother is phenotyped
-        {
-          double maternal_phenotype_probability = 
-            genotyping_error_model(maternal_phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
-          log_halfsib_likelihood += log(maternal_phenotype_probability);
-        }
-        for (auto father : mated_fathers)
-        {
-          double fullsib_likelihood = 0.;
-          double fullsib_running_maximum = -arma::datum::inf;
-          arma::uvec offspring_from_father = arma::find(paternity == father);
-          for (unsigned u=1; u<=number_of_alleles; ++u) // paternal allele
-          {
-            double paternal_genotype_probability = 
-              allele_frequencies_normalized[u-1]; //hwe prior
-            double log_fullsib_likelihood = log(paternal_genotype_probability);
-            for (auto offspring : offspring_from_father)
-            {
-              arma::uvec offspring_phenotype = offspring_phenotypes.col(offspring);
-              if (arma::prod(offspring_phenotype)) { 
-                double offspring_phenotype_probability = // Mendelian segregation probs * phenotype probabilities
-                  0.5 * genotyping_error_model(offspring_phenotype, w, u, number_of_alleles, dropout_rate, mistyping_rate) + 
-                  0.5 * genotyping_error_model(offspring_phenotype, v, u, number_of_alleles, dropout_rate, mistyping_rate); 
-                log_fullsib_likelihood += log(offspring_phenotype_probability);
-              } 
-            }
-            if (log_fullsib_likelihood <= fullsib_running_maximum) //underflow protection
-            {
-              fullsib_likelihood += exp(log_fullsib_likelihood - fullsib_running_maximum);
-            } else {
-              fullsib_likelihood *= exp(fullsib_running_maximum - log_fullsib_likelihood);
-              fullsib_likelihood += 1.;
-              fullsib_running_maximum = log_fullsib_likelihood;
-            }
-          }
-          log_halfsib_likelihood += log(fullsib_likelihood) + fullsib_running_maximum;
-        }
-        if (log_halfsib_likelihood <= halfsib_running_maximum) //underflow protection
-        {
-          halfsib_likelihood += exp(log_halfsib_likelihood - halfsib_running_maximum);
-        } else {
-          halfsib_likelihood *= exp(halfsib_running_maximum - log_halfsib_likelihood);
-          halfsib_likelihood += 1.;
-          halfsib_running_maximum = log_halfsib_likelihood;
-        }
-      }
+    for (unsigned i=0; i<dense.n_rows+1; ++i)
+    {
+      out(i, iter) = i < mother-1 ? int(dense.at(i, iter)) : 
+        i == mother-1 ? NA_INTEGER : int(dense.at(i-1, iter));
     }
-    log_likelihood += log(halfsib_likelihood) + halfsib_running_maximum;
   }
-  return log_likelihood;
+  return out;
 }
 
-double parentage_loglikelihood 
- (arma::uvec paternity, 
-  arma::uvec maternity,
-  arma::ucube offspring_phenotypes, 
-  arma::umat maternal_phenotype,
-  std::vector<arma::vec> allele_frequencies,
-  arma::vec dropout_rate,
-  arma::vec mistyping_rate)
+Rcpp::List parentage_posterior_samples_to_list
+ (const sydneyPaternity::parentage_posterior_samples& samples)
 {
-  // check number of loci match
-  const unsigned number_of_loci = allele_frequencies.size();
-  if (maternal_phenotype.n_cols != number_of_loci) Rcpp::stop("must have maternal phenotypes for each locus");
-  if (offspring_phenotypes.n_slices != number_of_loci) Rcpp::stop("must have offspring phenotypes for each locus");
-  if (dropout_rate.n_elem != number_of_loci) Rcpp::stop("must have dropout rates for each locus");
-  if (mistyping_rate.n_elem != number_of_loci) Rcpp::stop("must have mistyping rates for each locus");
-
-  double log_likelihood = 0.;
-  for (unsigned locus=0; locus<number_of_loci; ++locus)
-  {
-    log_likelihood += 
-      parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes.slice(locus), 
-          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
-  }
-  return log_likelihood;
+  return Rcpp::List::create(
+    Rcpp::_["paternity"] = samples.compressed ? 
+      Rcpp::RObject(parentage_trace_to_list(samples.paternity_trace, samples.mother)) : Rcpp::RObject(Rcpp::wrap(samples.paternity)),
+    Rcpp::_["maternity"] = samples.compressed ? 
+      Rcpp::RObject(parentage_trace_to_list(samples.maternity_trace, samples.mother)) : Rcpp::RObject(Rcpp::wrap(samples.maternity)),
+    Rcpp::_["dropout_rate"] = samples.dropout_rate,
+    Rcpp::_["mistyping_rate"] = samples.mistyping_rate,
+    Rcpp::_["dropout_errors"] = samples.dropout_errors,
+    Rcpp::_["mistyping_errors"] = samples.mistyping_errors,
+    Rcpp::_["imputed_genotypes"] = samples.imputed_genotypes,
+    Rcpp::_["deviance"] = samples.deviance);
 }
 
 // [[Rcpp::export]]
@@ -2310,242 +3367,283 @@ Rcpp::List sample_parentage_and_error_rates
   const double lambda_mother = 0.,
   const double lambda_father = 0.,
   const double starting_dropout_rate = 0.01,
-  const double starting_mistyping_rate = 0.01)
+  const double starting_mistyping_rate = 0.01,
+  const bool instrument = false,
+  const bool profile_hardware = false,
+  const std::string checkpoint_file = "",
+  const unsigned checkpoint_interval = 100,
+  const bool compress_traces = false,
+  const bool linear_space_likelihood = false,
+  const bool single_precision_likelihood = false,
+  const double genotype_pruning_threshold = 0.,
+  const unsigned number_of_threads = 1)
 {
-  // samples from posterior distribution of full sib groups with Dirichlet process prior,
-  // using algorithm 8 from Neal 2000 JCGS
+  // sampler lives in inst/include/sydneyPaternity/parentage.h, shared with the command-line tool;
+  // if checkpoint_file is given, the chain is saved there every checkpoint_interval iterations;
+  // if compress_traces, paternity and maternity are delta-encoded (see decode_parentage_trace);
+  // if linear_space_likelihood, parentage likelihoods are computed with scaled products rather than logs;
+  // if single_precision_likelihood, with single-precision offspring emission probabilities;
+  // if genotype_pruning_threshold > 0, parental genotypes that explain an observed phenotype with probability 
+  // below it are left out of likelihoods, and a bound on the resulting error is returned;
+  // data augmentation is parallel over loci with number_of_threads
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+  R_random_number_generator rng;
+  sampler_instrumentation instrumentation (instrument, profile_hardware);
+  sydneyPaternity::parentage_posterior_samples samples = 
+    sydneyPaternity::sample_parentage_and_error_rates(phenotypes, maternity, mother, burn_in, thinning_interval, 
+        number_of_mcmc_samples, global_genotyping_error_rates, update_error_rates, update_allele_frequencies, 
+        concentration, lambda_mother, lambda_father, starting_dropout_rate, starting_mistyping_rate, 
+        rng, instrumentation, Rcpp::Rcout, checkpoint_file, checkpoint_interval, compress_traces, 
+        linear_space_likelihood, single_precision_likelihood, genotype_pruning_threshold, number_of_threads);
+
+  Rcpp::List out = parentage_posterior_samples_to_list(samples);
+  if (genotype_pruning_threshold > 0.) out.push_back(samples.pruning_error_bound, "pruning_error_bound");
+  if (instrumentation.enabled) out.push_back(instrumentation_to_list(instrumentation), "timings");
+  return out;
+}
 
-  // wait a damn minute. b/c we have observed the maternal phenotypes they should ALWAYS go in the likelihood, even when there are no offspring for that mother
-  
-  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
-  if (maternity.n_elem != phenotypes.n_cols) Rcpp::stop("maternity vector wrong dimension");
+// [[Rcpp::export]]
+Rcpp::List resume_parentage_and_error_rates
+ (const std::string checkpoint_file,
+  const unsigned checkpoint_interval = 100,
+  const bool instrument = false,
+  const bool profile_hardware = false,
+  const unsigned number_of_threads = 1)
+{
+  // continues a chain from sample_parentage_and_error_rates where its last checkpoint left off;
+  // restores R's random number generator too, so the result is identical to an uninterrupted run
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+  R_random_number_generator rng;
+  sampler_instrumentation instrumentation (instrument, profile_hardware);
+  sydneyPaternity::parentage_posterior_samples samples = 
+    sydneyPaternity::resume_parentage_and_error_rates(checkpoint_file, rng, instrumentation, Rcpp::Rcout, checkpoint_interval, 
+        number_of_threads);
+
+  Rcpp::List out = parentage_posterior_samples_to_list(samples);
+  if (samples.pruning_error_bound > 0.) out.push_back(samples.pruning_error_bound, "pruning_error_bound");
+  if (instrumentation.enabled) out.push_back(instrumentation_to_list(instrumentation), "timings");
+  return out;
+}
 
-  const unsigned max_iter = number_of_mcmc_samples;
-  const unsigned num_loci = phenotypes.n_slices;
-  const unsigned num_offspring = phenotypes.n_cols - 1;
+// ---------------------------------------------------------------------------- //
 
-  // priors (hardcoded for now)
-  const double alpha = std::fabs(concentration); //dirichlet process concentration parameter
-  const double delta = 1.; //allele frequency concentration parameter
-  const arma::vec dropout_rate_prior = {{1.,1.}}; //beta(number of dropout homozygotes, number of heterozygotes)
-  const arma::vec mistyping_rate_prior = {{1.,1.}}; //beta(number of mistypes, number of correct calls)
-  std::vector<arma::uvec> allele_lengths = unique_alleles(phenotypes, false);
-  std::vector<arma::vec> allele_frequencies = collapse_alleles_and_generate_genotype_prior(phenotypes, false);
+// [[Rcpp::export]]
+Rcpp::List benchmark_likelihood_kernels
+ (arma::ucube phenotypes,
+  arma::uvec paternity,
+  arma::uvec maternity,
+  const unsigned mother = 1,
+  const unsigned number_of_repetitions = 10,
+  const double dropout_rate = 0.05,
+  const double mistyping_rate = 0.05)
+{
+  // wall time of likelihood kernels; "paternity" and "maternity" are for offspring (columns other than "mother"),
+  // with maternity 0 for the sampled mother. Each repetition evaluates the kernel once per locus (for the error model,
+  // once per phenotype/genotype pair per locus)
+  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  if (paternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("paternity must have an element for each offspring");
+  if (maternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("maternity must have an element for each offspring");
+  if (number_of_repetitions < 1) Rcpp::stop("need at least one repetition");
 
-  // split maternal, offspring phenotypes
+  typedef std::chrono::steady_clock clock;
+  const unsigned number_of_loci = phenotypes.n_slices;
+
+  std::vector<arma::vec> allele_frequencies =
+    collapse_alleles_and_generate_genotype_prior(phenotypes); //creates uniform frequency prior
   arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
   arma::ucube offspring_phenotypes = phenotypes; offspring_phenotypes.shed_col(mother-1);
-
-  // initialize (could draw from prior instead)
-  //arma::uvec paternity = arma::zeros<arma::uvec>(num_offspring);//this could be randomized
-  //arma::uvec maternity = arma::zeros<arma::uvec>(num_offspring);//this could be randomized, but must include 0
-  maternity.shed_row(mother-1);
-  arma::uvec paternity = maternity;
-  arma::vec dropout_rate (num_loci); dropout_rate.fill(starting_dropout_rate);
-  arma::vec mistyping_rate (num_loci); mistyping_rate.fill(starting_mistyping_rate);
-
-  // storage
-  arma::imat paternity_samples (num_offspring, max_iter);
-  arma::imat maternity_samples (num_offspring, max_iter);
-  arma::mat dropout_rate_samples (num_loci, max_iter);
-  arma::mat mistyping_rate_samples (num_loci, max_iter);
-  arma::vec deviance_samples (max_iter);
-  arma::mat dropout_errors (num_offspring+1, num_loci, arma::fill::zeros);
-  arma::mat mistyping_errors (num_offspring+1, num_loci, arma::fill::zeros);
-  std::vector<arma::cube> genotype_posterior;
-  for(unsigned locus=0; locus<num_loci; ++locus) 
-  {
-    genotype_posterior.emplace_back(arma::cube(allele_frequencies[locus].n_elem,allele_frequencies[locus].n_elem,num_offspring+1,arma::fill::zeros));
-  }
-
-  double deviance = 0.;
-  maternity = recode_to_contiguous_integers(maternity); //check that 0 is in maternity vector?
   paternity = recode_to_contiguous_integers(paternity);
-  for (int iter=-int(burn_in); iter<int(max_iter); ++iter)
+
+  arma::mat seconds (number_of_repetitions, 8);
+  arma::uvec calls (8, arma::fill::zeros);
+  const std::vector<paternity_likelihood_kernel> kernels = 
+    select_paternity_likelihood_kernels(allele_frequencies);
+  double checksum = 0.; //keeps the compiler from discarding kernel calls
+  for (unsigned repetition=0; repetition<number_of_repetitions; ++repetition)
   {
-    for (unsigned thin=0; thin<thinning_interval; ++thin)
+    // genotyping error model, over all phenotypes and genotypes
+    unsigned number_of_calls = 0;
+    auto start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
     {
-      // update paternity vector
-      for (unsigned sib=0; sib<num_offspring; ++sib)
+      const unsigned number_of_alleles = allele_frequencies[locus].n_elem;
+      arma::uvec phenotype (2);
+      for (phenotype[0]=1; phenotype[0]<=number_of_alleles; ++phenotype[0])
       {
-        // tally size of sib groups
-        unsigned current_number_of_fathers = paternity.max() + 1;
-        unsigned current_number_of_mothers = maternity.max() + 1;
-        arma::umat offspring_per_mating (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
-        for (unsigned i=0; i<paternity.n_elem; ++i) offspring_per_mating.at(paternity[i],maternity[i])++;
-        offspring_per_mating.at(paternity[sib],maternity[sib])--; //remove sib from group
-        arma::uvec offspring_per_father = arma::sum(offspring_per_mating, 1);
-        arma::urowvec offspring_per_mother = arma::sum(offspring_per_mating, 0);
-
-        // find permissible matings under constraint of single mating/father
-        arma::umat permissible_matings (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
-        unsigned new_fathers = 0;
-        for (unsigned father=0; father<permissible_matings.n_rows; ++father)
+        for (phenotype[1]=phenotype[0]; phenotype[1]<=number_of_alleles; ++phenotype[1])
         {
-          for (unsigned mother=0; mother<permissible_matings.n_cols; ++mother)
+          for (unsigned w=1; w<=number_of_alleles; ++w)
           {
-            const bool existing_father = offspring_per_father.at(father) > 0;
-            const bool existing_mother = offspring_per_mother.at(mother) > 0;
-            const bool existing_mating = offspring_per_mating.at(father,mother) > 0;
-            permissible_matings.at(father,mother) = unsigned(
-                ( existing_mating                    ) || 
-                ( existing_mother && !existing_father) || 
-                (!existing_mother && !existing_father) );
-            if (permissible_matings.at(father,mother) && !existing_father) new_fathers++;
+            for (unsigned v=w; v<=number_of_alleles; ++v)
+            {
+              checksum += genotyping_error_model(phenotype, w, v, number_of_alleles, dropout_rate, mistyping_rate);
+              number_of_calls++;
+            }
           }
         }
+      }
+    }
+    seconds.at(repetition,0) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[0] = number_of_calls;
 
-        // calculate parentage likelihoods across permissible matings
-        arma::mat log_likelihood (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
-        arma::mat log_prior (current_number_of_fathers + 1, current_number_of_mothers + 1, arma::fill::zeros);
-        for (unsigned father=0; father<log_likelihood.n_rows; ++father)
-        {
-          for (unsigned mother=0; mother<log_likelihood.n_cols; ++mother)
-          {
-            if (permissible_matings.at(father,mother))
-            {
-              paternity[sib] = father;
-              maternity[sib] = mother;
-              log_likelihood.at(father,mother) = 
-                parentage_loglikelihood(paternity, maternity, offspring_phenotypes, maternal_phenotype, 
-                    allele_frequencies, dropout_rate, mistyping_rate);
-
-              // "restraunt process" prior on number of matings
-              // TODO would be useful to have a way to sample from the prior
-              if (alpha > 0.)
-              {
-                log_prior.at(father,mother) += offspring_per_mating.at(father,mother) > 0 ?
-                  log(double(offspring_per_mating.at(father,mother))) - log(double(num_offspring)-1.+alpha): 
-                  log(alpha) - log(double(new_fathers)) - log(double(num_offspring)-1.+alpha);
-              }
-              if (lambda_mother > 0.)
-              {
-                unsigned num_mother = arma::accu(offspring_per_mother > 0)+1; //+1 because its nonzero
-                log_prior.at(father,mother) += offspring_per_mother.at(mother) > 0 ?
-                  (num_mother)*log(lambda_mother)-lambda_mother-std::lgamma(num_mother+1) :
-                  (num_mother+1)*log(lambda_mother)-lambda_mother-std::lgamma(num_mother+2) ;
-              }
-              if (lambda_father > 0.)
-              {
-                unsigned num_father = arma::accu(offspring_per_father > 0)+1; //+1 because its nonzero
-                log_prior.at(father,mother) += offspring_per_father.at(father) > 0 ?
-                  (num_father)*log(lambda_father)-lambda_father-std::lgamma(num_father+1) :
-                  (num_father+1)*log(lambda_father)-lambda_father-std::lgamma(num_father+2) ;
-              }
-            } else { log_likelihood.at(father,mother) = -arma::datum::inf; }
-          } 
-        }
+    // paternity likelihood
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += paternity_loglikelihood_by_locus(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,1) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[1] = number_of_loci;
 
-        // sample new father
-        arma::mat log_conditional = log_prior + log_likelihood;
-        arma::uvec new_parentage = sample_matrix(arma::exp(log_conditional - log_conditional.max()));
-        paternity[sib] = new_parentage.at(0); maternity[sib] = new_parentage.at(1);
-        deviance = -2 * log_likelihood.at(paternity[sib],maternity[sib]);
-
-        // this song and dance forces the 0-index to correspond to the known mother
-        paternity = recode_to_contiguous_integers(paternity); 
-        arma::uvec maternity_aux = recode_to_contiguous_integers(arma::join_vert(maternity, arma::uvec({0})));
-        maternity = maternity_aux.head(num_offspring);
-        //why recode? indices will increase, if pre-existing singleton is moved to a father with a higher index
-      }
+    // parentage likelihood
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,2) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[2] = number_of_loci;
 
-      // update error rates and allele frequencies via data augmentation
-      unsigned global_dropouts = 0, global_heterozygous = 0, global_mistypes = 0, global_nonmissing = 0;
-      for (unsigned locus=0; locus<num_loci; ++locus)
-      {
-        arma::umat genotypes;
-        arma::uvec allele_counts, dropouts, heterozygous, mistypes, nonmissing;
-        std::tie(genotypes, allele_counts, dropouts, heterozygous, mistypes, nonmissing) =
-          sample_genotypes_given_parentage(paternity, maternity, offspring_phenotypes.slice(locus), 
-              maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate[locus], mistyping_rate[locus]);
-
-        // track expected errors, genotypes
-        if (iter >= 0 && thin == 0)
-        {
-          for (unsigned i=0; i<num_offspring+1; ++i)
-          {
-            dropout_errors.at(i,locus) += double(dropouts.at(i));
-            mistyping_errors.at(i,locus) += double(mistypes.at(i));
-            genotype_posterior[locus].at(genotypes.at(0,i)-1, genotypes.at(1,i)-1, i) += 1.0;//genotypes are 1-indexed so convert
-          }
-        }
+    // parentage likelihood, in linear space
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += parentage_loglikelihood_by_locus_scaled(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,3) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[3] = number_of_loci;
 
-        // update error rates
-        if (update_error_rates)
-        {
-          global_dropouts += arma::accu(dropouts); global_mistypes += arma::accu(mistypes);
-          global_heterozygous += arma::accu(heterozygous); global_nonmissing += arma::accu(nonmissing);
-          dropout_rate[locus] = 0.5 * R::rbeta(1. + arma::accu(dropouts), 1. + arma::accu(heterozygous) - arma::accu(dropouts));
-          mistyping_rate[locus] = R::rbeta(1. + arma::accu(mistypes), 1. + arma::accu(nonmissing) - arma::accu(mistypes));
-        }
+    // parentage likelihood, with single-precision emissions
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += parentage_loglikelihood_by_locus_single_precision(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,4) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[4] = number_of_loci;
 
-        // update allele frequencies
-        if (update_allele_frequencies)
-        {
-          for (unsigned allele=0; allele<allele_frequencies[locus].n_elem; ++allele)
-          {
-            allele_frequencies[locus][allele] = R::rgamma(1. + allele_counts[allele], 1.);
-          }
-          allele_frequencies[locus] /= arma::accu(allele_frequencies[locus]);
-        }
-      }
-      if (update_error_rates && global_genotyping_error_rates)
-      {
-        // overwrite per-locus rates with global rate
-        dropout_rate.fill(0.5 * R::rbeta(1. + global_dropouts, 1. + global_heterozygous - global_dropouts));
-        mistyping_rate.fill(R::rbeta(1. + global_mistypes, 1. + global_nonmissing - global_mistypes));
-      }
+    // paternity likelihood, specialized on number of alleles
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += kernels[locus](paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,5) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[5] = number_of_loci;
 
-      // store state
-      if (iter >= 0 && thin == 0)
-      {
-        paternity_samples.col(iter) = arma::conv_to<arma::ivec>::from(paternity);
-        maternity_samples.col(iter) = arma::conv_to<arma::ivec>::from(maternity);
-        dropout_rate_samples.col(iter) = dropout_rate;
-        mistyping_rate_samples.col(iter) = mistyping_rate;
-        deviance_samples.at(iter) = deviance;
-      }
+    // paternity likelihood, as matrix operations
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += sydneyPaternity::paternity_loglikelihood_by_locus_matrix(paternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate, mistyping_rate);
+    }
+    seconds.at(repetition,6) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[6] = number_of_loci;
 
-      if (thin == 0 && iter >= 0 && iter % 100 == 0) Rcpp::Rcout << "sampling [" << iter << "] " << "deviance: " << deviance << std::endl;
+    // parentage likelihood, as matrix operations
+    start = clock::now();
+    for (unsigned locus=0; locus<number_of_loci; ++locus)
+    {
+      checksum += sydneyPaternity::parentage_loglikelihood_by_locus_matrix(paternity, maternity, offspring_phenotypes.slice(locus), 
+          maternal_phenotype.col(locus), allele_frequencies[locus], dropout_rate, mistyping_rate);
     }
+    seconds.at(repetition,7) = std::chrono::duration<double>(clock::now() - start).count();
+    calls[7] = number_of_loci;
   }
 
-  // MAP estimates for genotypes, reorder to mirror input
-  arma::ucube imputed_genotypes (arma::size(phenotypes));
-  for (unsigned locus=0; locus<num_loci; ++locus)
+  return Rcpp::List::create(
+      Rcpp::_["kernel"] = Rcpp::CharacterVector::create("genotyping_error_model", "paternity_loglikelihood_by_locus", 
+        "parentage_loglikelihood_by_locus", "parentage_loglikelihood_by_locus_scaled", "parentage_loglikelihood_by_locus_single_precision",
+        "paternity_loglikelihood_by_locus_fixed", "paternity_loglikelihood_by_locus_matrix", "parentage_loglikelihood_by_locus_matrix"),
+      Rcpp::_["calls_per_repetition"] = calls,
+      Rcpp::_["seconds"] = seconds,
+      Rcpp::_["checksum"] = checksum
+      );
+}
+
+// [[Rcpp::export]]
+Rcpp::List benchmark_sampling_primitives
+ (const unsigned number_of_categories = 16,
+  const unsigned number_of_draws = 10000,
+  const unsigned number_of_repetitions = 10)
+{
+  // wall time of categorical, Dirichlet and beta draws from R's RNG, on random log-weights; each repetition
+  // makes "number_of_draws" draws (Dirichlet/beta draws are vectors of "number_of_categories")
+  if (number_of_categories < 1) Rcpp::stop("need at least one category");
+  if (number_of_repetitions < 1) Rcpp::stop("need at least one repetition");
+
+  typedef std::chrono::steady_clock clock;
+  R_random_number_generator rng;
+  arma::vec log_weights (number_of_categories);
+  for (auto& w : log_weights) w = 5. * rng.uniform();
+  const arma::vec weights = arma::exp(log_weights - log_weights.max());
+  const arma::vec shapes = 1. + weights;
+  arma::vec draws (number_of_categories);
+
+  arma::mat seconds (number_of_repetitions, 8);
+  double checksum = 0.; //keeps the compiler from discarding draws
+  for (unsigned repetition=0; repetition<number_of_repetitions; ++repetition)
   {
-    arma::umat genotypes (2, num_offspring+1);
-    for (unsigned i=0; i<num_offspring+1; ++i)
+    // as in sample() before sampling.h: index vector, then RcppArmadillo::sample
+    auto start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i)
     {
-      genotypes.at(0, i) = allele_lengths[locus].at(arma::index_max(arma::sum(genotype_posterior[locus].slice(i), 0)));
-      genotypes.at(1, i) = allele_lengths[locus].at(arma::index_max(arma::sum(genotype_posterior[locus].slice(i), 1)));
+      const arma::uvec index = arma::linspace<arma::uvec>(0, number_of_categories - 1, number_of_categories);
+      checksum += arma::conv_to<arma::uword>::from(Rcpp::RcppArmadillo::sample(index, 1L, true, arma::vec(arma::exp(log_weights - log_weights.max()))));
     }
-    arma::uvec maternal_genotype = genotypes.col(0);
-    genotypes.shed_col(0); genotypes.insert_cols(mother-1, maternal_genotype);
-    imputed_genotypes.slice(locus) = genotypes;
-  }
+    seconds.at(repetition,0) = std::chrono::duration<double>(clock::now() - start).count();
 
-  // posterior expectation of error counts & reorder matrices to mirror input (0'th index is mother, offspring are 1-based indices)
-  dropout_errors /= double(max_iter);
-  arma::rowvec maternal_dropout_errors = dropout_errors.row(0); 
-  dropout_errors.shed_row(0); dropout_errors.insert_rows(mother-1, maternal_dropout_errors);
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i) checksum += sydneyPaternity::sample_categorical(weights.memptr(), weights.n_elem, rng);
+    seconds.at(repetition,1) = std::chrono::duration<double>(clock::now() - start).count();
 
-  mistyping_errors /= double(max_iter);
-  arma::rowvec maternal_mistyping_errors = mistyping_errors.row(0); 
-  mistyping_errors.shed_row(0); mistyping_errors.insert_rows(mother-1, maternal_mistyping_errors);
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i) checksum += sydneyPaternity::sample_log_categorical(log_weights, rng);
+    seconds.at(repetition,2) = std::chrono::duration<double>(clock::now() - start).count();
 
-  arma::irowvec maternal_parentage (max_iter); maternal_parentage.fill(arma::datum::nan);
-  maternity_samples.insert_rows(mother-1, maternal_parentage);
-  paternity_samples.insert_rows(mother-1, maternal_parentage);
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i) checksum += sydneyPaternity::sample_log_categorical_gumbel(log_weights.memptr(), log_weights.n_elem, rng);
+    seconds.at(repetition,3) = std::chrono::duration<double>(clock::now() - start).count();
+
+    // alias table, including setup
+    start = clock::now();
+    const sydneyPaternity::alias_table table (weights);
+    for (unsigned i=0; i<number_of_draws; ++i) checksum += table.draw(rng);
+    seconds.at(repetition,4) = std::chrono::duration<double>(clock::now() - start).count();
+
+    // as in sample_matrix, via the generator's categorical
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i) checksum += rng.categorical(arma::exp(log_weights - log_weights.max()));
+    seconds.at(repetition,5) = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i)
+    {
+      sydneyPaternity::sample_dirichlet(shapes.memptr(), shapes.n_elem, draws.memptr(), rng);
+      checksum += draws[0];
+    }
+    seconds.at(repetition,6) = std::chrono::duration<double>(clock::now() - start).count();
+
+    start = clock::now();
+    for (unsigned i=0; i<number_of_draws; ++i)
+    {
+      sydneyPaternity::sample_beta(shapes.memptr(), weights.memptr(), shapes.n_elem, draws.memptr(), rng);
+      checksum += draws[0];
+    }
+    seconds.at(repetition,7) = std::chrono::duration<double>(clock::now() - start).count();
+  }
 
   return Rcpp::List::create(
-    //Rcpp::_["allele_lengths"] = allele_lengths,
-    Rcpp::_["paternity"] = paternity_samples,
-    Rcpp::_["maternity"] = maternity_samples,
-    Rcpp::_["dropout_rate"] = dropout_rate_samples,
-    Rcpp::_["mistyping_rate"] = mistyping_rate_samples,
-    Rcpp::_["dropout_errors"] = dropout_errors,
-    Rcpp::_["mistyping_errors"] = mistyping_errors,
-    Rcpp::_["imputed_genotypes"] = imputed_genotypes,
-    Rcpp::_["deviance"] = deviance_samples);
+      Rcpp::_["primitive"] = Rcpp::CharacterVector::create("RcppArmadillo::sample", "sample_categorical", 
+        "sample_log_categorical", "sample_log_categorical_gumbel", "alias_table", "categorical", "sample_dirichlet", "sample_beta"),
+      Rcpp::_["draws_per_repetition"] = number_of_draws,
+      Rcpp::_["seconds"] = seconds,
+      Rcpp::_["checksum"] = checksum
+      );
 }
@@ -0,0 +1,57 @@
+#ifndef _SYDNEYPATERNITY_PROFILING_H
+#define _SYDNEYPATERNITY_PROFILING_H
+
+#include <RcppArmadillo.h>
+#include <sydneyPaternity/profiling.h>
+
+using sydneyPaternity::sampler_instrumentation;
+using sydneyPaternity::phase_timer;
+using sydneyPaternity::PARENTAGE_UPDATE;
+using sydneyPaternity::DATA_AUGMENTATION;
+using sydneyPaternity::ALLELE_FREQUENCY_UPDATE;
+using sydneyPaternity::STORAGE;
+using sydneyPaternity::LIKELIHOOD_EVALUATIONS;
+using sydneyPaternity::CANDIDATE_LABELS;
+using sydneyPaternity::CACHE_HITS;
+
+inline Rcpp::List instrumentation_to_list (const sampler_instrumentation& instrumentation)
+{
+  using namespace sydneyPaternity;
+
+  Rcpp::CharacterVector phase_names = Rcpp::CharacterVector::create(
+      "parentage_update", "data_augmentation", "allele_frequency_update", "storage");
+  Rcpp::NumericVector phase_seconds (instrumentation.seconds.begin(), instrumentation.seconds.end());
+  phase_seconds.names() = phase_names;
+  Rcpp::NumericVector counters (instrumentation.counts.begin(), instrumentation.counts.end());
+  counters.names() = Rcpp::CharacterVector::create(
+      "likelihood_evaluations", "candidate_labels", "cache_hits");
+  Rcpp::List out = Rcpp::List::create(
+      Rcpp::_["seconds"] = phase_seconds,
+      Rcpp::_["counters"] = counters);
+  if (instrumentation.profile_hardware)
+  {
+    if (!instrumentation.hardware.any_available())
+    {
+      Rcpp::warning("hardware performance counters unavailable (requires Linux and a permissive kernel.perf_event_paranoid)");
+    }
+
+    // phases by events, NA where the event could not be counted
+    Rcpp::NumericMatrix hardware_events (NUMBER_OF_PHASES, NUMBER_OF_HARDWARE_EVENTS);
+    for (unsigned phase=0; phase<NUMBER_OF_PHASES; ++phase)
+    {
+      for (unsigned event=0; event<NUMBER_OF_HARDWARE_EVENTS; ++event)
+      {
+        hardware_events(phase, event) = instrumentation.hardware.available(hardware_event(event)) ? 
+          instrumentation.events[phase][event] : NA_REAL;
+      }
+    }
+    hardware_events.attr("dimnames") = Rcpp::List::create(phase_names,
+        Rcpp::CharacterVector::create("cycles", "instructions", "l1d_read_misses", "llc_read_misses", "branch_misses"));
+    hardware_events.attr("scope") = "calling thread and threads spawned while profiling; "
+        "OpenMP workers left over from earlier parallel regions are not counted";
+    out.push_back(hardware_events, "hardware_counters");
+  }
+  return out;
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef _SYDNEYPATERNITY_RANDOM_H
+#define _SYDNEYPATERNITY_RANDOM_H
+
+#include <RcppArmadillo.h>
+#include <RcppArmadilloExtensions/sample.h>
+#include <sydneyPaternity/random.h>
+#include <sydneyPaternity/sampling.h>
+
+// Streams are seeded from R's RNG so results are reproducible with set.seed.
+// R_random_number_generator has the same interface as random_number_generator 
+// but draws from R's RNG, so that R-facing functions are reproducible with set.seed.
+
+using sydneyPaternity::random_number_generator;
+using sydneyPaternity::stream_random_number_generator;
+using sydneyPaternity::splitmix64;
+
+class R_random_number_generator
+{
+  // not thread-safe (caller must hold an RNGScope)
+  public:
+  double uniform (void)
+  {
+    return R::unif_rand();
+  }
+
+  unsigned integer (const unsigned upper)
+  {
+    return std::min(unsigned(R::unif_rand() * double(upper)), upper-1);
+  }
+
+  double gamma (const double shape)
+  {
+    return R::rgamma(shape, 1.);
+  }
+
+  double beta (const double a, const double b)
+  {
+    return R::rbeta(a, b);
+  }
+
+  arma::uword categorical (const arma::vec& pvec)
+  {
+    // inverse cdf from one uniform, rather than RcppArmadillo::sample (which allocates and sorts)
+    return sydneyPaternity::sample_categorical(pvec.memptr(), pvec.n_elem, *this);
+  }
+
+  std::string state (void) const
+  {
+    // .Random.seed, after flushing the generator state to it
+    PutRNGstate();
+    Rcpp::IntegerVector seed = Rcpp::Environment::global_env()[".Random.seed"];
+    std::ostringstream stream;
+    for (auto value : seed) stream << value << " ";
+    return stream.str();
+  }
+
+  void set_state (const std::string& state)
+  {
+    std::istringstream stream (state);
+    std::vector<int> seed;
+    int value;
+    while (stream >> value) seed.push_back(value);
+    if (seed.empty()) Rcpp::stop("invalid random number generator state");
+    Rcpp::Environment::global_env().assign(".Random.seed", Rcpp::IntegerVector(seed.begin(), seed.end()));
+    GetRNGstate();
+  }
+};
+
+inline uint64_t random_seed_from_R (void)
+{
+  // 64-bit seed from two draws of R's RNG (caller must hold an RNGScope)
+  const uint64_t upper = uint64_t(R::unif_rand() * 4294967296.);
+  const uint64_t lower = uint64_t(R::unif_rand() * 4294967296.);
+  return (upper << 32) ^ lower;
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include <RcppArmadillo.h>
+#include <sstream>
+#include <string>
+#include <sydneyPaternity/parentage.h>
+#include <sydneyPaternity/sampling.h>
+#include <sydneyPaternity/allele_buckets.h>
+#include <sydneyPaternity/variational.h>
+
+// Test-only entry points into the core headers, compiled by the test scripts with
+//   Rcpp::sourceCpp(if (file.exists("harness.cpp")) "harness.cpp" else "test/harness.cpp")
+// so that they are not part of the package's interface.
+
+// [[Rcpp::plugins("cpp11")]]
+// [[Rcpp::depends(RcppArmadillo, sydneyPaternity)]]
+
+using sydneyPaternity::recode_to_contiguous_integers;
+using sydneyPaternity::collapse_alleles_and_generate_genotype_prior;
+using sydneyPaternity::parentage_loglikelihood_by_locus;
+using sydneyPaternity::parentage_loglikelihood_by_locus_scaled;
+using sydneyPaternity::parentage_loglikelihood_by_locus_single_precision;
+using sydneyPaternity::paternity_loglikelihood_by_locus;
+using sydneyPaternity::paternity_loglikelihood_by_locus_matrix;
+using sydneyPaternity::paternity_likelihood_kernel;
+using sydneyPaternity::select_paternity_likelihood_kernel;
+
+Rcpp::List harness_parentage_samples_to_list (const sydneyPaternity::parentage_posterior_samples& samples)
+{
+  // compressed traces are decoded, so that compressed and dense chains compare alike
+  return Rcpp::List::create(
+    Rcpp::_["paternity"] = samples.compressed ? samples.paternity_trace.decode() : samples.paternity,
+    Rcpp::_["maternity"] = samples.compressed ? samples.maternity_trace.decode() : samples.maternity,
+    Rcpp::_["dropout_rate"] = samples.dropout_rate,
+    Rcpp::_["mistyping_rate"] = samples.mistyping_rate,
+    Rcpp::_["dropout_errors"] = samples.dropout_errors,
+    Rcpp::_["mistyping_errors"] = samples.mistyping_errors,
+    Rcpp::_["imputed_genotypes"] = samples.imputed_genotypes,
+    Rcpp::_["deviance"] = samples.deviance);
+}
+
+// [[Rcpp::export]]
+Rcpp::List resume_parentage_and_error_rates_with_seed
+ (arma::ucube phenotypes,
+  arma::uvec maternity,
+  const std::string checkpoint_file,
+  const unsigned checkpoint_interval,
+  const unsigned number_of_mcmc_samples = 100,
+  const unsigned burn_in = 0,
+  const unsigned seed = 1,
+  const bool compress_traces = false,
+  const unsigned number_of_threads = 1)
+{
+  // runs the chain from sample_parentage_and_error_rates with the seeded generator used by the command-line
+  // tool, checkpointing every checkpoint_interval iterations, then resumes it from the last checkpoint with a
+  // fresh generator; returns both, which should be identical
+  if (number_of_threads < 1) Rcpp::stop("need at least one thread");
+  if (checkpoint_interval < 1) Rcpp::stop("need a checkpoint interval");
+  std::ostringstream output;
+  sydneyPaternity::sampler_instrumentation instrumentation (false);
+  sydneyPaternity::random_number_generator rng (seed);
+  sydneyPaternity::parentage_posterior_samples uninterrupted =
+    sydneyPaternity::sample_parentage_and_error_rates(phenotypes, maternity, 1, burn_in, 1, number_of_mcmc_samples,
+        true, true, true, 1., 0., 0., 0.01, 0.01, rng, instrumentation, output, checkpoint_file, checkpoint_interval,
+        compress_traces, false, false, 0., number_of_threads);
+  sydneyPaternity::random_number_generator fresh_rng (seed + 1);
+  sydneyPaternity::parentage_posterior_samples resumed =
+    sydneyPaternity::resume_parentage_and_error_rates(checkpoint_file, fresh_rng, instrumentation, output, 0,
+        number_of_threads);
+  return Rcpp::List::create(
+    Rcpp::_["uninterrupted"] = harness_parentage_samples_to_list(uninterrupted),
+    Rcpp::_["resumed"] = harness_parentage_samples_to_list(resumed));
+}
+
+struct fixed_uniform_generator
+{
+  // stands in for a generator in sampling.h, to pin draws at the ends of the unit interval
+  double value;
+  double uniform (void) { return value; }
+};
+
+template <class RNG>
+arma::uvec draw_with_primitive
+ (const arma::vec& weights,
+  const unsigned number_of_draws,
+  const std::string& primitive,
+  RNG& rng)
+{
+  arma::uvec draws (number_of_draws);
+  const arma::vec log_weights = arma::log(weights);
+  if (primitive == "alias_table")
+  {
+    const sydneyPaternity::alias_table table (weights);
+    for (auto& draw : draws) draw = table.draw(rng);
+    return draws;
+  }
+  for (auto& draw : draws)
+  {
+    if (primitive == "sample_categorical") draw = sydneyPaternity::sample_categorical(weights.memptr(), weights.n_elem, rng);
+    else if (primitive == "sample_log_categorical") draw = sydneyPaternity::sample_log_categorical(log_weights, rng);
+    else if (primitive == "sample_log_categorical_gumbel") draw = sydneyPaternity::sample_log_categorical_gumbel(log_weights.memptr(), log_weights.n_elem, rng);
+    else throw std::invalid_argument("unknown primitive");
+  }
+  return draws;
+}
+
+// [[Rcpp::export]]
+arma::uvec sample_with_primitive
+ (arma::vec weights,
+  const unsigned number_of_draws = 1,
+  const std::string primitive = "sample_categorical",
+  const double fixed_uniform = -1.,
+  const unsigned seed = 1)
+{
+  // 1-based draws from one of the categorical primitives in sampling.h on "weights" (log-weights are
+  // their logarithms), using the seeded generator from random.h or, if "fixed_uniform" is in [0, 1], 
+  // that constant uniform
+  if (fixed_uniform >= 0. && fixed_uniform <= 1.)
+  {
+    fixed_uniform_generator rng {fixed_uniform};
+    return draw_with_primitive(weights, number_of_draws, primitive, rng) + 1;
+  }
+  sydneyPaternity::random_number_generator rng (seed);
+  return draw_with_primitive(weights, number_of_draws, primitive, rng) + 1;
+}
+
+// [[Rcpp::export]]
+arma::vec parentage_loglikelihood_given_phenotypes
+ (arma::ucube phenotypes,
+  arma::uvec paternity,
+  arma::uvec maternity,
+  const unsigned mother = 1,
+  const double dropout_rate = 0.05,
+  const double mistyping_rate = 0.05,
+  const bool linear_space = false,
+  const bool single_precision = false)
+{
+  // per-locus parentage log likelihood under uniform allele frequencies, for checking the
+  // log-space, linear-space and single-precision kernels against each other; "paternity" and "maternity" are
+  // for offspring (columns other than "mother"), with maternity 0 for the sampled mother
+  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  if (paternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("paternity must have an element for each offspring");
+  if (maternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("maternity must have an element for each offspring");
+
+  std::vector<arma::vec> allele_frequencies =
+    collapse_alleles_and_generate_genotype_prior(phenotypes); //creates uniform frequency prior
+  arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
+  arma::ucube offspring_phenotypes = phenotypes; offspring_phenotypes.shed_col(mother-1);
+  paternity = recode_to_contiguous_integers(paternity);
+
+  arma::vec log_likelihood (phenotypes.n_slices);
+  for (unsigned locus=0; locus<phenotypes.n_slices; ++locus)
+  {
+    log_likelihood[locus] = single_precision ?
+      parentage_loglikelihood_by_locus_single_precision(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate) :
+      linear_space ?
+      parentage_loglikelihood_by_locus_scaled(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate) :
+      parentage_loglikelihood_by_locus(paternity, maternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+          allele_frequencies[locus], dropout_rate, mistyping_rate);
+  }
+  return log_likelihood;
+}
+
+// [[Rcpp::export]]
+arma::vec paternity_loglikelihood_given_phenotypes
+ (arma::ucube phenotypes,
+  arma::uvec paternity,
+  std::vector<arma::vec> allele_frequencies,
+  const unsigned mother = 1,
+  const double dropout_rate = 0.05,
+  const double mistyping_rate = 0.05,
+  const std::string kernel = "loop")
+{
+  // per-locus paternity log likelihood, for checking the kernels against each other: "loop" is 
+  // paternity_loglikelihood_by_locus, "matrix" is paternity_loglikelihood_by_locus_matrix, and "selected" is 
+  // the kernel chosen by select_paternity_likelihood_kernel for the number of alleles. Alleles in "phenotypes" 
+  // are 1-based indices into "allele_frequencies" (as from simulate_colonies), and "paternity" is for offspring
+  if (mother > phenotypes.n_cols || mother < 1) Rcpp::stop("1-based index of mother out of range");
+  if (paternity.n_elem != phenotypes.n_cols - 1) Rcpp::stop("paternity must have an element for each offspring");
+  if (allele_frequencies.size() != phenotypes.n_slices) Rcpp::stop("must have allele frequencies for each locus");
+  if (kernel != "loop" && kernel != "matrix" && kernel != "selected") Rcpp::stop("unknown kernel");
+
+  arma::umat maternal_phenotype = phenotypes.tube(arma::span::all, arma::span(mother-1));
+  arma::ucube offspring_phenotypes = phenotypes; offspring_phenotypes.shed_col(mother-1);
+  paternity = recode_to_contiguous_integers(paternity);
+
+  arma::vec log_likelihood (phenotypes.n_slices);
+  for (unsigned locus=0; locus<phenotypes.n_slices; ++locus)
+  {
+    paternity_likelihood_kernel locus_kernel = 
+      kernel == "matrix" ? &paternity_loglikelihood_by_locus_matrix :
+      kernel == "selected" ? select_paternity_likelihood_kernel(allele_frequencies[locus].n_elem) :
+      &paternity_loglikelihood_by_locus;
+    log_likelihood[locus] = locus_kernel(paternity, offspring_phenotypes.slice(locus), maternal_phenotype.col(locus),
+        allele_frequencies[locus], dropout_rate, mistyping_rate);
+  }
+  return log_likelihood;
+}
+
+// [[Rcpp::export]]
+arma::vec digamma_function (arma::vec x)
+{
+  // the digamma function used by the variational approximation, for comparison with R's digamma
+  if (arma::any(x <= 0.)) Rcpp::stop("digamma_function needs positive arguments");
+  x.transform([] (double value) { return sydneyPaternity::digamma_function(value); });
+  return x;
+}